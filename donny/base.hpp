@@ -38,6 +38,17 @@ constexpr size_t length_of_array(T (&arr)[N]) {
 	}()
 
 
+// a const member function _name_ calling _name_ of the object Get() returns,
+// for the names which stand for a shared object created on first use.
+#define LAZY_FORWARD(_name_) \
+	template<typename... Args> \
+	auto _name_(Args&&... args) const \
+		-> decltype(Get()._name_(std::forward<Args>(args)...)) \
+	{ \
+		return Get()._name_(std::forward<Args>(args)...); \
+	}
+
+
 // auto return char* or wchar_t*
 class AUTOAW_HELPER
 {
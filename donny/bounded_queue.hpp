@@ -0,0 +1,119 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * bounded_queue.hpp - a blocking multi-producer multi-consumer queue
+ *                     with fixed capacity.
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace donny {
+
+template<typename T>
+class bounded_queue
+{
+public:
+    typedef std::size_t SizeType;
+
+    explicit bounded_queue(SizeType capacity = 1024)
+        : _capacity(capacity == 0 ? 1 : capacity)
+    {
+    }
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    /**
+     *  Block until there is room for the value.
+     *  @return false if the queue has been closed.
+     */
+    bool push(T value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [this]() {
+            return _bClosed || _queue.size() < _capacity;
+        });
+        if (_bClosed) return false;
+        _queue.push_back(std::move(value));
+        lock.unlock();
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     *  Block until a value is available.
+     *  @return false if the queue has been closed and drained.
+     */
+    bool pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this]() {
+            return _bClosed || !_queue.empty();
+        });
+        if (_queue.empty()) return false;
+        value = std::move(_queue.front());
+        _queue.pop_front();
+        lock.unlock();
+        _notFull.notify_one();
+        return true;
+    }
+
+    bool try_pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_queue.empty()) return false;
+        value = std::move(_queue.front());
+        _queue.pop_front();
+        lock.unlock();
+        _notFull.notify_one();
+        return true;
+    }
+
+    // Wake up every waiter. Pending values can still be popped.
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _bClosed = true;
+        }
+        _notFull.notify_all();
+        _notEmpty.notify_all();
+    }
+
+    bool closed() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _bClosed;
+    }
+
+    SizeType size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _queue.size();
+    }
+
+    SizeType capacity() const
+    {
+        return _capacity;
+    }
+
+private:
+    const SizeType _capacity;
+    bool _bClosed = false;
+    std::deque<T> _queue;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _notFull;
+    std::condition_variable _notEmpty;
+
+};
+
+}
@@ -0,0 +1,394 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * compressed_file.hpp - block compressed, seekable files on top of basic_file
+ * dependency : file.hpp, bounded_queue.hpp, crc32c.hpp, lz_block.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file.hpp"
+#include "bounded_queue.hpp"
+#include "crc32c.hpp"
+#include "lz_block.hpp"
+
+namespace donny {
+namespace filesystem {
+
+/**
+ *  Layout of a compressed file, integers in host byte order:
+ *
+ *      header      magic u32, version u32, block size u32
+ *      blocks      raw size u32, stored size u32, crc32c of raw data u32, data
+ *                  (the data is stored as is when it doesn't compress)
+ *      index       per block: offset u64, raw size u32, stored size u32
+ *      footer      block count u64, index offset u64, magic u32
+ *
+ *  The index at the end lets a reader seek to any block directly.
+ *
+ *  Usage:
+ *      compressed_file out(file("data.dz", "wb"), compressed_file::write_mode);
+ *      out.write(buf, n);
+ *      out.close();
+ *
+ *      compressed_file in(file("data.dz", "rb"), compressed_file::read_mode);
+ *      in.seek(pos);
+ *      in.read(buf, n);
+ */
+class compressed_file
+{
+public:
+    using SizeType = std::size_t;
+    using OffsetType = uint64_t;
+
+    enum Mode { read_mode, write_mode };
+
+    static const uint32_t HeaderMagic = 0x5A594E44u; // "DNYZ"
+    static const uint32_t FooterMagic = 0x58594E44u; // "DNYX"
+    static const uint32_t Version = 1;
+
+    /**
+     *  @param blockSize : write mode only.
+     *  @param nThreads : read mode, number of blocks decompressed in
+     *                    parallel ahead of the reader. 0 means
+     *                    std::thread::hardware_concurrency().
+     */
+    compressed_file(basic_file<char> f, Mode mode,
+                    SizeType blockSize = 1 << 16, unsigned nThreads = 0)
+        : _file(f)
+        , _mode(mode)
+        , _blockSize((uint32_t)std::max<SizeType>(blockSize, 64))
+        , _queue(4)
+    {
+        _nThreads = nThreads ? nThreads : std::thread::hardware_concurrency();
+        if (_nThreads == 0) _nThreads = 1;
+
+        if (mode == write_mode)
+            _open_write();
+        else
+            _open_read();
+    }
+    ~compressed_file()
+    {
+        close();
+    }
+
+    compressed_file(const compressed_file&) = delete;
+    compressed_file& operator=(const compressed_file&) = delete;
+
+    bool is_open() const { return _bOpen; }
+
+    /**
+     *  Finish the file. In write mode, wait for the pending blocks and
+     *  write the index.
+     */
+    bool close()
+    {
+        if (!_bOpen) return true;
+        _bOpen = false;
+        if (_mode == read_mode) return true;
+
+        if (!_pending.empty()) _submit();
+        _queue.close();
+        _writer.join();
+        if (!_bWriteOk) return false;
+
+        OffsetType indexOffset = _offset;
+        for (const block_info& b : _index)
+        {
+            _put(&b.offset, 8);
+            _put(&b.rawSize, 4);
+            _put(&b.storedSize, 4);
+        }
+        OffsetType nBlocks = _index.size();
+        uint32_t magic = FooterMagic;
+        _put(&nBlocks, 8);
+        _put(&indexOffset, 8);
+        _put(&magic, 4);
+        _file.flush();
+        return _bWriteOk;
+    }
+
+    // Write mode. Only copies into the current block, the compression and
+    // the actual writing happen on a background thread.
+    SizeType write(const void* src, SizeType n)
+    {
+        if (!_bOpen || _mode != write_mode) return 0;
+        const char* p = (const char*)src;
+        SizeType left = n;
+        while (left)
+        {
+            SizeType m = std::min<SizeType>(left, _blockSize - _pending.size());
+            _pending.append(p, m);
+            p += m;
+            left -= m;
+            _rawOffset += m;
+            if (_pending.size() == _blockSize) _submit();
+        }
+        return n;
+    }
+    SizeType write(const std::string& s)
+    {
+        return write(s.data(), s.size());
+    }
+
+    // Read mode.
+    SizeType read(void* dest, SizeType n)
+    {
+        if (!_bOpen || _mode != read_mode) return 0;
+        char* p = (char*)dest;
+        SizeType done = 0;
+        while (done < n && _rawOffset < _rawSize)
+        {
+            SizeType b = _block_of(_rawOffset);
+            const std::string& data = _block(b);
+            if (data.size() != _index[b].rawSize) break; // damaged
+            SizeType inBlock = _rawOffset - _rawStarts[b];
+            SizeType m = std::min<SizeType>(n - done, data.size() - inBlock);
+            memcpy(p + done, data.data() + inBlock, m);
+            done += m;
+            _rawOffset += m;
+        }
+        return done;
+    }
+
+    // Read mode. Position in the uncompressed stream.
+    bool seek(OffsetType pos)
+    {
+        if (_mode != read_mode || pos > _rawSize) return false;
+        _rawOffset = pos;
+        return true;
+    }
+    OffsetType tell() const { return _rawOffset; }
+    // Size of the uncompressed stream.
+    OffsetType size() const { return _mode == read_mode ? _rawSize : _rawOffset; }
+
+    SizeType blocks() const { return _index.size(); }
+
+    /**
+     *  Read mode. Decompress block b into out.
+     *  @return false if b is out of range or the block is damaged.
+     */
+    bool read_block(SizeType b, std::string& out)
+    {
+        if (_mode != read_mode || b >= _index.size()) return false;
+        std::string stored;
+        uint32_t crc = 0;
+        if (!_load(b, crc, stored)) return false;
+        return _decode(_index[b], crc, stored, out);
+    }
+
+private:
+    struct block_info
+    {
+        OffsetType offset;
+        uint32_t rawSize;
+        uint32_t storedSize;
+    };
+
+    basic_file<char> _file;
+    Mode _mode;
+    uint32_t _blockSize;
+    unsigned _nThreads = 1;
+    bool _bOpen = false;
+
+    std::vector<block_info> _index;
+    OffsetType _rawOffset = 0;
+
+    // write mode
+    std::string _pending;
+    bounded_queue<std::string> _queue;
+    std::thread _writer;
+    OffsetType _offset = 0;
+    bool _bWriteOk = true;
+
+    // read mode
+    OffsetType _rawSize = 0;
+    std::vector<OffsetType> _rawStarts;
+    SizeType _cacheFirst = 0;
+    std::vector<std::string> _cache;
+
+    void _put(const void* p, SizeType n)
+    {
+        if (_file.write(p, 1, n) != n) _bWriteOk = false;
+        _offset += n;
+    }
+
+    void _open_write()
+    {
+        if (!_file.is_open()) return;
+        uint32_t header[3] = { HeaderMagic, Version, _blockSize };
+        _put(header, sizeof(header));
+        if (!_bWriteOk) return;
+        _pending.reserve(_blockSize);
+        // Only started once open, close() joins it only then.
+        _writer = std::thread(&compressed_file::_write_blocks, this);
+        _bOpen = true;
+    }
+
+    void _submit()
+    {
+        std::string block;
+        block.reserve(_blockSize);
+        block.swap(_pending);
+        _queue.push(std::move(block));
+    }
+
+    // Runs on the background thread.
+    void _write_blocks()
+    {
+        std::string raw, packed;
+        while (_queue.pop(raw))
+        {
+            packed.clear();
+            lz_compress(raw.data(), raw.size(), packed);
+            const std::string& stored = (packed.size() < raw.size()) ? packed : raw;
+
+            block_info info = { _offset, (uint32_t)raw.size(), (uint32_t)stored.size() };
+            uint32_t crc = crc32c(raw.data(), raw.size());
+            _put(&info.rawSize, 4);
+            _put(&info.storedSize, 4);
+            _put(&crc, 4);
+            _put(stored.data(), stored.size());
+            _index.push_back(info);
+        }
+    }
+
+    template<typename T>
+    bool _get(T& v)
+    {
+        return _file.read(&v, sizeof(T), 1) == 1;
+    }
+
+    void _open_read()
+    {
+        if (!_file.is_open()) return;
+        if (_read_index())
+        {
+            _bOpen = true;
+            return;
+        }
+        _index.clear();
+        _rawStarts.clear();
+        _rawSize = 0;
+    }
+
+    // The footer and the index are checked against the file size before
+    // anything is allocated from them, a damaged file is just not opened.
+    bool _read_index()
+    {
+        uint32_t magic = 0, version = 0;
+        if (!_get(magic) || magic != HeaderMagic) return false;
+        if (!_get(version) || version != Version) return false;
+        if (!_get(_blockSize)) return false;
+
+        OffsetType nBlocks = 0, indexOffset = 0;
+        uint32_t footerMagic = 0;
+        if (!_file.seek(-20, basic_file<char>::end)) return false;
+        const long footerOffset = _file.tell();
+        if (footerOffset < 12) return false;
+        if (!_get(nBlocks) || !_get(indexOffset) || !_get(footerMagic)) return false;
+        if (footerMagic != FooterMagic) return false;
+
+        // The index fills the space between the blocks and the footer.
+        if (indexOffset < 12 || indexOffset > (OffsetType)footerOffset) return false;
+        const OffsetType indexSize = (OffsetType)footerOffset - indexOffset;
+        if (indexSize % 16 != 0 || indexSize / 16 != nBlocks) return false;
+
+        if (!_file.seek((long)indexOffset, basic_file<char>::begin)) return false;
+        _index.resize(nBlocks);
+        _rawStarts.resize(nBlocks);
+        for (SizeType b = 0; b < nBlocks; ++b)
+        {
+            block_info& info = _index[b];
+            if (!_get(info.offset) || !_get(info.rawSize) || !_get(info.storedSize))
+                return false;
+            // Block header and data within [12, indexOffset).
+            if (info.offset < 12 || info.offset > indexOffset
+                || indexOffset - info.offset < 12
+                || indexOffset - info.offset - 12 < info.storedSize)
+                return false;
+            if (info.rawSize > _blockSize || info.storedSize > info.rawSize)
+                return false;
+            _rawStarts[b] = _rawSize;
+            _rawSize += info.rawSize;
+        }
+        return true;
+    }
+
+    SizeType _block_of(OffsetType pos) const
+    {
+        return std::upper_bound(_rawStarts.begin(), _rawStarts.end(), pos)
+            - _rawStarts.begin() - 1;
+    }
+
+    bool _load(SizeType b, uint32_t& crc, std::string& stored)
+    {
+        const block_info& info = _index[b];
+        stored.resize(info.storedSize);
+        if (!_file.seek((long)info.offset + 8, basic_file<char>::begin) || !_get(crc))
+            return false;
+        return _file.read(&stored[0], 1, info.storedSize) == info.storedSize;
+    }
+
+    static bool _decode(const block_info& info, uint32_t crc,
+                        const std::string& stored, std::string& out)
+    {
+        out.resize(info.rawSize);
+        if (info.storedSize == info.rawSize)
+            out = stored;
+        else if (!lz_decompress(stored.data(), stored.size(), &out[0], info.rawSize))
+        {
+            out.clear();
+            return false;
+        }
+        if (crc32c(out.data(), out.size()) != crc)
+        {
+            out.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // Block b, decompressed together with the next blocks in parallel.
+    const std::string& _block(SizeType b)
+    {
+        if (b >= _cacheFirst && b < _cacheFirst + _cache.size())
+            return _cache[b - _cacheFirst];
+
+        SizeType n = std::min<SizeType>(_nThreads, _index.size() - b);
+        std::vector<std::string> stored(n);
+        std::vector<uint32_t> crcs(n, 0);
+        // Blocks are contiguous, so this is one sequential read.
+        for (SizeType k = 0; k < n; ++k)
+            if (!_load(b + k, crcs[k], stored[k]))
+                stored[k].clear();
+
+        _cache.assign(n, std::string());
+        _cacheFirst = b;
+        std::vector<std::future<void>> jobs;
+        for (SizeType k = 1; k < n; ++k)
+            jobs.push_back(std::async(std::launch::async, [&, k]() {
+                _decode(_index[b + k], crcs[k], stored[k], _cache[k]);
+            }));
+        _decode(_index[b], crcs[0], stored[0], _cache[0]);
+        for (std::future<void>& job : jobs)
+            job.get();
+
+        return _cache[0];
+    }
+
+};
+
+}
+}
@@ -0,0 +1,51 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * cpu_features.hpp - runtime detection of the instruction sets of the cpu
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+// DONNY_X86 : gcc or clang targeting x86, where the SIMD kernels of
+// donnylib are compiled with target attributes and picked at runtime.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define DONNY_X86 1
+#define DONNY_TARGET(_ISA_) __attribute__((target(_ISA_)))
+#include <immintrin.h>
+#else
+#define DONNY_TARGET(_ISA_)
+#endif
+
+namespace donny {
+
+struct cpu_features
+{
+    bool sse2 = false;
+    bool sse42 = false;
+    bool pclmul = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool avx512f = false;
+};
+
+inline const cpu_features& cpu()
+{
+    static const cpu_features features = []() {
+        cpu_features f;
+#if DONNY_X86
+        __builtin_cpu_init();
+        f.sse2 = __builtin_cpu_supports("sse2");
+        f.sse42 = __builtin_cpu_supports("sse4.2");
+        f.avx2 = __builtin_cpu_supports("avx2");
+        f.fma = __builtin_cpu_supports("fma");
+        f.avx512f = __builtin_cpu_supports("avx512f");
+        f.pclmul = __builtin_cpu_supports("pclmul");
+#endif
+        return f;
+    }();
+    return features;
+}
+
+}
@@ -0,0 +1,119 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * crc32c.hpp - CRC-32C (Castagnoli) checksum
+ * dependency : cpu_features.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "cpu_features.hpp"
+
+namespace donny {
+
+namespace detail {
+
+struct crc32c_table
+{
+    uint32_t t[8][256];
+
+    crc32c_table()
+    {
+        const uint32_t poly = 0x82F63B78u; // reflected 0x1EDC6F41
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t crc = n;
+            for (int k = 0; k < 8; ++k)
+                crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+            t[0][n] = crc;
+        }
+        for (uint32_t n = 0; n < 256; ++n)
+            for (int k = 1; k < 8; ++k)
+                t[k][n] = (t[k-1][n] >> 8) ^ t[0][t[k-1][n] & 0xFF];
+    }
+};
+
+// Slicing-by-8, on raw (not inverted) crc.
+inline uint32_t crc32c_sw(uint32_t crc, const unsigned char* p, std::size_t n)
+{
+    static const crc32c_table table;
+    const uint32_t (*t)[256] = table.t;
+
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF]
+            ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF]
+            ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    while (n--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+#if DONNY_X86
+DONNY_TARGET("sse4.2")
+inline uint32_t crc32c_hw(uint32_t crc, const unsigned char* p, std::size_t n)
+{
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+    }
+    crc = (uint32_t)crc64;
+#endif
+    for (; n >= 4; n -= 4, p += 4)
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+    }
+    while (n--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+#endif
+
+typedef uint32_t (*crc32c_fn)(uint32_t, const unsigned char*, std::size_t);
+
+inline crc32c_fn crc32c_impl()
+{
+    static const crc32c_fn fn = []() -> crc32c_fn {
+#if DONNY_X86
+        if (cpu().sse42) return crc32c_hw;
+#endif
+        return crc32c_sw;
+    }();
+    return fn;
+}
+
+}
+
+/**
+ *  CRC-32C of data, with the SSE4.2 crc32 instruction when available.
+ *  Pass the previous result as crc to checksum data in pieces:
+ *      crc32c(b, nb, crc32c(a, na)) == crc32c(ab, na + nb)
+ */
+inline uint32_t crc32c(const void* data, std::size_t size, uint32_t crc = 0)
+{
+    return ~detail::crc32c_impl()(~crc, (const unsigned char*)data, size);
+}
+
+}
@@ -0,0 +1,544 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * csv_reader.hpp - CSV/TSV parsing with SIMD structural classification
+ * dependency : cpu_features.hpp, mapped_file.hpp, number_reader.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "cpu_features.hpp"
+#include "mapped_file.hpp"
+#include "number_reader.hpp"
+
+namespace donny {
+
+/**
+ *  A field of a row, pointing into the parsed data. The quotes around a
+ *  quoted field are not part of it, but doubled quotes inside still are,
+ *  use str() to get the text.
+ */
+struct csv_field
+{
+    const char* data;
+    std::size_t size;
+    bool bQuoted;
+    char quote;
+
+    std::string str() const
+    {
+        if (!bQuoted) return std::string(data, size);
+        std::string s;
+        s.reserve(size);
+        for (std::size_t ind = 0; ind < size; ++ind)
+        {
+            s += data[ind];
+            if (data[ind] == quote && ind + 1 < size && data[ind + 1] == quote) ++ind;
+        }
+        return s;
+    }
+
+    // Parse the whole field as a number. @return false if it isn't one.
+    template<typename T>
+    bool to(T& value) const
+    {
+        return size != 0 && parse_number(data, data + size, value) == data + size;
+    }
+};
+
+namespace detail {
+
+// Bit i of each mask is set when byte i of the block is that character.
+struct csv_masks
+{
+    uint64_t quote;
+    uint64_t delim;
+    uint64_t newline;
+};
+
+inline void csv_classify_scalar(const char* p, char quote, char delim, csv_masks& m)
+{
+    m.quote = m.delim = m.newline = 0;
+    for (int ind = 0; ind < 64; ++ind)
+    {
+        uint64_t bit = (uint64_t)1 << ind;
+        if (p[ind] == quote) m.quote |= bit;
+        else if (p[ind] == delim) m.delim |= bit;
+        else if (p[ind] == '\n') m.newline |= bit;
+    }
+}
+
+#if DONNY_X86
+DONNY_TARGET("sse2")
+inline void csv_classify_sse2(const char* p, char quote, char delim, csv_masks& m)
+{
+    const __m128i q = _mm_set1_epi8(quote);
+    const __m128i d = _mm_set1_epi8(delim);
+    const __m128i nl = _mm_set1_epi8('\n');
+    m.quote = m.delim = m.newline = 0;
+    for (int ind = 0; ind < 4; ++ind)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + 16 * ind));
+        int shift = 16 * ind;
+        m.quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, q)) << shift;
+        m.delim |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, d)) << shift;
+        m.newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)) << shift;
+    }
+}
+
+DONNY_TARGET("avx2")
+inline uint64_t csv_mask_avx2(__m256i lo, __m256i hi, __m256i c)
+{
+    return (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, c))
+         | (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, c)) << 32;
+}
+
+DONNY_TARGET("avx2")
+inline void csv_classify_avx2(const char* p, char quote, char delim, csv_masks& m)
+{
+    __m256i lo = _mm256_loadu_si256((const __m256i*)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+    m.quote = csv_mask_avx2(lo, hi, _mm256_set1_epi8(quote));
+    m.delim = csv_mask_avx2(lo, hi, _mm256_set1_epi8(delim));
+    m.newline = csv_mask_avx2(lo, hi, _mm256_set1_epi8('\n'));
+}
+#endif
+
+typedef void (*csv_classify_fn)(const char*, char, char, csv_masks&);
+
+inline csv_classify_fn csv_classify_impl()
+{
+    static const csv_classify_fn fn = []() -> csv_classify_fn {
+#if DONNY_X86
+        if (cpu().avx2) return csv_classify_avx2;
+        if (cpu().sse2) return csv_classify_sse2;
+#endif
+        return csv_classify_scalar;
+    }();
+    return fn;
+}
+
+// Bit i of the result is the xor of bits 0..i of x.
+inline uint64_t prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/**
+ *  Splits [begin, end) into rows and fields. Each 64-byte block is
+ *  classified at once; the bytes inside quotes are found with a prefix xor
+ *  of the quote mask, so delimiters and newlines there are ignored without
+ *  looking at them one by one.
+ */
+class csv_scanner
+{
+public:
+    csv_scanner(const char* begin, const char* end, char delim, char quote)
+        : _end(end)
+        , _delim(delim)
+        , _quote(quote)
+        , _fieldStart(begin)
+        , _next(begin)
+        , _classify(csv_classify_impl())
+    {
+    }
+
+    /**
+     *  Next row, empty lines are skipped. The fields point into the data.
+     *  @return false at the end.
+     */
+    bool next_row(std::vector<csv_field>& row)
+    {
+        for (;;)
+        {
+            row.clear();
+            if (_fieldStart >= _end) return false;
+            for (;;)
+            {
+                const char* p = _next_structural();
+                if (p == nullptr)
+                {
+                    _push(row, _fieldStart, _end, true);
+                    _fieldStart = _end;
+                    break;
+                }
+                bool bNewLine = (*p == '\n');
+                _push(row, _fieldStart, p, bNewLine);
+                _fieldStart = p + 1;
+                if (bNewLine) break;
+            }
+            if (row.size() > 1 || row[0].size != 0 || row[0].bQuoted) return true;
+        }
+    }
+
+    // Start of the next row.
+    const char* position() const { return _fieldStart; }
+
+private:
+    const char* _end;
+    char _delim;
+    char _quote;
+    const char* _fieldStart;
+    const char* _block = nullptr; // current block
+    const char* _next;            // next block to classify
+    uint64_t _bits = 0;           // structural characters left in the block
+    bool _bInQuote = false;
+    csv_classify_fn _classify;
+
+    const char* _next_structural()
+    {
+        while (_bits == 0)
+        {
+            if (_next >= _end) return nullptr;
+            csv_masks m;
+            if (_end - _next >= 64)
+                _classify(_next, _quote, _delim, m);
+            else
+            {
+                char tail[64] = { 0 }; // zeros are never structural
+                memcpy(tail, _next, _end - _next);
+                _classify(tail, _quote, _delim, m);
+            }
+            uint64_t inQuote = prefix_xor(m.quote) ^ (_bInQuote ? ~(uint64_t)0 : 0);
+            _bInQuote = (inQuote >> 63) != 0;
+            _bits = (m.delim | m.newline) & ~inQuote;
+            _block = _next;
+            _next = (_end - _next >= 64) ? _next + 64 : _end;
+        }
+        const char* p = _block + __builtin_ctzll(_bits);
+        _bits &= _bits - 1;
+        return p;
+    }
+
+    void _push(std::vector<csv_field>& row, const char* begin, const char* end, bool bLast)
+    {
+        if (bLast && end > begin && end[-1] == '\r') --end;
+        csv_field f = { begin, (std::size_t)(end - begin), false, _quote };
+        if (f.size >= 2 && begin[0] == _quote && end[-1] == _quote)
+        {
+            f.data = begin + 1;
+            f.size -= 2;
+            f.bQuoted = true;
+        }
+        row.push_back(f);
+    }
+
+};
+
+struct csv_column
+{
+    std::size_t index;        // resolved from name when the reader has a header
+    std::string name;
+    std::function<void(std::size_t)> resize;
+    std::function<bool(const csv_field&, std::size_t)> decode; // (field, row)
+};
+
+template<typename T>
+bool csv_decode(const csv_field& f, T& value, std::true_type)
+{
+    return f.to(value);
+}
+template<typename T>
+bool csv_decode(const csv_field& f, T& value, std::false_type)
+{
+    value = f.str();
+    return true;
+}
+
+}
+
+/**
+ *  Read CSV or TSV data from memory, a mapped file or a basic_file.
+ *  Fields may be quoted; a quoted field can hold delimiters, newlines and
+ *  doubled quotes. Lines may end with "\r\n". Empty lines are skipped.
+ *
+ *  Row by row, with field views:
+ *      csv_reader csv(file("data.csv", "rb"));
+ *      std::vector<csv_field> row;
+ *      while (csv.next_row(row)) ...
+ *
+ *  Column by column, decoded in parallel:
+ *      std::vector<double> price;
+ *      std::vector<std::string> name;
+ *      csv.header(true).column("price", price).column("name", name);
+ *      csv.read_columns();
+ *
+ *  read_columns() splits the data into chunks at line ends for the worker
+ *  threads. With quotes in the data, a newline can be inside a field, so
+ *  the chunk boundaries are found by a first sequential pass instead.
+ */
+class csv_reader
+{
+public:
+    using SizeType = std::size_t;
+
+    csv_reader(const char* data, SizeType size)
+        : _data(data)
+        , _size(size)
+        , _scanner(data, data + size, ',', '"')
+    {
+    }
+    explicit csv_reader(const filesystem::mapped_file& mf)
+        : csv_reader(mf.data(), mf.size())
+    {
+    }
+    // Maps the file underlying f.
+    explicit csv_reader(filesystem::basic_file<char> f)
+        : csv_reader(nullptr, 0)
+    {
+        _file.open(f);
+        _data = _file.data();
+        _size = _file.size();
+        _restart();
+    }
+    explicit csv_reader(const std::string& filename)
+        : csv_reader(nullptr, 0)
+    {
+        _file.open(filename);
+        _data = _file.data();
+        _size = _file.size();
+        _restart();
+    }
+
+    csv_reader(const csv_reader&) = delete;
+    csv_reader& operator=(const csv_reader&) = delete;
+
+    // ',' by default, '\t' for TSV.
+    csv_reader& delimiter(char delim)
+    {
+        _delim = delim;
+        _restart();
+        return *this;
+    }
+    csv_reader& quote(char quote)
+    {
+        _quote = quote;
+        _restart();
+        return *this;
+    }
+    // Whether the first row holds the names of the columns.
+    csv_reader& header(bool bHeader)
+    {
+        _bHeader = bHeader;
+        _restart();
+        return *this;
+    }
+    const std::vector<std::string>& column_names() const
+    {
+        return _names;
+    }
+
+    /**
+     *  Next row. The fields stay valid as long as the reader.
+     *  @return false at the end.
+     */
+    bool next_row(std::vector<csv_field>& row)
+    {
+        return _scanner.next_row(row);
+    }
+    // Back to the first row.
+    void rewind()
+    {
+        _restart();
+    }
+
+    /**
+     *  Decode column index of every row into out, when read_columns() is
+     *  called. T is an arithmetic type or std::string.
+     */
+    template<typename T>
+    csv_reader& column(SizeType index, std::vector<T>& out)
+    {
+        return _add_column(index, std::string(), out);
+    }
+    // Same, for the column of that name in the header.
+    template<typename T>
+    csv_reader& column(const std::string& name, std::vector<T>& out)
+    {
+        return _add_column(0, name, out);
+    }
+
+    /**
+     *  Decode the registered columns of all rows, after the header.
+     *  Fields that are missing or don't parse are left value-initialized
+     *  and counted by errors().
+     *  @return number of rows.
+     *  @throw std::invalid_argument if a column name isn't in the header.
+     */
+    SizeType read_columns(unsigned nThreads = 0)
+    {
+        if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+        if (nThreads == 0) nThreads = 1;
+        _nErrors = 0;
+
+        for (detail::csv_column& c : _columns)
+        {
+            if (c.name.empty()) continue;
+            auto it = std::find(_names.begin(), _names.end(), c.name);
+            if (it == _names.end())
+                throw std::invalid_argument("csv_reader: no column named " + c.name);
+            c.index = it - _names.begin();
+        }
+
+        const char* begin = _first_row();
+        const char* end = _data + _size;
+        std::vector<const char*> bounds = _split(begin, end, nThreads);
+        SizeType nChunks = bounds.size() - 1;
+
+        // Rows per chunk first, so every chunk knows where its rows go.
+        std::vector<SizeType> firstRow(nChunks + 1, 0);
+        _parallel(nChunks, [&](SizeType c) {
+            detail::csv_scanner scanner(bounds[c], bounds[c + 1], _delim, _quote);
+            std::vector<csv_field> row;
+            SizeType n = 0;
+            while (scanner.next_row(row)) ++n;
+            firstRow[c + 1] = n;
+        });
+        for (SizeType c = 0; c < nChunks; ++c)
+            firstRow[c + 1] += firstRow[c];
+        SizeType nRows = firstRow[nChunks];
+        for (detail::csv_column& col : _columns)
+            col.resize(nRows);
+
+        _parallel(nChunks, [&](SizeType c) {
+            detail::csv_scanner scanner(bounds[c], bounds[c + 1], _delim, _quote);
+            std::vector<csv_field> row;
+            SizeType nErrors = 0;
+            for (SizeType r = firstRow[c]; scanner.next_row(row); ++r)
+                for (detail::csv_column& col : _columns)
+                    if (col.index >= row.size() || !col.decode(row[col.index], r))
+                        ++nErrors;
+            _nErrors += nErrors;
+        });
+        return nRows;
+    }
+
+    // Fields read_columns() couldn't decode.
+    SizeType errors() const { return _nErrors; }
+
+private:
+    filesystem::mapped_file _file;
+    const char* _data;
+    SizeType _size;
+    char _delim = ',';
+    char _quote = '"';
+    bool _bHeader = false;
+    std::vector<std::string> _names;
+    detail::csv_scanner _scanner;
+    std::vector<detail::csv_column> _columns;
+    std::atomic<SizeType> _nErrors{ 0 };
+
+    void _restart()
+    {
+        _scanner = detail::csv_scanner(_data, _data + _size, _delim, _quote);
+        _names.clear();
+        if (!_bHeader) return;
+        std::vector<csv_field> row;
+        if (_scanner.next_row(row))
+            for (const csv_field& f : row)
+                _names.push_back(f.str());
+    }
+
+    const char* _first_row() const
+    {
+        if (!_bHeader) return _data;
+        detail::csv_scanner scanner(_data, _data + _size, _delim, _quote);
+        std::vector<csv_field> row;
+        scanner.next_row(row);
+        return scanner.position();
+    }
+
+    template<typename T>
+    csv_reader& _add_column(SizeType index, const std::string& name, std::vector<T>& out)
+    {
+        static_assert(std::is_arithmetic<T>::value || std::is_same<T, std::string>::value,
+                      "csv_reader: columns are arithmetic or std::string");
+        static_assert(!std::is_same<T, bool>::value,
+                      "csv_reader: std::vector<bool> can't be filled concurrently");
+        detail::csv_column c;
+        c.index = index;
+        c.name = name;
+        std::vector<T>* pOut = &out;
+        c.resize = [pOut](SizeType n) { pOut->assign(n, T()); };
+        c.decode = [pOut](const csv_field& f, SizeType row) {
+            return detail::csv_decode(f, (*pOut)[row],
+                std::integral_constant<bool, std::is_arithmetic<T>::value>());
+        };
+        _columns.push_back(c);
+        return *this;
+    }
+
+    // Chunk boundaries at row starts, about the same size each.
+    std::vector<const char*> _split(const char* begin, const char* end, unsigned nChunks) const
+    {
+        std::vector<const char*> bounds(1, begin);
+        SizeType size = end - begin;
+        SizeType target = size / nChunks + 1;
+        if (nChunks == 1 || size < (1 << 16))
+        {
+            bounds.push_back(end);
+            return bounds;
+        }
+
+        if (memchr(begin, _quote, size) == nullptr)
+        {
+            // Every newline ends a row.
+            for (unsigned c = 1; c < nChunks; ++c)
+            {
+                const char* p = std::max(begin + c * target, bounds.back());
+                if (p >= end) break;
+                const char* nl = (const char*)memchr(p, '\n', end - p);
+                if (nl == nullptr) break;
+                bounds.push_back(nl + 1);
+            }
+        }
+        else
+        {
+            detail::csv_scanner scanner(begin, end, _delim, _quote);
+            std::vector<csv_field> row;
+            const char* next = begin + target;
+            while (scanner.next_row(row))
+                if (scanner.position() >= next && scanner.position() < end)
+                {
+                    bounds.push_back(scanner.position());
+                    next = scanner.position() + target;
+                }
+        }
+        if (bounds.back() != end) bounds.push_back(end);
+        return bounds;
+    }
+
+    template<typename Fn>
+    static void _parallel(SizeType n, Fn fn)
+    {
+        std::vector<std::future<void>> jobs;
+        for (SizeType ind = 1; ind < n; ++ind)
+            jobs.push_back(std::async(std::launch::async, fn, ind));
+        if (n) fn(0);
+        for (std::future<void>& job : jobs)
+            job.get();
+    }
+
+};
+
+}
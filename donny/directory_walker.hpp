@@ -0,0 +1,499 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * directory_walker.hpp - parallel recursive directory traversal
+ * dependency : base.hpp, bounded_queue.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "base.hpp"
+#include "bounded_queue.hpp"
+
+namespace donny {
+namespace filesystem {
+
+struct directory_entry
+{
+    std::string path; // path of the entry, prefixed by the walked root
+    std::string name; // last component of path
+    int depth = 0; // entries directly under the root have depth 1
+    unsigned char type = DT_UNKNOWN; // DT_REG, DT_DIR, DT_LNK...
+    bool bHasStatus = false; // whether status is filled
+    struct stat status;
+
+    bool is_directory() const { return type == DT_DIR; }
+    bool is_regular_file() const { return type == DT_REG; }
+    bool is_symlink() const { return type == DT_LNK; }
+};
+
+/**
+ *  Walk a directory tree with a pool of work-stealing threads.
+ *
+ *  Each worker reads a whole directory with getdents64, stats its
+ *  entries with fstatat and opens its sub-directories with openat, all
+ *  relative to the directory fd, so the kernel never resolves the full
+ *  path of an entry and a renamed parent cannot redirect the walk.
+ *  Sub-directories are pushed to the worker's own deque and idle workers
+ *  steal from the others.
+ *
+ *  A directory stays open while its queued sub-directories need it. At
+ *  most half of the fds free when the walk starts are kept open this way,
+ *  past that, and when openat runs out of fds, sub-directories are opened
+ *  by their path.
+ *
+ *  Usage:
+ *      directory_walker walker;
+ *      walker.filter([](const directory_entry& e) { return e.is_regular_file(); })
+ *            .walk("/var/log", [](const directory_entry& e) { ... });
+ */
+class directory_walker
+{
+public:
+    typedef std::function<bool(const directory_entry&)> Predicate;
+    typedef std::function<void(const directory_entry&)> Callback;
+
+    directory_walker()
+    {
+    }
+
+    // 0 means std::thread::hardware_concurrency().
+    directory_walker& threads(unsigned nThreads)
+    {
+        _nThreads = nThreads;
+        return *this;
+    }
+    // Only the entries accepted by the predicate are reported.
+    directory_walker& filter(Predicate pred)
+    {
+        _filter = std::move(pred);
+        return *this;
+    }
+    // Only the directories accepted by the predicate are descended into.
+    directory_walker& descend_if(Predicate pred)
+    {
+        _descend = std::move(pred);
+        return *this;
+    }
+    // Fill directory_entry::status for every entry. Disabling this saves
+    // one fstatat per entry when the filesystem reports d_type.
+    directory_walker& stat(bool bStat)
+    {
+        _bStat = bStat;
+        return *this;
+    }
+    directory_walker& follow_symlinks(bool bFollow)
+    {
+        _bFollowSymlinks = bFollow;
+        return *this;
+    }
+    // -1 means unlimited.
+    directory_walker& max_depth(int depth)
+    {
+        _maxDepth = depth;
+        return *this;
+    }
+
+    /**
+     *  Walk the tree under root.
+     *  @param cb : called concurrently from the worker threads.
+     *  @return number of entries reported.
+     */
+    std::size_t walk(const std::string& root, Callback cb)
+    {
+        _callback = std::move(cb);
+        _reset();
+
+        unsigned nThreads = _nThreads;
+        if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+        if (nThreads == 0) nThreads = 1;
+
+        _workers.clear();
+        for (unsigned ind = 0; ind < nThreads; ++ind)
+            _workers.emplace_back(new worker_queue);
+
+        _push(0, task{ root, 0, nullptr, std::string() });
+
+        std::vector<std::thread> threads;
+        for (unsigned ind = 1; ind < nThreads; ++ind)
+            threads.emplace_back(&directory_walker::_work, this, ind);
+        _work(0);
+        for (std::thread& t : threads)
+            t.join();
+
+        _workers.clear();
+        _callback = nullptr;
+
+        if (_exception)
+            std::rethrow_exception(_exception);
+        return _nReported;
+    }
+
+    /**
+     *  Walk the tree and stream the entries into a queue. The queue is
+     *  closed once the walk ends, so consumers can simply pop until it
+     *  returns false.
+     */
+    std::size_t walk(const std::string& root, bounded_queue<directory_entry>& queue)
+    {
+        struct closer
+        {
+            bounded_queue<directory_entry>& q;
+            ~closer() { q.close(); }
+        } closeOnExit{ queue };
+
+        // Consumers stop the walk by closing the queue.
+        return walk(root, [this, &queue](const directory_entry& e) {
+            if (!queue.push(e)) _bAbort = true;
+        });
+    }
+    std::future<std::size_t> walk_async(
+        const std::string& root, bounded_queue<directory_entry>& queue)
+    {
+        return std::async(std::launch::async, [this, root, &queue]() {
+            return walk(root, queue);
+        });
+    }
+
+    // Number of directories that could not be opened or read in the last walk.
+    std::size_t errors() const
+    {
+        return _nErrors;
+    }
+
+private:
+    // An open directory, closed once its last queued child is opened.
+    struct directory_fd
+    {
+        int fd;
+        std::atomic<std::size_t>& nOpen;
+        directory_fd(int fd_, std::atomic<std::size_t>& nOpen_) : fd(fd_), nOpen(nOpen_)
+        {
+            ++nOpen;
+        }
+        ~directory_fd()
+        {
+            ::close(fd);
+            --nOpen;
+        }
+    };
+    struct task
+    {
+        std::string path;
+        int depth;
+        std::shared_ptr<const directory_fd> parent; // null: opened by path
+        std::string name; // opened relative to parent
+    };
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    unsigned _nThreads = 0;
+    bool _bStat = true;
+    bool _bFollowSymlinks = false;
+    int _maxDepth = -1;
+    Predicate _filter;
+    Predicate _descend;
+    Callback _callback;
+
+    std::vector<std::unique_ptr<worker_queue>> _workers;
+    std::atomic<std::size_t> _nPending; // queued or running tasks
+    std::atomic<std::size_t> _nQueued;
+    std::atomic<std::size_t> _nReported;
+    std::atomic<std::size_t> _nErrors;
+    std::atomic<bool> _bAbort;
+    std::atomic<std::size_t> _nOpenDirs; // directory fds held
+    std::atomic<std::size_t> _maxOpenDirs;
+    std::mutex _idleMutex;
+    std::condition_variable _idle;
+
+    std::mutex _exceptionMutex;
+    std::exception_ptr _exception;
+
+    std::mutex _visitedMutex;
+    std::set<std::pair<dev_t, ino_t>> _visited;
+
+    void _reset()
+    {
+        _nPending = 0;
+        _nQueued = 0;
+        _nReported = 0;
+        _nErrors = 0;
+        _bAbort = false;
+        _nOpenDirs = 0;
+        _exception = nullptr;
+        _visited.clear();
+
+        struct rlimit limit;
+        _maxOpenDirs = 512;
+        if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+        {
+            std::size_t nUsed = _count_open_fds();
+            std::size_t nFree = ((std::size_t)limit.rlim_cur > nUsed)
+                ? (std::size_t)limit.rlim_cur - nUsed : 0;
+            _maxOpenDirs = nFree / 2;
+        }
+    }
+
+    // 0 where the open fds cannot be listed.
+    static std::size_t _count_open_fds()
+    {
+        std::size_t n = 0;
+#ifdef __linux__
+        DIR* dir = ::opendir("/proc/self/fd");
+        if (dir == nullptr) return 0;
+        while (struct dirent* d = ::readdir(dir))
+            if (d->d_name[0] != '.') ++n;
+        ::closedir(dir);
+        if (n > 0) --n; // the fd of dir itself
+#endif
+        return n;
+    }
+
+    void _push(unsigned id, task t)
+    {
+        ++_nPending;
+        ++_nQueued;
+        {
+            std::lock_guard<std::mutex> lock(_workers[id]->mutex);
+            _workers[id]->tasks.push_back(std::move(t));
+        }
+        std::lock_guard<std::mutex> lock(_idleMutex);
+        _idle.notify_one();
+    }
+
+    bool _pop(unsigned id, task& t)
+    {
+        // Own deque is used as a stack to keep the working set small,
+        // stolen tasks are taken from the other end.
+        worker_queue& own = *_workers[id];
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                t = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                --_nQueued;
+                return true;
+            }
+        }
+        for (std::size_t k = 1; k < _workers.size(); ++k)
+        {
+            worker_queue& victim = *_workers[(id + k) % _workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                t = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --_nQueued;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool _acquire(unsigned id, task& t)
+    {
+        for (;;)
+        {
+            if (_bAbort) return false;
+            if (_pop(id, t)) return true;
+
+            std::unique_lock<std::mutex> lock(_idleMutex);
+            _idle.wait(lock, [this]() {
+                return _bAbort || _nQueued > 0 || _nPending == 0;
+            });
+            if (_nQueued == 0 && _nPending == 0) return false;
+        }
+    }
+
+    void _work(unsigned id)
+    {
+        std::vector<char> buf(1 << 16);
+        task t;
+        while (_acquire(id, t))
+        {
+            try
+            {
+                _scan(id, t, buf);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(_exceptionMutex);
+                if (!_exception) _exception = std::current_exception();
+                _bAbort = true;
+            }
+
+            if (--_nPending == 0 || _bAbort)
+            {
+                std::lock_guard<std::mutex> lock(_idleMutex);
+                _idle.notify_all();
+            }
+        }
+    }
+
+    bool _visit_once(const struct stat& st)
+    {
+        std::lock_guard<std::mutex> lock(_visitedMutex);
+        return _visited.insert(std::make_pair(st.st_dev, st.st_ino)).second;
+    }
+
+    static unsigned char _mode_to_type(mode_t mode)
+    {
+        if (S_ISREG(mode)) return DT_REG;
+        if (S_ISDIR(mode)) return DT_DIR;
+        if (S_ISLNK(mode)) return DT_LNK;
+        if (S_ISFIFO(mode)) return DT_FIFO;
+        if (S_ISSOCK(mode)) return DT_SOCK;
+        if (S_ISCHR(mode)) return DT_CHR;
+        if (S_ISBLK(mode)) return DT_BLK;
+        return DT_UNKNOWN;
+    }
+
+    void _scan(unsigned id, task& t, std::vector<char>& buf)
+    {
+        int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+        if (t.depth > 0 && !_bFollowSymlinks) flags |= O_NOFOLLOW;
+        int fd = t.parent ? ::openat(t.parent->fd, t.name.c_str(), flags)
+                          : ::openat(AT_FDCWD, t.path.c_str(), flags);
+        if (fd < 0 && t.parent && (errno == EMFILE || errno == ENFILE))
+        {
+            // Out of fds, hold fewer of them and let the parent go, it may
+            // be its last reference.
+            _maxOpenDirs = _nOpenDirs / 2;
+            t.parent.reset();
+            fd = ::openat(AT_FDCWD, t.path.c_str(), flags);
+        }
+        if (fd < 0)
+        {
+            ++_nErrors;
+            return;
+        }
+        // Shared with the tasks of the sub-directories.
+        std::shared_ptr<const directory_fd> handle =
+            std::make_shared<directory_fd>(fd, _nOpenDirs);
+        t.parent.reset();
+
+        if (_bFollowSymlinks)
+        {
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || !_visit_once(st))
+                return;
+        }
+
+        std::string prefix = t.path;
+        if (prefix.empty() || prefix[prefix.size()-1] != '/')
+            prefix += '/';
+
+        auto onEntry = [&](const char* name, unsigned char type) {
+            if (name[0] == '.' &&
+                (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                return;
+            if (_bAbort) return;
+
+            directory_entry entry;
+            entry.name = name;
+            entry.path = prefix + entry.name;
+            entry.depth = t.depth + 1;
+            entry.type = type;
+
+            bool bFollow = _bFollowSymlinks && type == DT_LNK;
+            if (_bStat || type == DT_UNKNOWN || bFollow)
+            {
+                int statFlags = _bFollowSymlinks ? 0 : AT_SYMLINK_NOFOLLOW;
+                if (::fstatat(fd, name, &entry.status, statFlags) == 0)
+                {
+                    entry.bHasStatus = true;
+                    entry.type = _mode_to_type(entry.status.st_mode);
+                }
+            }
+
+            if (entry.is_directory() &&
+                (_maxDepth < 0 || entry.depth < _maxDepth) &&
+                (!_descend || _descend(entry)))
+            {
+                // Past the budget the sub-directory is opened by its path.
+                if (_nOpenDirs <= _maxOpenDirs)
+                    _push(id, task{ entry.path, entry.depth, handle, entry.name });
+                else
+                    _push(id, task{ entry.path, entry.depth, nullptr, entry.name });
+            }
+
+            if (!_filter || _filter(entry))
+            {
+                _callback(entry);
+                ++_nReported;
+            }
+        };
+
+#ifdef __linux__
+        struct linux_dirent64
+        {
+            ino64_t d_ino;
+            off64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[1];
+        };
+
+        for (;;)
+        {
+            long nread = ::syscall(SYS_getdents64, fd, buf.data(), buf.size());
+            if (nread < 0) { ++_nErrors; break; }
+            if (nread == 0) break;
+            for (long pos = 0; pos < nread; )
+            {
+                linux_dirent64* d = (linux_dirent64*)(buf.data() + pos);
+                onEntry(d->d_name, d->d_type);
+                pos += d->d_reclen;
+            }
+        }
+#else
+        int dupfd = ::dup(fd);
+        DIR* dir = (dupfd < 0) ? nullptr : ::fdopendir(dupfd);
+        if (dir == nullptr)
+        {
+            if (dupfd >= 0) ::close(dupfd);
+            ++_nErrors;
+            return;
+        }
+        while (struct dirent* d = ::readdir(dir))
+            onEntry(d->d_name, d->d_type);
+        ::closedir(dir);
+#endif
+    }
+
+};
+
+}
+}
@@ -0,0 +1,303 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * durable_writer.hpp - group commit of records to disk, atomic file replacement
+ * dependency : file.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file.hpp"
+
+namespace donny {
+namespace detail {
+
+inline bool write_all(int fd, const char* p, std::size_t n)
+{
+    while (n)
+    {
+        ssize_t nWritten = ::write(fd, p, n);
+        if (nWritten < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += nWritten;
+        n -= (std::size_t)nWritten;
+    }
+    return true;
+}
+
+// The process umask, read without changing it where the system allows:
+// umask() can only be read by setting it, which races with other threads
+// creating files.
+inline mode_t current_umask()
+{
+#ifdef __linux__
+    if (FILE* f = fopen("/proc/self/status", "re"))
+    {
+        char line[256];
+        unsigned mask = 0;
+        bool bFound = false;
+        while (!bFound && fgets(line, sizeof(line), f))
+            bFound = (sscanf(line, "Umask: %o", &mask) == 1);
+        fclose(f);
+        if (bFound) return (mode_t)mask;
+    }
+#endif
+    mode_t mask = umask(022);
+    umask(mask);
+    return mask;
+}
+
+inline bool data_sync(int fd)
+{
+#if defined(__linux__)
+    return fdatasync(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+}
+
+namespace filesystem {
+
+/**
+ *  Appends records to a file with durability guarantees. Any number of
+ *  threads submit records; a committer thread takes everything submitted
+ *  so far, writes it with a single write and a single fdatasync, then
+ *  completes the futures of the whole batch. Throughput grows with the
+ *  number of concurrent submitters instead of being one sync per record.
+ *
+ *  Records are written as is, in submission order. Wrap them with
+ *  record_writer framing beforehand if the reader needs to find them.
+ *
+ *  Usage:
+ *      durable_writer audit("audit.log");
+ *      std::future<bool> done = audit.submit(line);
+ *      ...
+ *      if (!done.get()) ... // the record may not be on disk
+ */
+class durable_writer
+{
+public:
+    using SizeType = std::size_t;
+
+    /**
+     *  @param maxBatch : a batch stops growing at this many bytes, later
+     *                    records wait for the next commit.
+     */
+    explicit durable_writer(basic_file<char> f, SizeType maxBatch = 1 << 22)
+        : _file(f)
+        , _maxBatch(maxBatch)
+    {
+        if (!_file.is_open()) return;
+        _file.flush(); // anything written through f goes first
+        _fd = fileno(_file.getFILE());
+        _committer = std::thread(&durable_writer::_commit_loop, this);
+    }
+    // Open filename for appending, create it if needed.
+    explicit durable_writer(const std::string& filename, SizeType maxBatch = 1 << 22)
+        : durable_writer(basic_file<char>(filename.c_str(), "ab"), maxBatch)
+    {
+    }
+    ~durable_writer()
+    {
+        close();
+    }
+
+    durable_writer(const durable_writer&) = delete;
+    durable_writer& operator=(const durable_writer&) = delete;
+
+    bool is_open() const { return _fd >= 0; }
+
+    /**
+     *  Queue a record. The future becomes true once the record is on disk,
+     *  false if it couldn't be written or the writer is closed.
+     */
+    std::future<bool> submit(std::string record)
+    {
+        std::promise<bool> done;
+        std::future<bool> result = done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_bClosed || _fd < 0)
+            {
+                done.set_value(false);
+                return result;
+            }
+            _pending.push_back(pending_record{ std::move(record), std::move(done) });
+        }
+        _cvPending.notify_one();
+        return result;
+    }
+    std::future<bool> submit(const void* data, SizeType size)
+    {
+        return submit(std::string((const char*)data, size));
+    }
+
+    // Submit and wait.
+    bool write(const void* data, SizeType size)
+    {
+        return submit(data, size).get();
+    }
+    bool write(const std::string& record)
+    {
+        return submit(record).get();
+    }
+
+    // Commit what is queued and stop the committer.
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_bClosed) return;
+            _bClosed = true;
+        }
+        _cvPending.notify_one();
+        if (_committer.joinable()) _committer.join();
+    }
+
+    SizeType records() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _nRecords;
+    }
+    // Number of fdatasync calls so far.
+    SizeType commits() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _nCommits;
+    }
+
+private:
+    struct pending_record
+    {
+        std::string data;
+        std::promise<bool> done;
+    };
+
+    basic_file<char> _file;
+    int _fd = -1;
+    SizeType _maxBatch;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cvPending;
+    std::vector<pending_record> _pending;
+    bool _bClosed = false;
+    std::thread _committer;
+
+    SizeType _nRecords = 0;
+    SizeType _nCommits = 0;
+
+    void _commit_loop()
+    {
+        std::vector<pending_record> batch;
+        std::string buffer;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cvPending.wait(lock, [this]() { return _bClosed || !_pending.empty(); });
+                if (_pending.empty()) return; // closed and drained
+
+                // Take records up to _maxBatch bytes, at least one.
+                SizeType n = 0, nBytes = 0;
+                while (n < _pending.size() &&
+                       (n == 0 || nBytes + _pending[n].data.size() <= _maxBatch))
+                    nBytes += _pending[n++].data.size();
+                batch.clear();
+                for (SizeType ind = 0; ind < n; ++ind)
+                    batch.push_back(std::move(_pending[ind]));
+                _pending.erase(_pending.begin(), _pending.begin() + n);
+            }
+
+            buffer.clear();
+            for (const pending_record& r : batch)
+                buffer += r.data;
+            bool bSucceed = detail::write_all(_fd, buffer.data(), buffer.size())
+                         && detail::data_sync(_fd);
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                ++_nCommits;
+                if (bSucceed) _nRecords += batch.size();
+            }
+            for (pending_record& r : batch)
+                r.done.set_value(bSucceed);
+        }
+    }
+
+};
+
+/**
+ *  fsync the directory itself, so that entries created, renamed or
+ *  removed in it survive a crash.
+ */
+inline bool sync_directory(const std::string& dirname)
+{
+    int fd = ::open(dirname.empty() ? "." : dirname.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool bSucceed = (fsync(fd) == 0);
+    ::close(fd);
+    return bSucceed;
+}
+
+/**
+ *  Replace filename with data, atomically: readers and crashes see either
+ *  the old content or the new one, never a mix. The data is written to a
+ *  temporary file next to filename, synced, renamed over filename, and
+ *  the directory is synced. The temporary file is created by mkstemp, so
+ *  concurrent replacements of the same file never share it.
+ *
+ *  The new file keeps the permissions of the file it replaces, or gets
+ *  0666 minus the umask when there was none.
+ */
+inline bool atomic_write_file(const std::string& filename, const void* data, std::size_t size)
+{
+    std::string::size_type slash = filename.rfind('/');
+    std::string dirname = (slash == std::string::npos) ? "." : filename.substr(0, slash + 1);
+    std::string tmpname = filename + ".tmp.XXXXXX";
+
+    struct stat st;
+    const mode_t mode = (::stat(filename.c_str(), &st) == 0)
+        ? (st.st_mode & 07777) : (0666 & ~detail::current_umask());
+
+    int fd = mkstemp(&tmpname[0]);
+    if (fd < 0) return false;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    bool bSucceed = fchmod(fd, mode) == 0 &&
+        detail::write_all(fd, (const char*)data, size) && fsync(fd) == 0;
+    bSucceed = (::close(fd) == 0) && bSucceed;
+    if (!bSucceed || rename(tmpname.c_str(), filename.c_str()) != 0)
+    {
+        unlink(tmpname.c_str());
+        return false;
+    }
+    return sync_directory(dirname);
+}
+inline bool atomic_write_file(const std::string& filename, const std::string& content)
+{
+    return atomic_write_file(filename, content.data(), content.size());
+}
+
+}
+}
@@ -0,0 +1,548 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * external_sort.hpp - sort files larger than memory
+ * dependency : file.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "file.hpp"
+
+namespace donny {
+namespace detail {
+
+// A line (without its '\n') or a fixed-size record.
+struct sort_item
+{
+    const char* p;
+    std::size_t n;
+};
+
+// Default orders, bytewise.
+struct line_bytes_less
+{
+    bool operator()(const sort_item& a, const sort_item& b) const
+    {
+        int c = memcmp(a.p, b.p, a.n < b.n ? a.n : b.n);
+        return c < 0 || (c == 0 && a.n < b.n);
+    }
+};
+struct record_bytes_less
+{
+    std::size_t recordSize;
+    bool operator()(const sort_item& a, const sort_item& b) const
+    {
+        return memcmp(a.p, b.p, recordSize) < 0;
+    }
+};
+
+/**
+ *  How items are laid out: lines ended by '\n', or records of a fixed
+ *  size. Lines are always written back with their '\n', even the last one.
+ */
+struct sort_format
+{
+    std::size_t recordSize; // 0 for lines
+
+    // Split [p, p+n) into items. @return bytes used, the rest is a partial item.
+    std::size_t split(const char* p, std::size_t n, std::vector<sort_item>& items, bool bLast) const
+    {
+        const char* const begin = p;
+        const char* const end = p + n;
+        if (recordSize)
+        {
+            for (; (std::size_t)(end - p) >= recordSize; p += recordSize)
+                items.push_back(sort_item{ p, recordSize });
+        }
+        else
+        {
+            const char* nl;
+            while ((nl = (const char*)memchr(p, '\n', end - p)) != nullptr)
+            {
+                items.push_back(sort_item{ p, (std::size_t)(nl - p) });
+                p = nl + 1;
+            }
+            if (bLast && p != end)
+            {
+                items.push_back(sort_item{ p, (std::size_t)(end - p) });
+                p = end;
+            }
+        }
+        return p - begin;
+    }
+
+    void append(std::string& out, const sort_item& item) const
+    {
+        out.append(item.p, item.n);
+        if (recordSize == 0) out += '\n';
+    }
+};
+
+// Buffered output, written in large blocks.
+class sort_output
+{
+public:
+    sort_output(filesystem::basic_file<char> f, std::size_t bufferSize)
+        : _file(f)
+        , _bufferSize(bufferSize)
+    {
+        _buffer.reserve(bufferSize + 4096);
+    }
+
+    void write(const sort_format& format, const sort_item& item)
+    {
+        format.append(_buffer, item);
+        if (_buffer.size() >= _bufferSize) flush();
+    }
+    void flush()
+    {
+        if (_buffer.empty()) return;
+        if (_file.write(_buffer.data(), 1, _buffer.size()) != _buffer.size())
+            throw std::runtime_error("external_sort: write failed");
+        _buffer.clear();
+    }
+
+private:
+    filesystem::basic_file<char> _file;
+    std::size_t _bufferSize;
+    std::string _buffer;
+
+};
+
+// Reads the items of a sorted run back, one at a time.
+class run_reader
+{
+public:
+    run_reader(filesystem::basic_file<char> f, const sort_format& format, std::size_t bufferSize)
+        : _file(f)
+        , _format(format)
+        , _buffer(std::max<std::size_t>(bufferSize, format.recordSize * 2 + 64))
+    {
+    }
+
+    // The current item stays valid until the next call.
+    bool next()
+    {
+        for (;;)
+        {
+            const char* p = _buffer.data() + _begin;
+            std::size_t nAvail = _end - _begin;
+            if (_format.recordSize)
+            {
+                if (nAvail >= _format.recordSize)
+                {
+                    _item = sort_item{ p, _format.recordSize };
+                    _begin += _format.recordSize;
+                    return true;
+                }
+            }
+            else
+            {
+                const char* nl = (const char*)memchr(p, '\n', nAvail);
+                if (nl != nullptr)
+                {
+                    _item = sort_item{ p, (std::size_t)(nl - p) };
+                    _begin += _item.n + 1;
+                    return true;
+                }
+                if (_bEof && nAvail != 0)
+                {
+                    _item = sort_item{ p, nAvail };
+                    _begin = _end;
+                    return true;
+                }
+            }
+            if (_bEof) return false;
+            _refill();
+        }
+    }
+    const sort_item& item() const { return _item; }
+
+private:
+    filesystem::basic_file<char> _file;
+    sort_format _format;
+    std::vector<char> _buffer;
+    std::size_t _begin = 0;
+    std::size_t _end = 0;
+    bool _bEof = false;
+    sort_item _item = { nullptr, 0 };
+
+    void _refill()
+    {
+        if (_begin != 0)
+        {
+            memmove(&_buffer[0], &_buffer[_begin], _end - _begin);
+            _end -= _begin;
+            _begin = 0;
+        }
+        if (_end == _buffer.size())
+            _buffer.resize(_buffer.size() * 2); // a line longer than the buffer
+        std::size_t nRead = _file.read(&_buffer[_end], 1, _buffer.size() - _end);
+        if (nRead == 0) _bEof = true;
+        _end += nRead;
+    }
+};
+
+/**
+ *  Tournament tree of losers over k sources. The root holds the index of
+ *  the smallest current item, every inner node the loser of the match
+ *  played there, so replacing the winner costs log2(k) comparisons.
+ */
+template<typename SourceLess>
+class loser_tree
+{
+public:
+    loser_tree(int k, SourceLess less)
+        : _k(k)
+        , _less(less)
+        , _loser(k)
+    {
+        std::vector<int> winner(2 * k);
+        for (int ind = 0; ind < k; ++ind)
+            winner[k + ind] = ind;
+        for (int node = k - 1; node >= 1; --node)
+        {
+            int a = winner[2 * node], b = winner[2 * node + 1];
+            bool bFirst = !_less(b, a);
+            winner[node] = bFirst ? a : b;
+            _loser[node] = bFirst ? b : a;
+        }
+        _loser[0] = (k == 1) ? 0 : winner[1];
+    }
+
+    int winner() const { return _loser[0]; }
+
+    // The winner's source moved to its next item, replay its path.
+    void replay()
+    {
+        int w = _loser[0];
+        for (int node = (w + _k) / 2; node >= 1; node /= 2)
+            if (_less(_loser[node], w))
+                std::swap(_loser[node], w);
+        _loser[0] = w;
+    }
+
+private:
+    int _k;
+    SourceLess _less;
+    std::vector<int> _loser;
+};
+
+}
+
+namespace filesystem {
+
+/**
+ *  Sort text lines or fixed-size binary records of files larger than
+ *  memory.
+ *
+ *  The input is read in chunks that together fit the memory budget. Each
+ *  chunk is sorted on its own thread and spilled to an anonymous temporary
+ *  file while the next chunk is read. The sorted runs are then merged with
+ *  a loser tree, through large sequential buffers. When there are more runs
+ *  than the fan-in, groups of runs are merged first.
+ *
+ *  The sort is not stable.
+ *
+ *  Usage:
+ *      external_sorter sorter;
+ *      sorter.memory(1 << 30).threads(8);
+ *      sorter.sort_lines(file("big.log", "rb"), file("sorted.log", "wb"));
+ *
+ *      sorter.sort_records(in, out, 16, [](const char* a, const char* b) {
+ *          return *(const uint64_t*)a < *(const uint64_t*)b;
+ *      });
+ */
+class external_sorter
+{
+public:
+    using SizeType = std::size_t;
+
+    // Compare two lines, given without their '\n'.
+    typedef std::function<bool(const char*, SizeType, const char*, SizeType)> LineLess;
+    // Compare two records of the size given to sort_records().
+    typedef std::function<bool(const char*, const char*)> RecordLess;
+
+    external_sorter()
+    {
+    }
+
+    // Bytes of input held in memory at once, roughly.
+    external_sorter& memory(SizeType nBytes)
+    {
+        _memory = std::max<SizeType>(nBytes, 1 << 16);
+        return *this;
+    }
+    // 0 means std::thread::hardware_concurrency().
+    external_sorter& threads(unsigned nThreads)
+    {
+        _nThreads = nThreads;
+        return *this;
+    }
+    // Where the runs are spilled, $TMPDIR or /tmp by default.
+    external_sorter& temp_directory(const std::string& dir)
+    {
+        _tmpDir = dir;
+        return *this;
+    }
+    // Buffer size of every stream while merging.
+    external_sorter& buffer_size(SizeType nBytes)
+    {
+        _bufferSize = std::max<SizeType>(nBytes, 4096);
+        return *this;
+    }
+    // Maximum number of runs merged at once.
+    external_sorter& fan_in(SizeType nRuns)
+    {
+        _fanIn = std::max<SizeType>(nRuns, 2);
+        return *this;
+    }
+
+    /**
+     *  Sort the lines of in into out, bytewise by default.
+     *  @return the number of lines.
+     *  @throw std::runtime_error on I/O errors.
+     */
+    SizeType sort_lines(filesystem::basic_file<char> in, filesystem::basic_file<char> out, LineLess less = LineLess())
+    {
+        detail::sort_format format = { 0 };
+        if (!less)
+            return _sort(in, out, format, detail::line_bytes_less());
+        return _sort(in, out, format, [less](const detail::sort_item& a, const detail::sort_item& b) {
+            return less(a.p, a.n, b.p, b.n);
+        });
+    }
+
+    /**
+     *  Sort the records of recordSize bytes of in into out, bytewise by
+     *  default.
+     *  @return the number of records.
+     *  @throw std::runtime_error on I/O errors, or if the size of in is
+     *         not a multiple of recordSize.
+     */
+    SizeType sort_records(filesystem::basic_file<char> in, filesystem::basic_file<char> out,
+                          SizeType recordSize, RecordLess less = RecordLess())
+    {
+        if (recordSize == 0)
+            throw std::invalid_argument("external_sort: record size is 0");
+        detail::sort_format format = { recordSize };
+        if (!less)
+            return _sort(in, out, format, detail::record_bytes_less{ recordSize });
+        return _sort(in, out, format, [less](const detail::sort_item& a, const detail::sort_item& b) {
+            return less(a.p, b.p);
+        });
+    }
+
+private:
+    SizeType _memory = 256 << 20;
+    unsigned _nThreads = 0;
+    std::string _tmpDir;
+    SizeType _bufferSize = 1 << 20;
+    SizeType _fanIn = 256;
+
+    struct run
+    {
+        filesystem::basic_file<char> file;
+        SizeType nItems;
+    };
+
+    filesystem::basic_file<char> _temp_file() const
+    {
+        std::string dir = _tmpDir;
+        if (dir.empty())
+        {
+            const char* env = getenv("TMPDIR");
+            dir = (env && *env) ? env : "/tmp";
+        }
+        std::string pattern = dir + "/donny_sort_XXXXXX";
+        std::vector<char> name(pattern.begin(), pattern.end());
+        name.push_back('\0');
+
+        int fd = mkstemp(name.data());
+        if (fd < 0)
+            throw std::runtime_error("external_sort: can't create a temporary file in " + dir);
+        unlink(name.data()); // gone with the last close
+        FILE* f = fdopen(fd, "w+b");
+        if (f == nullptr)
+        {
+            ::close(fd);
+            throw std::runtime_error("external_sort: can't create a temporary file in " + dir);
+        }
+        return basic_file<char>(f, true);
+    }
+
+    // Sort a chunk and write it to out.
+    template<typename Less>
+    SizeType _sort_chunk(const std::vector<char>& chunk, SizeType n,
+                         filesystem::basic_file<char> out, const detail::sort_format& format,
+                         Less less) const
+    {
+        std::vector<detail::sort_item> items;
+        format.split(chunk.data(), n, items, true);
+        std::sort(items.begin(), items.end(), less);
+
+        detail::sort_output output(out, _bufferSize);
+        for (const detail::sort_item& item : items)
+            output.write(format, item);
+        output.flush();
+        return items.size();
+    }
+
+    template<typename Less>
+    SizeType _sort(basic_file<char>& in, basic_file<char>& out,
+                   const detail::sort_format& format, Less less) const
+    {
+        if (!in.is_open() || !out.is_open())
+            throw std::runtime_error("external_sort: file not open");
+        in.advise(basic_file<char>::sequential_access);
+
+        unsigned nThreads = _nThreads ? _nThreads : std::thread::hardware_concurrency();
+        if (nThreads == 0) nThreads = 1;
+
+        // Chunks in flight share the budget, items take 16 bytes each on top.
+        SizeType chunkSize = _memory / nThreads;
+        if (format.recordSize)
+        {
+            chunkSize = std::max(chunkSize, format.recordSize);
+            chunkSize -= chunkSize % format.recordSize;
+        }
+
+        std::vector<run> runs;
+        std::deque<std::future<run>> sorting;
+        std::vector<char> carry;
+        for (bool bEof = false; !bEof; )
+        {
+            std::vector<char> chunk(std::max(chunkSize, carry.size() * 2));
+            std::copy(carry.begin(), carry.end(), chunk.begin());
+            SizeType n = carry.size();
+            while (n < chunk.size())
+            {
+                SizeType nRead = in.read(&chunk[n], 1, chunk.size() - n);
+                if (nRead == 0) break;
+                n += nRead;
+            }
+            bEof = (n < chunk.size());
+
+            // Keep the partial item at the end for the next chunk.
+            SizeType used = n;
+            if (!bEof)
+            {
+                if (format.recordSize)
+                    used = n - n % format.recordSize;
+                else
+                {
+                    const char* p = chunk.data();
+                    while (used > 0 && p[used - 1] != '\n') --used;
+                }
+            }
+            else if (format.recordSize && n % format.recordSize)
+                throw std::runtime_error("external_sort: input size is not a multiple of the record size");
+            carry.assign(chunk.begin() + used, chunk.begin() + n);
+            if (used == 0 && !bEof) continue; // a line longer than the chunk
+
+            // Everything fits in one chunk, no need for runs.
+            if (bEof && runs.empty() && sorting.empty())
+            {
+                SizeType nItems = _sort_chunk(chunk, used, out, format, less);
+                out.flush();
+                return nItems;
+            }
+
+            if (sorting.size() >= nThreads)
+            {
+                runs.push_back(sorting.front().get());
+                sorting.pop_front();
+            }
+            std::shared_ptr<std::vector<char>> pChunk =
+                std::make_shared<std::vector<char>>(std::move(chunk));
+            sorting.push_back(std::async(std::launch::async, [this, pChunk, used, format, less]() {
+                run r = { _temp_file(), 0 };
+                r.nItems = _sort_chunk(*pChunk, used, r.file, format, less);
+                return r;
+            }));
+        }
+        for (std::future<run>& f : sorting)
+            runs.push_back(f.get());
+
+        // Merge groups of runs until one pass is enough.
+        while (runs.size() > _fanIn)
+        {
+            std::vector<run> group(runs.begin(), runs.begin() + _fanIn);
+            runs.erase(runs.begin(), runs.begin() + _fanIn);
+            run merged = { _temp_file(), 0 };
+            merged.nItems = _merge(group, merged.file, format, less);
+            runs.push_back(merged);
+        }
+        SizeType nItems = _merge(runs, out, format, less);
+        out.flush();
+        return nItems;
+    }
+
+    template<typename Less>
+    SizeType _merge(std::vector<run>& runs, filesystem::basic_file<char> out,
+                    const detail::sort_format& format, Less less) const
+    {
+        // Share the budget between the input streams.
+        SizeType bufferSize = std::min(_bufferSize, _memory / (runs.size() + 1));
+        bufferSize = std::max<SizeType>(bufferSize, 1 << 16);
+
+        std::vector<detail::run_reader> readers;
+        std::vector<bool> bHasItem(runs.size());
+        readers.reserve(runs.size());
+        for (SizeType ind = 0; ind < runs.size(); ++ind)
+        {
+            basic_file<char>& f = runs[ind].file;
+            if (f.flush() != 0 || !f.seek(0, basic_file<char>::begin))
+                throw std::runtime_error("external_sort: can't read back a run");
+            f.drop_behind(true);
+            readers.push_back(detail::run_reader(f, format, bufferSize));
+            bHasItem[ind] = readers[ind].next();
+        }
+
+        // Exhausted runs lose every match, ties go to the earlier run.
+        auto sourceLess = [&](int a, int b) {
+            if (!bHasItem[a]) return false;
+            if (!bHasItem[b]) return true;
+            if (less(readers[a].item(), readers[b].item())) return true;
+            if (less(readers[b].item(), readers[a].item())) return false;
+            return a < b;
+        };
+        detail::loser_tree<decltype(sourceLess)> tree((int)runs.size(), sourceLess);
+
+        detail::sort_output output(out, _bufferSize);
+        SizeType nItems = 0;
+        for (;;)
+        {
+            int w = tree.winner();
+            if (!bHasItem[w]) break;
+            output.write(format, readers[w].item());
+            ++nItems;
+            bHasItem[w] = readers[w].next();
+            tree.replay();
+        }
+        output.flush();
+        return nItems;
+    }
+
+};
+
+}
+}
@@ -13,11 +13,82 @@
 #include <cstdarg>
 #include <cwchar>
 #include <string>
+#include <utility>
+#include <vector>
+
+#ifndef __WINOS__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "base.hpp"
 
 namespace donny {
 
+namespace detail {
+
+#ifdef __GLIBC__
+inline ssize_t null_read(void*, char*, size_t) { return 0; }
+inline ssize_t null_write(void*, const char*, size_t n) { return (ssize_t)n; }
+#endif
+
+// A FILE* that discards what is written, without a file descriptor.
+inline FILE* open_null()
+{
+#ifdef __GLIBC__
+	cookie_io_functions_t io = { null_read, null_write, nullptr, nullptr };
+	return fopencookie(nullptr, "w+", io);
+#elif defined(__WINOS__)
+	FILE *f = nullptr;
+	fopen_s(&f, "NUL", "wb");
+	return f;
+#else
+	return fopen("/dev/null", "wb");
+#endif
+}
+
+/*
+ *  The name of the file Get() returns, used as that file: dout.puts(s).
+ *  It holds nothing and is initialized at compile time, the file is only
+ *  created when the name is first used.
+ */
+template<typename File, File& (*Get)()>
+struct lazy_file
+{
+	operator File&() const { return Get(); }
+	File* operator->() const { return &Get(); }
+
+	LAZY_FORWARD(getFILE)
+	LAZY_FORWARD(file_size)
+	LAZY_FORWARD(open)
+	LAZY_FORWARD(close)
+	LAZY_FORWARD(is_open)
+	LAZY_FORWARD(eof)
+	LAZY_FORWARD(error)
+	LAZY_FORWARD(clearerr)
+	LAZY_FORWARD(tell)
+	LAZY_FORWARD(seek)
+	LAZY_FORWARD(rewind)
+	LAZY_FORWARD(getc)
+	LAZY_FORWARD(putc)
+	LAZY_FORWARD(gets)
+	LAZY_FORWARD(puts)
+	LAZY_FORWARD(read)
+	LAZY_FORWARD(write)
+	LAZY_FORWARD(vscanf)
+	LAZY_FORWARD(scanf)
+	LAZY_FORWARD(vprint)
+	LAZY_FORWARD(print)
+	LAZY_FORWARD(flush)
+	LAZY_FORWARD(advise)
+	LAZY_FORWARD(readahead)
+	LAZY_FORWARD(drop_behind)
+	LAZY_FORWARD(newLine)
+	LAZY_FORWARD(isNewLine)
+};
+
+}
+
 namespace filesystem {
 
 // Usage: basic_file::write(&UTF16LEHeader);
@@ -72,6 +143,9 @@ public:
 
 	enum SeekOrigin { begin = SEEK_SET, current = SEEK_CUR, end = SEEK_END };
 
+	// Access pattern hints, see advise().
+	enum AccessAdvice { normal_access, sequential_access, random_access, will_need, dont_need };
+
 	inline basic_file()
 	{
 	}
@@ -104,6 +178,12 @@ public:
 		_pFile->_refCount = 2; // Cause there already has another
 							   // reference to this file
 	}
+	// With bTakeOwnership, cfile is closed with the last reference.
+	inline basic_file(FILE* cfile, bool bTakeOwnership)
+		: basic_file(cfile)
+	{
+		if (_pFile && bTakeOwnership) _pFile->_refCount = 1;
+	}
 	inline FILE* getFILE()
 	{
 		return _File();
@@ -181,11 +261,13 @@ public:
 	}
 	inline bool seek(SizeType offset, SeekOrigin origin)
 	{
+		_ForgetPosition();
 		if (fseek(_File(), offset, origin)) return false;
 		else return true;
 	}
 	inline void rewind()
 	{
+		_ForgetPosition();
 		return ::rewind(_File());
 	}
 
@@ -213,8 +295,20 @@ public:
 	{
 		StringType buf;
 		CharType c = EOFValue;
-		while (((c = getc()) != EOFValue) && (c != endChar))
+		SizeType nRead = 0;
+		for (;;)
+		{
+			if (fread(&c, sizeof(CharType), 1, _File()) != 1)
+			{
+				c = EOFValue;
+				break;
+			}
+			++nRead;
+			if (c == EOFValue || c == endChar) break;
 			buf += c;
+		}
+		// Moves the drop behind position once for the whole line.
+		if (_pFile && _pFile->_dropWindow) _DropBehind(nRead * (SizeType)sizeof(CharType));
 		if ((bIncludeEndChar) && (c != EOFValue)) buf += c;
 		return buf;
 	}
@@ -245,7 +339,9 @@ public:
 	}
 	inline uint read(void *dest, uint elementSize, uint count)
 	{
-		return fread(dest, elementSize, count, _File());
+		uint n = fread(dest, elementSize, count, _File());
+		if (_pFile && _pFile->_dropWindow) _DropBehind((SizeType)n * elementSize);
+		return n;
 	}
 
 	template<typename T>
@@ -255,7 +351,10 @@ public:
 	}
 	inline uint write(const void *src, uint elementSize, uint count)
 	{
-		return fwrite(src, elementSize, count, _File());
+		uint n = fwrite(src, elementSize, count, _File());
+		if (_pFile && _pFile->_dropWindow && _pFile->_bPositionKnown)
+			_pFile->_position += (SizeType)n * elementSize;
+		return n;
 	}
 
 	inline int vscanf(const StringType format_, va_list args_);
@@ -268,6 +367,47 @@ public:
 	{
 		return fflush(_File());
 	}
+
+	/**
+	 *  Tell the kernel how [offset, offset+len) will be accessed,
+	 *  len = 0 means up to the end of the file. It's only a hint.
+	 *  @return false if not supported.
+	 */
+	inline bool advise(AccessAdvice advice, SizeType offset = 0, SizeType len = 0)
+	{
+#if defined(POSIX_FADV_NORMAL)
+		static const int flags[] = { POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL,
+			POSIX_FADV_RANDOM, POSIX_FADV_WILLNEED, POSIX_FADV_DONTNEED };
+		if (!is_open()) return false;
+		return posix_fadvise(fileno(_File()), offset, len, flags[advice]) == 0;
+#else
+		return false;
+#endif
+	}
+	// Start reading [offset, offset+len) into the page cache, without waiting.
+	inline bool readahead(SizeType offset, SizeType len)
+	{
+#if defined(__linux__)
+		if (!is_open()) return false;
+		return ::readahead(fileno(_File()), offset, len) == 0;
+#else
+		return advise(will_need, offset, len);
+#endif
+	}
+	/**
+	 *  Drop behind: while reading forward, release the pages already read
+	 *  from the page cache, window bytes at a time, so a long scan doesn't
+	 *  evict everything else. Also hints sequential access.
+	 *  Shared by the copies of this file.
+	 */
+	inline bool drop_behind(bool bEnable = true, SizeType window = 8 << 20)
+	{
+		if (!is_open()) return false;
+		_pFile->_dropWindow = bEnable ? window : 0;
+		_pFile->_dropped = 0;
+		_pFile->_bPositionKnown = false;
+		return advise(bEnable ? sequential_access : normal_access);
+	}
 	
 #ifdef __WINOS__
 	const CharType lineBreak[3] = { '\r', '\n', '\0' };
@@ -306,6 +446,12 @@ private:
 	{
 		FILE *_file = nullptr;
 		uint _refCount = 1;
+		SizeType _dropWindow = 0; // 0 when drop behind is off
+		SizeType _dropped = 0;    // pages before are released
+		// While drop behind is on, the position is counted from the bytes
+		// read and written, ftell is only called after a seek.
+		SizeType _position = 0;
+		bool _bPositionKnown = false;
 	} *_pFile = nullptr;
 
 	FILE * _File() const
@@ -318,6 +464,31 @@ private:
 		if (_pFile == nullptr || _pFile->_file) return;
 		_pFile->_file = file_;
 	}
+	void _ForgetPosition()
+	{
+		if (_pFile) _pFile->_bPositionKnown = false;
+	}
+	// nRead bytes were just read.
+	void _DropBehind(SizeType nRead)
+	{
+		if (_pFile->_bPositionKnown)
+			_pFile->_position += nRead;
+		else
+		{
+			_pFile->_position = tell();
+			_pFile->_bPositionKnown = (_pFile->_position >= 0);
+		}
+		SizeType pos = _pFile->_position;
+		if (pos < 0) return;
+		if (pos < _pFile->_dropped) // moved backwards
+			_pFile->_dropped = 0;
+		if (pos - _pFile->_dropped < _pFile->_dropWindow) return;
+		// Keep the page under the position, it's likely still buffered.
+		SizeType to = pos & ~(SizeType)4095;
+		if (to <= _pFile->_dropped) return; // len 0 would mean the whole file
+		advise(dont_need, _pFile->_dropped, to - _pFile->_dropped);
+		_pFile->_dropped = to;
+	}
 
 };
 
@@ -326,16 +497,44 @@ typedef basic_file<wchar_t> wfile;
 typedef basic_file<char16_t> u16file;
 typedef basic_file<char32_t> u32file;
 
-static file din(stdin);
-static file dout(stdout);
-static file derr(stderr);
+/**
+ *  The shared standard and null files. They are created on first use, once
+ *  for the whole program whatever the number of translation units, and
+ *  never destroyed, so they can be used from destructors of static objects.
+ */
+inline file& std_in()
+{
+	static file* f = new file(stdin);
+	return *f;
+}
+inline file& std_out()
+{
+	static file* f = new file(stdout);
+	return *f;
+}
+inline file& std_err()
+{
+	static file* f = new file(stderr);
+	return *f;
+}
+template<typename CharType>
+inline basic_file<CharType>& null_file()
+{
+	static basic_file<CharType>* f = new basic_file<CharType>(detail::open_null(), true);
+	return *f;
+}
+
+constexpr detail::lazy_file<file, std_in> din = {};
+constexpr detail::lazy_file<file, std_out> dout = {};
+constexpr detail::lazy_file<file, std_err> derr = {};
 
-static file dnull("/dev/null", "wb");
-static wfile dwnull("/dev/null", "wb");
+constexpr detail::lazy_file<file, null_file<char> > dnull = {};
+constexpr detail::lazy_file<wfile, null_file<wchar_t> > dwnull = {};
 
 template<>
 inline int file::vscanf(const file::StringType format_, va_list args_)
 {
+	_ForgetPosition();
 	return vfscanf(_File(), format_.c_str(), args_);
 }
 template<>
@@ -347,14 +546,18 @@ inline int file::scanf(const file::StringType format_, ...)
 template<>
 inline int file::vprint(const file::StringType format_, va_list args_)
 {
-	// return vfprintf(_File(), format_.c_str(), args_);
+	// Format once into the stack for the usual short messages.
+	char local[256];
 	va_list args;
-	va_copy(args,args_);
-	int sz = vfprintf(dnull.getFILE(), format_.c_str(), args);
+	va_copy(args, args_);
+	int sz = vsnprintf(local, sizeof(local), format_.c_str(), args);
 	va_end(args);
-	char buf[sz+1];
-	vsnprintf(buf, sz+1, format_.c_str(), args_);
-	return write(buf, sz);
+	if (sz < 0) return sz;
+	if (sz < (int)sizeof(local)) return write(local, sz);
+
+	BufStringType buf(sz + 1);
+	vsnprintf(buf.data(), sz + 1, format_.c_str(), args_);
+	return write(buf.data(), sz);
 }
 template<>
 inline int file::print(const file::StringType format_, ...)
@@ -367,6 +570,7 @@ inline int file::print(const file::StringType format_, ...)
 template<>
 inline int wfile::vscanf(const wfile::StringType format_, va_list args_)
 {
+	_ForgetPosition();
 	return vfwscanf(_File(), format_.c_str(), args_);
 }
 template<>
@@ -378,14 +582,23 @@ inline int wfile::scanf(const wfile::StringType format_, ...)
 template<>
 inline int wfile::vprint(const wfile::StringType format_, va_list args_)
 {
-	va_list args;
-	va_copy(args,args_);
-	int sz = vfwprintf(dwnull.getFILE(), format_.c_str(), args);
-	va_end(args);
-	wchar_t buf[sz+1];
-	vswprintf(buf, sz+1, format_.c_str(), args_);
-	return write(buf, sz);
-	// return vfwprintf(_File(), format_.c_str(), args_);
+	// vswprintf can't tell the size it needs, grow until it fits.
+	wchar_t local[256];
+	std::vector<wchar_t> buf;
+	wchar_t *p = local;
+	int n = (int)length_of_array(local);
+	for (;;)
+	{
+		va_list args;
+		va_copy(args, args_);
+		int sz = vswprintf(p, n, format_.c_str(), args);
+		va_end(args);
+		if (sz >= 0) return write(p, sz);
+		if (n >= (1 << 24)) return sz; // not a size problem
+		n *= 2;
+		buf.resize(n);
+		p = buf.data();
+	}
 }
 template<>
 inline int wfile::print(const wfile::StringType format_, ...)
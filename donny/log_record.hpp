@@ -0,0 +1,328 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * log_record.hpp - key-value fields and JSON/logfmt encoding of log records
+ * dependency : cpu_features.hpp, unicode.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <string>
+#include <type_traits>
+
+#include "cpu_features.hpp"
+#include "unicode.hpp"
+
+namespace donny {
+
+/**
+ *  A named value of a structured log record. It refers to the value, so
+ *  build it in the logging call itself.
+ *
+ *  Usage:
+ *      log.i("request done", kv("user", id), kv("latency_us", t));
+ */
+template<typename T>
+struct kv_field
+{
+    const char* key;
+    const T& value;
+};
+
+template<typename T>
+inline kv_field<T> kv(const char* key, const T& value)
+{
+    return kv_field<T>{ key, value };
+}
+
+namespace detail {
+
+/*
+ *  Position of the first byte of [p, p+n) that can't be copied as is into
+ *  a quoted string: '"', '\\' and control characters. With bLogfmt, also
+ *  ' ' and '=', which make a logfmt value need quotes. n if there is none.
+ */
+inline std::size_t find_escape_scalar(const char* p, std::size_t n, bool bLogfmt)
+{
+    for (std::size_t ind = 0; ind < n; ++ind)
+    {
+        unsigned char c = (unsigned char)p[ind];
+        if (c < 0x20 || c == '"' || c == '\\') return ind;
+        if (bLogfmt && (c == ' ' || c == '=')) return ind;
+    }
+    return n;
+}
+
+#if DONNY_X86
+DONNY_TARGET("sse2")
+inline std::size_t find_escape_sse2(const char* p, std::size_t n, bool bLogfmt)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    // Without bLogfmt the extra bytes repeat the quote and match nothing new.
+    const __m128i space = _mm_set1_epi8(bLogfmt ? ' ' : '"');
+    const __m128i equal = _mm_set1_epi8(bLogfmt ? '=' : '"');
+    const __m128i ctrl = _mm_set1_epi8(0x1F);
+    std::size_t ind = 0;
+    for (; ind + 16 <= n; ind += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)(p + ind));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)),
+            _mm_or_si128(_mm_cmpeq_epi8(x, space), _mm_cmpeq_epi8(x, equal)));
+        // x <= 0x1F exactly when max(x, 0x1F) is 0x1F
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(x, ctrl), ctrl));
+        unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        if (mask) return ind + __builtin_ctz(mask);
+    }
+    return ind + find_escape_scalar(p + ind, n - ind, bLogfmt);
+}
+
+DONNY_TARGET("avx2")
+inline std::size_t find_escape_avx2(const char* p, std::size_t n, bool bLogfmt)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i space = _mm256_set1_epi8(bLogfmt ? ' ' : '"');
+    const __m256i equal = _mm256_set1_epi8(bLogfmt ? '=' : '"');
+    const __m256i ctrl = _mm256_set1_epi8(0x1F);
+    std::size_t ind = 0;
+    for (; ind + 32 <= n; ind += 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(p + ind));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, quote), _mm256_cmpeq_epi8(x, backslash)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, space), _mm256_cmpeq_epi8(x, equal)));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_max_epu8(x, ctrl), ctrl));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if (mask) return ind + __builtin_ctz(mask);
+    }
+    return ind + find_escape_sse2(p + ind, n - ind, bLogfmt);
+}
+#endif
+
+typedef std::size_t (*find_escape_fn)(const char*, std::size_t, bool);
+
+inline find_escape_fn find_escape_impl()
+{
+    static const find_escape_fn fn = []() -> find_escape_fn {
+#if DONNY_X86
+        if (cpu().avx2) return find_escape_avx2;
+        if (cpu().sse2) return find_escape_sse2;
+#endif
+        return find_escape_scalar;
+    }();
+    return fn;
+}
+
+// Append p as the content of a JSON string, without the quotes.
+inline void append_escaped(std::string& out, const char* p, std::size_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+    const find_escape_fn find = find_escape_impl();
+    while (n)
+    {
+        std::size_t k = find(p, n, false);
+        out.append(p, k);
+        if (k == n) return;
+
+        unsigned char c = (unsigned char)p[k];
+        switch (c)
+        {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0xF];
+        }
+        p += k + 1;
+        n -= k + 1;
+    }
+}
+
+inline void append_string(std::string& out, bool bJson, const char* p, std::size_t n)
+{
+    // A logfmt value is quoted only when it has to be.
+    if (!bJson && n != 0 && find_escape_impl()(p, n, true) == n)
+    {
+        out.append(p, n);
+        return;
+    }
+    out += '"';
+    append_escaped(out, p, n);
+    out += '"';
+}
+
+template<typename T>
+inline void append_integer(std::string& out, T v)
+{
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* s = end;
+    typedef typename std::make_unsigned<T>::type U;
+    U u = (v < 0) ? (U)(0 - (U)v) : (U)v;
+    do { *--s = (char)('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) *--s = '-';
+    out.append(s, end - s);
+}
+
+// Shortest text that reads back as v.
+inline void append_floating(std::string& out, bool bJson, double v)
+{
+    if (v != v || v - v != 0) // nan or inf
+    {
+        out += bJson ? "null" : (v != v ? "NaN" : (v > 0 ? "+Inf" : "-Inf"));
+        return;
+    }
+    // Most values have few decimals: print them as a scaled integer when
+    // that reads back exactly. The division is correctly rounded, like the
+    // parse of the printed text would be.
+    double scaled = v * 1e6;
+    if (scaled > -9e15 && scaled < 9e15)
+    {
+        long long n = llround(scaled);
+        if ((double)n / 1e6 == v)
+        {
+            unsigned long long u = (n < 0) ? (unsigned long long)-n : (unsigned long long)n;
+            if (n < 0) out += '-';
+            append_integer(out, u / 1000000);
+            unsigned frac = (unsigned)(u % 1000000);
+            if (frac)
+            {
+                char digits[7] = { '.' };
+                int len = 7;
+                for (int ind = 6; ind >= 1; --ind, frac /= 10)
+                    digits[ind] = (char)('0' + frac % 10);
+                while (digits[len - 1] == '0') --len;
+                out.append(digits, len);
+            }
+            return;
+        }
+    }
+
+    char buf[32];
+    int len = 0;
+    for (int precision = 15; precision <= 17; ++precision)
+    {
+        len = snprintf(buf, sizeof(buf), "%.*g", precision, v);
+        if (strtod(buf, nullptr) == v) break;
+    }
+    out.append(buf, len);
+}
+
+inline void append_value(std::string& out, bool, bool v)
+{
+    out += v ? "true" : "false";
+}
+inline void append_value(std::string& out, bool, std::nullptr_t)
+{
+    out += "null";
+}
+inline void append_value(std::string& out, bool bJson, char c)
+{
+    append_string(out, bJson, &c, 1);
+}
+inline void append_value(std::string& out, bool bJson, const char* s)
+{
+    if (s == nullptr)
+        out += "null";
+    else
+        append_string(out, bJson, s, strlen(s));
+}
+inline void append_value(std::string& out, bool bJson, const std::string& s)
+{
+    append_string(out, bJson, s.data(), s.size());
+}
+inline void append_value(std::string& out, bool bJson, const std::wstring& s)
+{
+    std::string utf8 = unicode::wstring_to_utf8(s);
+    append_string(out, bJson, utf8.data(), utf8.size());
+}
+inline void append_value(std::string& out, bool bJson, const wchar_t* s)
+{
+    if (s == nullptr)
+        out += "null";
+    else
+        append_value(out, bJson, std::wstring(s));
+}
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value>::type
+    append_value(std::string& out, bool, T v)
+{
+    append_integer(out, v);
+}
+template<typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+    append_value(std::string& out, bool bJson, T v)
+{
+    append_floating(out, bJson, (double)v);
+}
+
+// Records are UTF-8: strings of wide loggers are converted into scratch.
+inline const std::string& as_utf8(const std::string& s, std::string&)
+{
+    return s;
+}
+inline const std::string& as_utf8(const std::wstring& s, std::string& scratch)
+{
+    scratch = unicode::wstring_to_utf8(s);
+    return scratch;
+}
+
+// vsnprintf into out, reusing its capacity.
+inline void vformat_to(std::string& out, const char* format, va_list args)
+{
+    va_list copy;
+    va_copy(copy, args);
+    out.resize(out.capacity() > 256 ? out.capacity() : 256);
+    int len = vsnprintf(&out[0], out.size() + 1, format, copy);
+    va_end(copy);
+    if (len < 0) len = 0;
+    if ((std::size_t)len > out.size())
+    {
+        out.resize(len);
+        vsnprintf(&out[0], out.size() + 1, format, args);
+    }
+    out.resize(len);
+}
+inline void vformat_to(std::wstring& out, const wchar_t* format, va_list args)
+{
+    std::size_t size = out.capacity() > 256 ? out.capacity() : 256;
+    for (;;)
+    {
+        out.resize(size);
+        va_list copy;
+        va_copy(copy, args);
+        int len = vswprintf(&out[0], out.size() + 1, format, copy);
+        va_end(copy);
+        if (len >= 0)
+        {
+            out.resize(len);
+            return;
+        }
+        if (size >= (1u << 24))
+        {
+            out.clear();
+            return;
+        }
+        size *= 2;
+    }
+}
+
+}
+
+}
@@ -0,0 +1,460 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * log_search.hpp - search and follow logger output through memory mapping
+ * dependency : cpu_features.hpp, mapped_file.hpp, compressed_file.hpp, logger.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cpu_features.hpp"
+#include "mapped_file.hpp"
+#include "compressed_file.hpp"
+#include "logger.hpp"
+
+namespace donny {
+
+namespace detail {
+
+inline const char* find_substring_scalar(const char* hay, std::size_t n,
+                                         const char* needle, std::size_t m)
+{
+    return (const char*)memmem(hay, n, needle, m);
+}
+
+#if DONNY_X86
+/*
+ *  Compare the first and the last byte of the needle against 16 (or 32)
+ *  positions at once, and only memcmp the candidates where both match.
+ *  m >= 2.
+ */
+DONNY_TARGET("sse2")
+inline const char* find_substring_sse2(const char* hay, std::size_t n,
+                                       const char* needle, std::size_t m)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    std::size_t ind = 0;
+    for (; ind + m - 1 + 16 <= n; ind += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(hay + ind));
+        __m128i b = _mm_loadu_si128((const __m128i*)(hay + ind + m - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask)
+        {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(hay + ind + bit + 1, needle + 1, m - 2) == 0)
+                return hay + ind + bit;
+            mask &= mask - 1;
+        }
+    }
+    return find_substring_scalar(hay + ind, n - ind, needle, m);
+}
+
+DONNY_TARGET("avx2")
+inline const char* find_substring_avx2(const char* hay, std::size_t n,
+                                       const char* needle, std::size_t m)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    std::size_t ind = 0;
+    for (; ind + m - 1 + 32 <= n; ind += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(hay + ind));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(hay + ind + m - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (mask)
+        {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(hay + ind + bit + 1, needle + 1, m - 2) == 0)
+                return hay + ind + bit;
+            mask &= mask - 1;
+        }
+    }
+    return find_substring_scalar(hay + ind, n - ind, needle, m);
+}
+#endif
+
+typedef const char* (*find_substring_fn)(const char*, std::size_t, const char*, std::size_t);
+
+inline find_substring_fn find_substring_impl()
+{
+    static const find_substring_fn fn = []() -> find_substring_fn {
+#if DONNY_X86
+        if (cpu().avx2) return find_substring_avx2;
+        if (cpu().sse2) return find_substring_sse2;
+#endif
+        return find_substring_scalar;
+    }();
+    return fn;
+}
+
+}
+
+/**
+ *  First occurrence of needle in [hay, hay+n), nullptr if none.
+ */
+inline const char* find_substring(const char* hay, std::size_t n,
+                                  const char* needle, std::size_t m)
+{
+    if (m == 0) return hay;
+    if (m > n) return nullptr;
+    if (m == 1) return (const char*)memchr(hay, needle[0], n);
+    return detail::find_substring_impl()(hay, n, needle, m);
+}
+
+/**
+ *  Find lines in logs written by logger: lines containing a literal,
+ *  lines of a level, lines in a time range, or all of them together.
+ *
+ *  Files are memory mapped. The time range is found by binary search over
+ *  the timestamps, which logger writes in order at the start of the lines,
+ *  so only the lines in the range are scanned. The literal is searched with
+ *  SSE2/AVX2 over the whole range, not line by line.
+ *
+ *  Usage:
+ *      log_search search;
+ *      search.level(logger<>::ERR).contains("timeout").since(t0);
+ *      search.search("service.log", [](const char* line, std::size_t len) {
+ *          fwrite(line, 1, len, stdout);
+ *      });
+ */
+class log_search
+{
+public:
+    using SizeType = std::size_t;
+    // Receives a matching line, with its '\n' if there is one.
+    typedef std::function<void(const char*, SizeType)> Callback;
+
+    log_search()
+        : _timeFormat("[%a %b %d %T %Y]")
+    {
+    }
+
+    // Lines containing literal.
+    log_search& contains(const std::string& literal)
+    {
+        _literal = literal;
+        return *this;
+    }
+    // Lines of a level, with the prefixes of the default logger.
+    log_search& level(logger<char>::PrefixType tp)
+    {
+        return level(logger<char>(filesystem::null_file<char>()), tp);
+    }
+    // Lines of a level, with the prefixes of log.
+    log_search& level(const logger<char>& log, logger<char>::PrefixType tp)
+    {
+        _prefix = log.getPrefix(tp);
+        _timeFormat = log.getTimeStampFormat();
+        return *this;
+    }
+    // Lines starting, after the timestamp, with prefix. Empty for any.
+    log_search& prefix(const std::string& prefix)
+    {
+        _prefix = prefix;
+        return *this;
+    }
+    // strptime format of the timestamps, logger's default by default.
+    log_search& timestamp_format(const std::string& format)
+    {
+        _timeFormat = format;
+        return *this;
+    }
+    // Lines with from <= timestamp (UTC, like logger writes them).
+    log_search& since(time_t from)
+    {
+        _from = from;
+        _bFrom = true;
+        return *this;
+    }
+    // Lines with timestamp < to.
+    log_search& until(time_t to)
+    {
+        _to = to;
+        _bTo = true;
+        return *this;
+    }
+
+    /**
+     *  Timestamp at the start of line, -1 if there is none.
+     */
+    time_t timestamp(const char* line, SizeType len) const
+    {
+        SizeType nTs = 0;
+        return _parse_time(line, len, nTs);
+    }
+
+    /**
+     *  Search [data, data+size).
+     *  @return number of matching lines.
+     */
+    SizeType search(const char* data, SizeType size, const Callback& fn) const
+    {
+        const char* begin = data;
+        const char* end = data + size;
+        if (_bFrom) begin = _lower_bound(data, size, _from);
+        if (_bTo) end = _lower_bound(data, size, _to);
+        if (begin >= end) return 0;
+        return _scan(begin, end - begin, fn);
+    }
+    SizeType search(const filesystem::mapped_file& mf, const Callback& fn) const
+    {
+        if (mf.empty()) return 0;
+        // Without a time range, the whole file is scanned.
+        if (!_bFrom && !_bTo)
+            mf.advise(filesystem::mapped_file::sequential_access);
+        return search(mf.data(), mf.size(), fn);
+    }
+    // @return number of matching lines, or -1 if the file can't be read.
+    long search(const std::string& filename, const Callback& fn) const
+    {
+        filesystem::mapped_file mf(filename);
+        if (!mf.is_open()) return -1;
+        return (long)search(mf, fn);
+    }
+
+    /**
+     *  Search a compressed_file, decompressed one block at a time. The
+     *  time range is checked line by line, there is no binary search.
+     */
+    SizeType search(filesystem::compressed_file& cf, const Callback& fn) const
+    {
+        std::string block, pending;
+        SizeType nMatches = 0;
+        for (SizeType b = 0; b < cf.blocks(); ++b)
+        {
+            if (!cf.read_block(b, block)) break;
+            // Lines crossing blocks are completed from the next one.
+            const char* lastNl = (const char*)memrchr(block.data(), '\n', block.size());
+            SizeType nComplete = lastNl ? lastNl - block.data() + 1 : 0;
+            if (!pending.empty())
+            {
+                const char* nl = (const char*)memchr(block.data(), '\n', block.size());
+                SizeType nHead = nl ? nl - block.data() + 1 : block.size();
+                pending.append(block, 0, nHead);
+                if (nl == nullptr) continue;
+                nMatches += _scan_checked(pending.data(), pending.size(), fn);
+                pending.clear();
+                if (nComplete > nHead)
+                    nMatches += _scan_checked(block.data() + nHead, nComplete - nHead, fn);
+            }
+            else
+                nMatches += _scan_checked(block.data(), nComplete, fn);
+            pending.append(block, nComplete, std::string::npos);
+        }
+        if (!pending.empty())
+            nMatches += _scan_checked(pending.data(), pending.size(), fn);
+        return nMatches;
+    }
+
+    /**
+     *  Like tail -f: search the file, then keep searching what is appended
+     *  to it, until stop becomes true. A line is only reported once its
+     *  '\n' is written. If the file shrinks (rotated by truncation), it is
+     *  read again from the start.
+     *  @return number of matching lines, or -1 if the file can't be read.
+     */
+    long follow(const std::string& filename, const Callback& fn,
+                const std::atomic<bool>& stop,
+                std::chrono::milliseconds interval = std::chrono::milliseconds(200)) const
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return -1;
+
+        // Read at most this much at a time, so following a large file
+        // doesn't load it whole.
+        const SizeType chunkSize = 1 << 16;
+
+        SizeType nMatches = 0;
+        off_t offset = 0; // end of what was read
+        std::vector<char> buffer;
+        SizeType nCarry = 0; // the incomplete line at the start of buffer
+        while (!stop)
+        {
+            struct stat st;
+            if (fstat(fd, &st) != 0) break;
+            if (st.st_size < offset) // truncated
+            {
+                offset = 0;
+                nCarry = 0;
+            }
+            if (st.st_size == offset)
+            {
+                std::this_thread::sleep_for(interval);
+                continue;
+            }
+
+            SizeType nWant = std::min<SizeType>(chunkSize, (SizeType)(st.st_size - offset));
+            buffer.resize(nCarry + nWant);
+            ssize_t nRead = pread(fd, buffer.data() + nCarry, nWant, offset);
+            if (nRead <= 0)
+            {
+                std::this_thread::sleep_for(interval);
+                continue;
+            }
+            offset += (off_t)nRead;
+
+            const SizeType nData = nCarry + (SizeType)nRead;
+            const char* lastNl = (const char*)memrchr(buffer.data() + nCarry, '\n', (SizeType)nRead);
+            if (lastNl == nullptr)
+            {
+                nCarry = nData; // a line longer than the chunk, or not finished
+                continue;
+            }
+            SizeType nComplete = lastNl - buffer.data() + 1;
+            nMatches += _scan_checked(buffer.data(), nComplete, fn);
+            nCarry = nData - nComplete;
+            memmove(buffer.data(), buffer.data() + nComplete, nCarry);
+        }
+        ::close(fd);
+        return (long)nMatches;
+    }
+
+private:
+    std::string _literal;
+    std::string _prefix;
+    std::string _timeFormat;
+    time_t _from = 0, _to = 0;
+    bool _bFrom = false, _bTo = false;
+
+    static const char* _line_begin(const char* data, const char* p)
+    {
+        if (p == data) return p;
+        const char* nl = (const char*)memrchr(data, '\n', p - data);
+        return nl ? nl + 1 : data;
+    }
+    static const char* _line_end(const char* p, const char* end)
+    {
+        const char* nl = (const char*)memchr(p, '\n', end - p);
+        return nl ? nl + 1 : end;
+    }
+
+    // -1 if the line doesn't start with a timestamp. nTs gets its length.
+    time_t _parse_time(const char* line, SizeType len, SizeType& nTs) const
+    {
+        // strptime needs a terminated string, timestamps are short.
+        char buf[128];
+        SizeType n = len < sizeof(buf) - 1 ? len : sizeof(buf) - 1;
+        memcpy(buf, line, n);
+        buf[n] = '\0';
+
+        tm t;
+        memset(&t, 0, sizeof(t));
+        const char* rest = strptime(buf, _timeFormat.c_str(), &t);
+        if (rest == nullptr) return -1;
+        nTs = rest - buf;
+        return timegm(&t);
+    }
+
+    // First line whose timestamp is >= t, lines without one are skipped.
+    const char* _lower_bound(const char* data, SizeType size, time_t t) const
+    {
+        const char* const end = data + size;
+        const char* lo = data;
+        const char* hi = end;
+        while (lo < hi)
+        {
+            const char* mid = lo + (hi - lo) / 2;
+            const char* line = (mid == data || mid[-1] == '\n') ? mid : _line_end(mid, end);
+            time_t ts = -1;
+            SizeType nTs = 0;
+            while (line < end &&
+                   (ts = _parse_time(line, _line_end(line, end) - line, nTs)) == -1)
+                line = _line_end(line, end);
+
+            if (line < end && ts < t)
+                lo = _line_end(line, end);
+            else
+                hi = mid;
+        }
+        return (lo == data || lo[-1] == '\n') ? lo : _line_end(lo, end);
+    }
+
+    bool _match_prefix(const char* line, SizeType len) const
+    {
+        if (_prefix.empty()) return true;
+        SizeType nTs = 0;
+        if (_parse_time(line, len, nTs) == -1) nTs = 0;
+        return len - nTs >= _prefix.size() && memcmp(line + nTs, _prefix.data(), _prefix.size()) == 0;
+    }
+
+    // Whole lines in [data, data+size), the time range is already applied.
+    SizeType _scan(const char* data, SizeType size, const Callback& fn) const
+    {
+        const char* const end = data + size;
+        // The literal is the better needle, the prefix is checked after.
+        const std::string& needle = _literal.empty() ? _prefix : _literal;
+        SizeType nMatches = 0;
+
+        if (needle.empty())
+        {
+            for (const char* line = data; line < end; )
+            {
+                const char* next = _line_end(line, end);
+                fn(line, next - line);
+                ++nMatches;
+                line = next;
+            }
+            return nMatches;
+        }
+
+        for (const char* p = data; p < end; )
+        {
+            const char* hit = find_substring(p, end - p, needle.data(), needle.size());
+            if (hit == nullptr) break;
+            const char* line = _line_begin(data, hit);
+            const char* next = _line_end(hit, end);
+            // A match of the literal may span a '\n'.
+            if (memchr(hit, '\n', needle.size()) != nullptr)
+            {
+                p = hit + 1;
+                continue;
+            }
+            if (_match_prefix(line, next - line))
+            {
+                fn(line, next - line);
+                ++nMatches;
+            }
+            p = next;
+        }
+        return nMatches;
+    }
+
+    // Like _scan, but with the time range checked on every line.
+    SizeType _scan_checked(const char* data, SizeType size, const Callback& fn) const
+    {
+        if (!_bFrom && !_bTo) return _scan(data, size, fn);
+        SizeType nMatches = 0;
+        _scan(data, size, [&](const char* line, SizeType len) {
+            SizeType nTs = 0;
+            time_t ts = _parse_time(line, len, nTs);
+            if (ts == -1) return;
+            if ((_bFrom && ts < _from) || (_bTo && ts >= _to)) return;
+            fn(line, len);
+            ++nMatches;
+        });
+        return nMatches;
+    }
+
+};
+
+}
@@ -2,7 +2,7 @@
  * donnylib - A lightweight library for c++
  * 
  * logger.hpp - A easy logger for c++
- * dependency : base.hpp, file.hpp, file_stream.hpp, datetime.hpp
+ * dependency : base.hpp, file.hpp, file_stream.hpp, datetime.hpp, log_record.hpp
  * 
  * Author : Donny
  */
@@ -18,6 +18,7 @@
 #include "file.hpp"
 #include "file_stream.hpp"
 #include "datetime.hpp"
+#include "log_record.hpp"
 
 namespace donny {
 
@@ -41,7 +42,78 @@ public:
         PREFIX_COUNT
     };
 
-    logger(logger_file out_ = filesystem::dout)
+    /**
+     *  How records are written. TEXT is the printf style line. JSON and
+     *  LOGFMT write one object or one key=value line per record, with the
+     *  timestamp, the level (the prefix without brackets) and the message
+     *  as the ts, level and msg fields, followed by the kv fields.
+     */
+    enum RecordFormat {
+        TEXT = 0,
+        JSON,
+        LOGFMT
+    };
+
+    /**
+     *  What i(), e(), d(), v() and log() return. When the level is disabled
+     *  it refers to no stream and every << is a test of a null pointer,
+     *  the arguments are neither formatted nor written.
+     */
+    class level_stream {
+
+    public:
+        level_stream()
+            : _stream(nullptr)
+        {
+        }
+        explicit level_stream(logger_stream& stream)
+            : _stream(&stream)
+        {
+        }
+
+        inline bool enabled() const
+        {
+            return _stream != nullptr;
+        }
+
+        /**
+         *  The stream itself, for callers keeping it:
+         *      logger_stream& s = log.i();
+         *  A disabled level gives the shared null stream, which formats
+         *  and discards.
+         */
+        inline operator logger_stream&() const
+        {
+            return _stream ? *_stream : _null_stream();
+        }
+
+        template<typename AnyType>
+        inline level_stream& operator<<(const AnyType& any)
+        {
+            if (_stream) *_stream << any;
+            return *this;
+        }
+
+        inline level_stream& operator<<
+            (logger_stream& (*_pf)(logger_stream&))
+        {
+            if (_stream) *_stream << _pf;
+            return *this;
+        }
+
+    private:
+        logger_stream* _stream;
+
+        // Shared by every logger, created on first use.
+        static logger_stream& _null_stream()
+        {
+            static logger_stream* s = new logger_stream(filesystem::null_file<CharType>());
+            return *s;
+        }
+
+    };
+
+    logger(logger_file out_ = filesystem::std_out())
         : _out(out_)
         , _stream(_out)
         , _bUseTimeStamp(true)
@@ -60,7 +132,7 @@ public:
     inline void close()
     {
         _out.close();
-        _out = logger_file("/dev/null", "wb");
+        _out = filesystem::null_file<CharType>();
         _stream = logger_stream(_out);
     }
 
@@ -162,17 +234,30 @@ public:
         _dtFormat = newFormat;
         return oldFormat;
     }
-    inline StringType getTimeStampFormat()
+    inline StringType getTimeStampFormat() const
     {
         return _dtFormat;
     }
 
+    inline RecordFormat setRecordFormat(RecordFormat newFormat)
+    {
+        RecordFormat oldFormat = _recordFormat;
+        _recordFormat = newFormat;
+        return oldFormat;
+    }
+    inline RecordFormat getRecordFormat() const
+    {
+        return _recordFormat;
+    }
+
     inline int i(const StringType format_, ...)
     {
         if (!_bEnableLevel[INFO]) return 0;
 
         va_list args;
         va_start(args, format_);
+        if (_recordFormat != TEXT)
+            return TRAP_RET( _vlogRecord(INFO, format_, args), va_end(args) );
         return TRAP_RET( _logTimeStamp()
                        + print(_prefixs[INFO])
                        + vprintln(format_, args)
@@ -184,6 +269,8 @@ public:
 
         va_list args;
         va_start(args, format_);
+        if (_recordFormat != TEXT)
+            return TRAP_RET( _vlogRecord(ERR, format_, args), va_end(args) );
         return TRAP_RET( _logTimeStamp()
                        + print(_prefixs[ERR])
                        + vprintln(format_, args)
@@ -195,6 +282,8 @@ public:
 
         va_list args;
         va_start(args, format_);
+        if (_recordFormat != TEXT)
+            return TRAP_RET( _vlogRecord(DEB, format_, args), va_end(args) );
         return TRAP_RET( _logTimeStamp()
                        + print(_prefixs[DEB])
                        + vprintln(format_, args)
@@ -206,6 +295,8 @@ public:
 
         va_list args;
         va_start(args, format_);
+        if (_recordFormat != TEXT)
+            return TRAP_RET( _vlogRecord(VERB, format_, args), va_end(args) );
         return TRAP_RET( _logTimeStamp()
                        + print(_prefixs[VERB])
                        + vprintln(format_, args)
@@ -217,51 +308,89 @@ public:
 
         va_list args;
         va_start(args, format_);
+        if (_recordFormat != TEXT)
+            return TRAP_RET( _vlogRecord(LOG, format_, args), va_end(args) );
         return TRAP_RET( _logTimeStamp()
                        + print(_prefixs[LOG])
                        + vprintln(format_, args)
                        , va_end(args) );
     }
 
-    inline logger_stream& i()
+    /**
+     *  Structured records: log.i("msg", kv("user", id), kv("latency_us", t)).
+     *  The record is encoded into a buffer kept by the logger and written
+     *  at once. In TEXT format, the fields follow the message as logfmt.
+     */
+    template<typename... T>
+    inline int i(const StringType msg, const kv_field<T>&... fields)
     {
-        if (!_bEnableLevel[INFO]) return _null_stream;
+        if (!_bEnableLevel[INFO]) return 0;
+        return _logRecord(INFO, msg, fields...);
+    }
+    template<typename... T>
+    inline int e(const StringType msg, const kv_field<T>&... fields)
+    {
+        if (!_bEnableLevel[ERR]) return 0;
+        return _logRecord(ERR, msg, fields...);
+    }
+    template<typename... T>
+    inline int d(const StringType msg, const kv_field<T>&... fields)
+    {
+        if (!_bEnableLevel[DEB]) return 0;
+        return _logRecord(DEB, msg, fields...);
+    }
+    template<typename... T>
+    inline int v(const StringType msg, const kv_field<T>&... fields)
+    {
+        if (!_bEnableLevel[VERB]) return 0;
+        return _logRecord(VERB, msg, fields...);
+    }
+    template<typename... T>
+    inline int log(const StringType msg, const kv_field<T>&... fields)
+    {
+        if (!_bEnableLevel[LOG]) return 0;
+        return _logRecord(LOG, msg, fields...);
+    }
+
+    inline level_stream i()
+    {
+        if (!_bEnableLevel[INFO]) return level_stream();
 
         _logTimeStamp();
         print(_prefixs[INFO]);
-        return _stream;
+        return level_stream(_stream);
     }
-    inline logger_stream& e()
+    inline level_stream e()
     {
-        if (!_bEnableLevel[ERR]) return _null_stream;
+        if (!_bEnableLevel[ERR]) return level_stream();
 
         _logTimeStamp();
         print(_prefixs[ERR]);
-        return _stream;
+        return level_stream(_stream);
     }
-    inline logger_stream& d()
+    inline level_stream d()
     {
-        if (!_bEnableLevel[DEB]) return _null_stream;
+        if (!_bEnableLevel[DEB]) return level_stream();
 
         _logTimeStamp();
         print(_prefixs[DEB]);
-        return _stream;
+        return level_stream(_stream);
     }
-    inline logger_stream& v()
+    inline level_stream v()
     {
-        if (!_bEnableLevel[VERB]) return _null_stream;
+        if (!_bEnableLevel[VERB]) return level_stream();
 
         _logTimeStamp();
         print(_prefixs[VERB]);
-        return _stream;
+        return level_stream(_stream);
     }
-    inline logger_stream& log()
+    inline level_stream log()
     {
-        if (!_bEnableLevel[LOG]) return _null_stream;
+        if (!_bEnableLevel[LOG]) return level_stream();
 
         _logTimeStamp();
         print(_prefixs[LOG]);
-        return _stream;
+        return level_stream(_stream);
     }
 
     template<typename AnyType>
@@ -280,8 +409,6 @@ public:
     }
 
 private:
-    static logger_stream _null_stream;
-
     logger_file _out;
     logger_stream _stream;
 
@@ -291,6 +418,14 @@ private:
     StringType _dtFormat;
     bool _bUseTimeStamp;
 
+    RecordFormat _recordFormat = TEXT;
+    std::string _record; // reused, keeps its capacity
+    StringType _message;
+    std::string _scratch; // UTF-8 form of wide strings
+    char _ts[32];
+    std::size_t _tsLength = 0;
+    time_t _tsTime = 0;
+
     StringType _getUTCTime()
     {
         time_t now = time(nullptr);
@@ -304,13 +439,182 @@ private:
         return putTimeStamp();
     }
 
+    // Key of the next field and the separator before it.
+    void _appendKey(const char* key)
+    {
+        if (_recordFormat == JSON)
+        {
+            if (_record.size() > 1) _record += ',';
+            _record += '"';
+            detail::append_escaped(_record, key, strlen(key));
+            _record += "\":";
+        }
+        else
+        {
+            if (!_record.empty()) _record += ' ';
+            _record += key;
+            _record += '=';
+        }
+    }
+
+    void _beginRecord(PrefixType tp, const StringType& msg)
+    {
+        _record.clear();
+        if (_recordFormat == TEXT)
+        {
+            if (_bUseTimeStamp) _record += detail::as_utf8(_getUTCTime(), _scratch);
+            _record += detail::as_utf8(_prefixs[tp], _scratch);
+            _record += detail::as_utf8(msg, _scratch);
+            return;
+        }
+
+        bool bJson = (_recordFormat == JSON);
+        if (bJson) _record += '{';
+        if (_bUseTimeStamp)
+        {
+            // formatted once per second
+            time_t now = time(nullptr);
+            if (now != _tsTime || _tsLength == 0)
+            {
+                tm gmtm;
+                _tsTime = now;
+                _tsLength = strftime(_ts, sizeof(_ts), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&now, &gmtm));
+            }
+            _appendKey("ts");
+            detail::append_string(_record, bJson, _ts, _tsLength);
+        }
+
+        // "[INFO] " -> INFO
+        const std::string& prefix = detail::as_utf8(_prefixs[tp], _scratch);
+        std::size_t b = prefix.find_first_not_of("[] ");
+        std::size_t e = prefix.find_last_not_of("[] ");
+        _appendKey("level");
+        if (b == std::string::npos)
+            detail::append_string(_record, bJson, "", 0);
+        else
+            detail::append_string(_record, bJson, prefix.data() + b, e + 1 - b);
+
+        const std::string& text = detail::as_utf8(msg, _scratch);
+        _appendKey("msg");
+        detail::append_string(_record, bJson, text.data(), text.size());
+    }
+
+    void _appendFields()
+    {
+    }
+    template<typename T, typename... Rest>
+    void _appendFields(const kv_field<T>& field, const kv_field<Rest>&... rest)
+    {
+        if (_recordFormat == TEXT)
+        {
+            _record += ' ';
+            _record += field.key;
+            _record += '=';
+        }
+        else
+        {
+            _appendKey(field.key);
+        }
+        detail::append_value(_record, _recordFormat == JSON, field.value);
+        _appendFields(rest...);
+    }
+
+    int _endRecord()
+    {
+        if (_recordFormat == JSON) _record += '}';
+        _record += '\n';
+        return _writeRecord(_out, _record);
+    }
+
+    static int _writeRecord(filesystem::basic_file<char>& out, const std::string& record)
+    {
+        return (int)out.write(record.data(), 1, record.size());
+    }
+    static int _writeRecord(filesystem::basic_file<wchar_t>& out, const std::string& record)
+    {
+        return (int)out.puts(unicode::utf8_to_wstring(record));
+    }
+
+    template<typename... T>
+    int _logRecord(PrefixType tp, const StringType& msg, const kv_field<T>&... fields)
+    {
+        _beginRecord(tp, msg);
+        _appendFields(fields...);
+        return _endRecord();
+    }
+
+    int _vlogRecord(PrefixType tp, const StringType& format_, va_list args)
+    {
+        detail::vformat_to(_message, format_.c_str(), args);
+        _beginRecord(tp, _message);
+        return _endRecord();
+    }
+
+};
+// Shared loggers, created on first use like the files they write to.
+inline logger<char>& log_stdout()
+{
+    static logger<char>* log = new logger<char>(filesystem::std_out());
+    return *log;
+}
+inline logger<char>& log_stderr()
+{
+    static logger<char>* log = new logger<char>(filesystem::std_err());
+    return *log;
+}
+inline logger<char>& log_stdnull()
+{
+    static logger<char>* log = new logger<char>(filesystem::null_file<char>());
+    return *log;
+}
+
+namespace detail {
+
+// The name of the logger Get() returns, like lazy_file for the files.
+template<typename Logger, Logger& (*Get)()>
+struct lazy_logger
+{
+    using logger_stream = typename Logger::logger_stream;
+
+    operator Logger&() const { return Get(); }
+    Logger* operator->() const { return &Get(); }
+
+    template<typename AnyType>
+    logger_stream& operator<<(const AnyType& any) const
+    {
+        return Get() << any;
+    }
+    logger_stream& operator<<(logger_stream& (*_pf)(logger_stream&)) const
+    {
+        return Get() << _pf;
+    }
+
+    LAZY_FORWARD(close)
+    LAZY_FORWARD(vprint)
+    LAZY_FORWARD(vprintln)
+    LAZY_FORWARD(print)
+    LAZY_FORWARD(println)
+    LAZY_FORWARD(putc)
+    LAZY_FORWARD(puts)
+    LAZY_FORWARD(write)
+    LAZY_FORWARD(flush)
+    LAZY_FORWARD(enableLogLevel)
+    LAZY_FORWARD(setPrefix)
+    LAZY_FORWARD(useTimeStamp)
+    LAZY_FORWARD(putTimeStamp)
+    LAZY_FORWARD(setTimeStampFormat)
+    LAZY_FORWARD(setRecordFormat)
+    LAZY_FORWARD(i)
+    LAZY_FORWARD(e)
+    LAZY_FORWARD(d)
+    LAZY_FORWARD(v)
+    LAZY_FORWARD(log)
 };
-template<typename CharType>
-typename logger<CharType>::logger_stream logger<CharType>::_null_stream =
-    typename logger<CharType>::logger_stream(typename logger<CharType>::logger_file("/dev/null", "wb"));
 
-static logger<char> logstdout(filesystem::dout);
-static logger<char> logstderr(filesystem::derr);
-static logger<char> logstdnull(filesystem::dnull);
+}
+
+constexpr detail::lazy_logger<logger<char>, log_stdout> logstdout = {};
+constexpr detail::lazy_logger<logger<char>, log_stderr> logstderr = {};
+constexpr detail::lazy_logger<logger<char>, log_stdnull> logstdnull = {};
 
 }
@@ -0,0 +1,189 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * lz_block.hpp - a small LZ77 block codec in the spirit of LZ4
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace donny {
+
+/**
+ *  A compressed block is a list of sequences:
+ *
+ *      token       u8      literal count (high 4 bits), match length - 4 (low 4 bits)
+ *      [length]    u8...   extra literal count when the nibble is 15, 255 means more
+ *      literals
+ *      offset      u16     little endian distance of the match, 1..65535
+ *      [length]    u8...   extra match length when the nibble is 15
+ *
+ *  The last sequence has literals only and no offset.
+ */
+namespace detail {
+
+const int LZMinMatch = 4;
+const int LZHashBits = 14;
+
+inline uint32_t lz_read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZHashBits);
+}
+
+inline void lz_put_length(std::string& out, std::size_t n)
+{
+    for (; n >= 255; n -= 255)
+        out += (char)255;
+    out += (char)n;
+}
+
+inline void lz_put_sequence(std::string& out,
+    const unsigned char* literals, std::size_t nLiterals,
+    std::size_t offset, std::size_t matchLength)
+{
+    std::size_t m = matchLength ? matchLength - LZMinMatch : 0;
+    unsigned char token = (unsigned char)(((nLiterals < 15 ? nLiterals : 15) << 4)
+                                        | (m < 15 ? m : 15));
+    out += (char)token;
+    if (nLiterals >= 15) lz_put_length(out, nLiterals - 15);
+    out.append((const char*)literals, nLiterals);
+    if (matchLength == 0) return;
+    out += (char)(offset & 0xFF);
+    out += (char)(offset >> 8);
+    if (m >= 15) lz_put_length(out, m - 15);
+}
+
+}
+
+/**
+ *  Compress [src, src+size) and append the block to out.
+ *  @return compressed size.
+ */
+inline std::size_t lz_compress(const void* src, std::size_t size, std::string& out)
+{
+    using namespace detail;
+
+    const unsigned char* const base = (const unsigned char*)src;
+    const unsigned char* const end = base + size;
+    const std::size_t start = out.size();
+    out.reserve(start + size + size / 255 + 16);
+
+    std::vector<uint32_t> table(1 << LZHashBits, 0);
+    const unsigned char* anchor = base;
+    const unsigned char* ip = base;
+    // Keep the tail out of matches, it is written as literals.
+    const unsigned char* const limit = (size > 12) ? end - 5 : base;
+
+    unsigned nMisses = 0;
+    while (ip + LZMinMatch <= limit)
+    {
+        uint32_t v = lz_read32(ip);
+        uint32_t h = lz_hash(v);
+        const unsigned char* ref = base + table[h];
+        table[h] = (uint32_t)(ip - base);
+
+        if (ref >= ip || ip - ref > 0xFFFF || lz_read32(ref) != v)
+        {
+            // Step faster through data that doesn't compress.
+            ip += 1 + (nMisses++ >> 6);
+            continue;
+        }
+        nMisses = 0;
+
+        // Extend backwards over pending literals, then forwards.
+        while (ip > anchor && ref > base && ip[-1] == ref[-1])
+        {
+            --ip;
+            --ref;
+        }
+        const unsigned char* mp = ip + LZMinMatch;
+        const unsigned char* mr = ref + LZMinMatch;
+        while (mp < limit && *mp == *mr)
+        {
+            ++mp;
+            ++mr;
+        }
+
+        lz_put_sequence(out, anchor, ip - anchor, ip - ref, mp - ip);
+        ip = anchor = mp;
+        if (ip - 2 > base && ip + 2 <= limit)
+            table[lz_hash(lz_read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+    }
+    lz_put_sequence(out, anchor, end - anchor, 0, 0);
+
+    return out.size() - start;
+}
+
+/**
+ *  Decompress a block produced by lz_compress into dst.
+ *  @param rawSize : the exact uncompressed size.
+ *  @return false if the block is malformed.
+ */
+inline bool lz_decompress(const void* src, std::size_t size, void* dst, std::size_t rawSize)
+{
+    const unsigned char* ip = (const unsigned char*)src;
+    const unsigned char* const iend = ip + size;
+    unsigned char* op = (unsigned char*)dst;
+    unsigned char* const obase = op;
+    unsigned char* const oend = op + rawSize;
+
+    auto readLength = [&](std::size_t& n) {
+        unsigned char c;
+        do
+        {
+            if (ip >= iend) return false;
+            c = *ip++;
+            n += c;
+        } while (c == 255);
+        return true;
+    };
+
+    while (ip < iend)
+    {
+        unsigned token = *ip++;
+
+        std::size_t nLiterals = token >> 4;
+        if (nLiterals == 15 && !readLength(nLiterals)) return false;
+        if ((std::size_t)(iend - ip) < nLiterals || (std::size_t)(oend - op) < nLiterals)
+            return false;
+        memcpy(op, ip, nLiterals);
+        ip += nLiterals;
+        op += nLiterals;
+
+        if (ip == iend) break; // last sequence
+
+        if (iend - ip < 2) return false;
+        std::size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        std::size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(matchLength)) return false;
+        matchLength += detail::LZMinMatch;
+
+        if (offset == 0 || offset > (std::size_t)(op - obase)) return false;
+        if ((std::size_t)(oend - op) < matchLength) return false;
+
+        const unsigned char* ref = op - offset;
+        if (offset >= matchLength)
+            memcpy(op, ref, matchLength);
+        else
+            for (std::size_t ind = 0; ind < matchLength; ++ind) op[ind] = ref[ind];
+        op += matchLength;
+    }
+
+    return op == oend;
+}
+
+}
@@ -0,0 +1,148 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * mapped_file.hpp - read-only memory mapped file
+ * dependency : base.hpp, file.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file.hpp"
+
+namespace donny {
+namespace filesystem {
+
+class mapped_file
+{
+public:
+    using SizeType = std::size_t;
+    typedef const char* const_iterator;
+
+    mapped_file()
+    {
+    }
+    explicit mapped_file(const std::string& filename) : mapped_file()
+    {
+        open(filename);
+    }
+    explicit mapped_file(basic_file<char>& f) : mapped_file()
+    {
+        open(f);
+    }
+    ~mapped_file()
+    {
+        close();
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    mapped_file(mapped_file&& that) : mapped_file()
+    {
+        *this = std::move(that);
+    }
+    mapped_file& operator=(mapped_file&& that)
+    {
+        if (this == &that) return *this;
+        close();
+        std::swap(_data, that._data);
+        std::swap(_size, that._size);
+        std::swap(_bOpen, that._bOpen);
+        return *this;
+    }
+
+    bool open(const std::string& filename)
+    {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        bool bSucceed = _map(fd);
+        ::close(fd);
+        return bSucceed;
+    }
+    // Map the whole file underlying f. f can be closed afterwards.
+    bool open(basic_file<char>& f)
+    {
+        close();
+        if (!f.is_open()) return false;
+        f.flush();
+        return _map(fileno(f.getFILE()));
+    }
+    bool close()
+    {
+        bool bSucceed = true;
+        if (_data != nullptr)
+            bSucceed = (::munmap((void*)_data, _size) == 0);
+        _data = nullptr;
+        _size = 0;
+        _bOpen = false;
+        return bSucceed;
+    }
+
+    bool is_open() const { return _bOpen; }
+    bool empty() const { return _size == 0; }
+
+    // data() is nullptr for an empty file.
+    const char* data() const { return _data; }
+    SizeType size() const { return _size; }
+    const_iterator begin() const { return _data; }
+    const_iterator end() const { return _data + _size; }
+
+    enum AccessAdvice { normal_access, sequential_access, random_access, will_need, dont_need };
+
+    /**
+     *  madvise over [offset, offset+len), len = 0 means up to the end.
+     *  offset is rounded down to a page. dont_need drops the pages, they
+     *  are read again from the file on the next access.
+     */
+    bool advise(AccessAdvice advice, SizeType offset = 0, SizeType len = 0) const
+    {
+        static const int flags[] = { MADV_NORMAL, MADV_SEQUENTIAL,
+            MADV_RANDOM, MADV_WILLNEED, MADV_DONTNEED };
+        if (_data == nullptr || offset >= _size) return false;
+        if (len == 0 || len > _size - offset) len = _size - offset;
+        SizeType page = (SizeType)sysconf(_SC_PAGESIZE);
+        SizeType first = offset / page * page;
+        return ::madvise((void*)(_data + first), offset + len - first, flags[advice]) == 0;
+    }
+
+private:
+    const char* _data = nullptr;
+    SizeType _size = 0;
+    bool _bOpen = false;
+
+    bool _map(int fd)
+    {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) return false;
+
+        _size = (SizeType)st.st_size;
+        if (_size != 0)
+        {
+            void* p = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                _size = 0;
+                return false;
+            }
+            _data = (const char*)p;
+        }
+        _bOpen = true;
+        return true;
+    }
+
+};
+
+}
+}
@@ -0,0 +1,114 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * mod_int.hpp - integers modulo a prime, for exact polynomial arithmetic.
+ * dependency: none
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+namespace donny {
+namespace math {
+
+
+/**
+ *  An integer modulo Mod, Mod a prime below 2^31. With an NTT friendly
+ *  prime (Mod - 1 divisible by a large power of two, like 998244353),
+ *  basic_polynomial<mod_int<Mod>> is multiplied with the number theoretic
+ *  transform, exactly.
+ */
+template<std::uint32_t Mod>
+class mod_int
+{
+public:
+    static constexpr std::uint32_t modulus = Mod;
+
+    mod_int() : _v(0) {}
+    mod_int(long long v)
+        : _v((std::uint32_t)(((v % (long long)Mod) + Mod) % Mod))
+    {
+    }
+
+    std::uint32_t value() const { return _v; }
+
+    mod_int& operator+=(const mod_int& o)
+    {
+        _v += o._v;
+        if (_v >= Mod) _v -= Mod;
+        return *this;
+    }
+    mod_int& operator-=(const mod_int& o)
+    {
+        _v = (_v >= o._v) ? _v - o._v : _v + Mod - o._v;
+        return *this;
+    }
+    mod_int& operator*=(const mod_int& o)
+    {
+        _v = (std::uint32_t)((std::uint64_t)_v * o._v % Mod);
+        return *this;
+    }
+    mod_int& operator/=(const mod_int& o)
+    {
+        return *this *= o.inverse();
+    }
+    mod_int operator-() const
+    {
+        return from_value(_v ? Mod - _v : 0);
+    }
+
+    mod_int pow(std::uint64_t e) const
+    {
+        mod_int r(1), b = *this;
+        for (; e; e >>= 1, b *= b)
+            if (e & 1) r *= b;
+        return r;
+    }
+    // Fermat: a^(Mod-2) is 1/a, for a != 0.
+    mod_int inverse() const
+    {
+        return pow(Mod - 2);
+    }
+
+    // Construct from a value already in [0, Mod).
+    static mod_int from_value(std::uint32_t v)
+    {
+        mod_int r;
+        r._v = v;
+        return r;
+    }
+
+    friend mod_int operator+(mod_int a, const mod_int& b) { return a += b; }
+    friend mod_int operator-(mod_int a, const mod_int& b) { return a -= b; }
+    friend mod_int operator*(mod_int a, const mod_int& b) { return a *= b; }
+    friend mod_int operator/(mod_int a, const mod_int& b) { return a /= b; }
+
+    friend bool operator==(const mod_int& a, const mod_int& b) { return a._v == b._v; }
+    friend bool operator!=(const mod_int& a, const mod_int& b) { return a._v != b._v; }
+    // Ordered by representative, so that str() prints the signs of
+    // basic_polynomial consistently.
+    friend bool operator<(const mod_int& a, const mod_int& b) { return a._v < b._v; }
+    friend bool operator>(const mod_int& a, const mod_int& b) { return a._v > b._v; }
+
+    friend std::ostream& operator<<(std::ostream& os, const mod_int& a)
+    {
+        return os << a._v;
+    }
+
+private:
+    std::uint32_t _v;
+
+};
+
+template<std::uint32_t Mod>
+constexpr std::uint32_t mod_int<Mod>::modulus;
+
+typedef mod_int<998244353> mod998244353;
+
+
+} // math
+} // donny
@@ -0,0 +1,197 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * multipoint.hpp - evaluation at many points and interpolation through
+ *                  subproduct trees, in O(M(n) log n).
+ * dependency: polynomial, poly_divide
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+
+#include "polynomial.hpp"
+#include "poly_divide.hpp"
+
+namespace donny {
+namespace math {
+namespace detail {
+
+
+/*
+ *  Level 0 holds x - x_i for every point, each level above holds the
+ *  products of pairs of the level below (an odd one out is carried up),
+ *  the last level holds the product of all x - x_i.
+ *  Node i of level k covers the points [i 2^k, (i+1) 2^k).
+ */
+template<typename T>
+class subproduct_tree
+{
+public:
+    // Below this many points, remainders are evaluated with Horner.
+    static const std::size_t leaf_points = 32;
+
+    explicit subproduct_tree(const std::vector<T>& xs)
+        : _xs(xs)
+    {
+        std::vector<std::vector<T>> level(xs.size());
+        for (std::size_t ind = 0; ind < xs.size(); ++ind)
+            level[ind] = { -xs[ind], T(1) };
+        _levels.push_back(std::move(level));
+        while (_levels.back().size() > 1)
+        {
+            const std::vector<std::vector<T>>& below = _levels.back();
+            std::vector<std::vector<T>> above((below.size() + 1) / 2);
+            for (std::size_t ind = 0; ind + 1 < below.size(); ind += 2)
+                multiply(below[ind], below[ind + 1], above[ind / 2]);
+            if (below.size() % 2)
+                above.back() = below.back();
+            _levels.push_back(std::move(above));
+        }
+    }
+
+    const std::vector<T>& root() const { return _levels.back()[0]; }
+
+    // out[i] = p(x_i), p of any degree.
+    void eval(const std::vector<T>& p, std::vector<T>& out) const
+    {
+        out.resize(_xs.size());
+        if (_xs.empty()) return;
+        _eval(p, _levels.size() - 1, 0, out);
+    }
+
+    /*
+     *  sum of c_i prod_{j != i} (x - x_j), combined bottom up:
+     *  a node is left * M_right + right * M_left.
+     */
+    std::vector<T> combine(const std::vector<T>& c) const
+    {
+        std::vector<std::vector<T>> values(c.size());
+        for (std::size_t ind = 0; ind < c.size(); ++ind)
+            values[ind].assign(1, c[ind]);
+        std::vector<T> t1, t2;
+        for (std::size_t k = 0; k + 1 < _levels.size(); ++k)
+        {
+            const std::vector<std::vector<T>>& level = _levels[k];
+            std::vector<std::vector<T>> above((values.size() + 1) / 2);
+            for (std::size_t ind = 0; ind + 1 < values.size(); ind += 2)
+            {
+                multiply(values[ind], level[ind + 1], t1);
+                multiply(values[ind + 1], level[ind], t2);
+                if (t1.size() < t2.size()) t1.swap(t2);
+                for (std::size_t j = 0; j < t2.size(); ++j)
+                    t1[j] += t2[j];
+                above[ind / 2].swap(t1);
+            }
+            if (values.size() % 2)
+                above.back().swap(values.back());
+            values.swap(above);
+        }
+        return values.empty() ? std::vector<T>() : values[0];
+    }
+
+private:
+    std::vector<T> _xs;
+    std::vector<std::vector<std::vector<T>>> _levels;
+
+    void _eval(const std::vector<T>& p, std::size_t k, std::size_t ind, std::vector<T>& out) const
+    {
+        const std::size_t first = ind << k;
+        const std::size_t last = std::min(first + ((std::size_t)1 << k), _xs.size());
+        std::vector<T> q, r;
+        const std::vector<T>* rem = &p;
+        if (p.size() >= _levels[k][ind].size())
+        {
+            divmod(p, _levels[k][ind], q, r);
+            rem = &r;
+        }
+        if (last - first <= leaf_points || k == 0)
+        {
+            for (std::size_t i = first; i < last; ++i)
+                out[i] = rem->empty() ? T(0) : horner(rem->data(), rem->size(), _xs[i]);
+            return;
+        }
+        _eval(*rem, k - 1, 2 * ind, out);
+        if (2 * ind + 1 < _levels[k - 1].size())
+            _eval(*rem, k - 1, 2 * ind + 1, out);
+    }
+
+};
+
+template<typename T>
+const std::size_t subproduct_tree<T>::leaf_points;
+
+
+} // detail
+
+/**
+ *  p(x_i) for every point, in O(M(n) log n) for n points of a degree n
+ *  polynomial, against O(n^2) with eval.
+ *
+ *  ValueType must be a field. With mod_int the result is exact. With
+ *  double the remainders lose precision as n grows, much faster than
+ *  eval does; check against eval on a sample.
+ */
+template<typename ValueType>
+std::vector<ValueType> multipoint_eval(const basic_polynomial<ValueType>& p,
+                                       const std::vector<ValueType>& xs)
+{
+    const typename basic_polynomial<ValueType>::coefficient_storage& c = p.coefficient_vector();
+    std::vector<ValueType> out;
+    detail::subproduct_tree<ValueType>(xs).eval(std::vector<ValueType>(c.begin(), c.end()), out);
+    return out;
+}
+
+template<typename ValueType, typename Node>
+std::vector<ValueType> multipoint_eval(const poly_expr<ValueType, Node>& p,
+                                       const std::vector<ValueType>& xs)
+{
+    return multipoint_eval(basic_polynomial<ValueType>(p), xs);
+}
+
+/**
+ *  The polynomial of degree < n through the n points (xs[i], ys[i]), in
+ *  O(M(n) log n): with M the product of all x - x_i, it is
+ *  sum ys[i] / M'(x_i) prod_{j != i} (x - x_j).
+ *
+ *  Exact with mod_int. In double, coefficients in the monomial basis are
+ *  ill conditioned whatever the algorithm: even at Chebyshev points the
+ *  error is about 1e-9 with 16 points and 1e-2 with 30.
+ */
+template<typename ValueType>
+basic_polynomial<ValueType> interpolate(const std::vector<ValueType>& xs,
+                                        const std::vector<ValueType>& ys)
+{
+    if (xs.size() != ys.size())
+        throw std::invalid_argument("interpolate: xs and ys have different sizes");
+    if (xs.empty())
+        return basic_polynomial<ValueType>();
+
+    detail::subproduct_tree<ValueType> tree(xs);
+
+    // M'(x)
+    const std::vector<ValueType>& m = tree.root();
+    std::vector<ValueType> dm(m.size() - 1);
+    for (std::size_t ind = 1; ind < m.size(); ++ind)
+        dm[ind - 1] = m[ind] * ValueType((long long)ind);
+
+    std::vector<ValueType> w;
+    tree.eval(dm, w);
+    for (std::size_t ind = 0; ind < w.size(); ++ind)
+    {
+        if (w[ind] == ValueType(0))
+            throw std::invalid_argument("interpolate: duplicate points");
+        w[ind] = ys[ind] / w[ind];
+    }
+
+    std::vector<ValueType> c = tree.combine(w);
+    detail::trim(c);
+    return basic_polynomial<ValueType>(std::move(c));
+}
+
+
+} // math
+} // donny
@@ -0,0 +1,180 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * poly_divide.hpp - division of coefficient sequences: long division, and
+ *                   Newton iteration on the reversed divisor's inverse.
+ * dependency: convolution
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "convolution.hpp"
+
+namespace donny {
+namespace math {
+namespace detail {
+
+
+/*
+ *  Newton division is faster than long division when both the divisor and
+ *  the quotient have at least this many coefficients. Long vs Newton for
+ *  a 2n / n division with gcc -O2: double 0.21 vs 0.28 ms at n = 512,
+ *  0.43 vs 0.26 ms at n = 640; mod_int about even at n = 640, 1.4 vs
+ *  1.0 ms at n = 768.
+ */
+const std::size_t newton_division_threshold = 640;
+
+// Drop the zero coefficients of the highest degrees. Vector, here and
+// below, is std::vector or small_vector.
+template<typename Vector>
+void trim(Vector& a)
+{
+    typedef typename Vector::value_type T;
+    while (!a.empty() && a.back() == T(0))
+        a.pop_back();
+}
+
+/*
+ *  Remainder coefficients below gcd_tolerance times the largest coefficient
+ *  of the dividend are rounding noise of a floating point division: an
+ *  exact division of degree 10 polynomials in double leaves about 1e-15.
+ */
+const double gcd_tolerance = 1e-9;
+
+// trim, and for floating point also the negligible coefficients of r
+// against the dividend a.
+template<typename Vector>
+void trim_negligible(Vector& r, const Vector&, std::false_type)
+{
+    trim(r);
+}
+template<typename Vector>
+void trim_negligible(Vector& r, const Vector& a, std::true_type)
+{
+    typedef typename Vector::value_type T;
+    T scale = 0;
+    for (const T& c : a)
+        scale = std::max(scale, std::abs(c));
+    const T eps = scale * (T)gcd_tolerance;
+    while (!r.empty() && std::abs(r.back()) <= eps)
+        r.pop_back();
+}
+template<typename Vector>
+void trim_negligible(Vector& r, const Vector& a)
+{
+    trim_negligible(r, a, std::is_floating_point<typename Vector::value_type>());
+}
+
+// g with f g = 1 mod x^n, f[0] != 0. Each step doubles the precision:
+// g <- g (2 - f g).
+template<typename Vector>
+Vector inverse_series(const Vector& f, std::size_t n)
+{
+    typedef typename Vector::value_type T;
+    Vector g(1, T(1) / f[0]);
+    Vector fg, head;
+    for (std::size_t k = 1; k < n; )
+    {
+        k = std::min(2 * k, n);
+        head.assign(f.begin(), f.begin() + std::min(k, f.size()));
+        multiply(head, g, fg);
+        fg.resize(k);
+        for (T& c : fg) c = -c;
+        fg[0] += T(2);
+        multiply(g, fg, head);
+        head.resize(k);
+        g.swap(head);
+    }
+    g.resize(n);
+    return g;
+}
+
+// Long division, q and r must not be a or b. b is trimmed and not empty.
+template<typename Vector>
+void long_divide(const Vector& a, const Vector& b, Vector& q, Vector& r)
+{
+    typedef typename Vector::value_type T;
+    const std::size_t nb = b.size();
+    r = a;
+    q.assign(a.size() - nb + 1, T(0));
+    const T inv = T(1) / b.back();
+    for (std::size_t ind = a.size(); ind >= nb; --ind)
+    {
+        const T c = r[ind - 1] * inv;
+        q[ind - nb] = c;
+        if (c == T(0)) continue;
+        T* rr = &r[ind - nb];
+        for (std::size_t k = 0; k + 1 < nb; ++k)
+            rr[k] -= c * b[k];
+        r[ind - 1] = T(0);
+    }
+    r.resize(nb - 1);
+}
+
+/*
+ *  The quotient of rev(a) / rev(b) mod x^(m+1), reversed, is the quotient
+ *  of a / b when deg a - deg b = m. That takes O(M(n)) with the inverse
+ *  series of rev(b). invRevB may hold that inverse, to reuse it.
+ */
+template<typename Vector>
+void newton_divide(const Vector& a, const Vector& b, Vector& q, Vector& r,
+                   const Vector* invRevB = nullptr)
+{
+    const std::size_t m = a.size() - b.size() + 1; // coefficients of q
+    Vector inv;
+    if (invRevB == nullptr || invRevB->size() < m)
+    {
+        Vector revB(b.rbegin(), b.rend());
+        inv = inverse_series(revB, m);
+        invRevB = &inv;
+    }
+    Vector revA(a.rbegin(), a.rbegin() + m);
+    Vector head(invRevB->begin(), invRevB->begin() + m);
+    multiply(revA, head, q);
+    q.resize(m);
+    std::reverse(q.begin(), q.end());
+
+    // r = a - q b, only the coefficients below deg b
+    Vector qb;
+    multiply(q, b, qb);
+    r.assign(a.begin(), a.begin() + (b.size() - 1));
+    for (std::size_t ind = 0; ind < r.size(); ++ind)
+        r[ind] -= qb[ind];
+}
+
+/*
+ *  a = q b + r with deg r < deg b. T must be a field: double, mod_int...
+ *  q and r must not be a or b.
+ */
+template<typename Vector>
+void divmod(const Vector& a, Vector b, Vector& q, Vector& r)
+{
+    trim(b);
+    if (b.empty())
+        throw std::invalid_argument("polynomial division by zero");
+    if (a.size() < b.size())
+    {
+        q.clear();
+        r = a;
+    }
+    else if (b.size() < newton_division_threshold ||
+             a.size() - b.size() + 1 < newton_division_threshold)
+        long_divide(a, b, q, r);
+    else
+        newton_divide(a, b, q, r);
+    trim(q);
+    trim(r);
+}
+
+
+} // detail
+} // math
+} // donny
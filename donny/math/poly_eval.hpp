@@ -0,0 +1,225 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * poly_eval.hpp - evaluation of a polynomial at one or many points:
+ *                 Horner, Estrin, and SIMD Horner across points.
+ * dependency: cpu_features
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <donny/cpu_features.hpp>
+
+namespace donny {
+namespace math {
+namespace detail {
+
+
+// c[0] + c[1] x + ... + c[n-1] x^(n-1), n > 0
+template<typename T>
+T horner(const T* c, std::size_t n, T x)
+{
+    T r = c[n - 1];
+    for (std::size_t ind = n - 1; ind > 0; --ind)
+        r = r * x + c[ind - 1];
+    return r;
+}
+
+/*
+ *  Estrin's scheme on blocks of 8 coefficients, blocks combined by Horner
+ *  in x^8. The blocks don't depend on each other, so the dependency chain
+ *  is one multiply-add per 8 coefficients instead of 8.
+ *
+ *  Used from estrin_threshold coefficients on. Horner vs Estrin for one
+ *  double with gcc -O2: about even at 8, 16 vs 10 ns at 16, 37 vs 16 ns
+ *  at 32.
+ */
+const std::size_t estrin_threshold = 16;
+
+template<typename T>
+T estrin(const T* c, std::size_t n, T x)
+{
+    const T x2 = x * x, x4 = x2 * x2, x8 = x4 * x4;
+    const std::size_t nBlocks = n / 8, nTop = n % 8;
+    T r = nTop ? horner(c + nBlocks * 8, nTop, x) : T(0);
+    for (std::size_t block = nBlocks; block > 0; --block)
+    {
+        const T* b = c + (block - 1) * 8;
+        T t0 = b[0] + b[1] * x, t1 = b[2] + b[3] * x;
+        T t2 = b[4] + b[5] * x, t3 = b[6] + b[7] * x;
+        T u0 = t0 + t1 * x2, u1 = t2 + t3 * x2;
+        r = r * x8 + (u0 + u1 * x4);
+    }
+    return r;
+}
+
+template<typename T>
+T eval_one(const T* c, std::size_t n, T x)
+{
+    if (n == 0) return T(0);
+    return (n < estrin_threshold) ? horner(c, n, x) : estrin(c, n, x);
+}
+
+// out[i] = p(xs[i]), Horner on each point.
+template<typename T>
+void eval_points_scalar(const T* c, std::size_t n, const T* xs, T* out, std::size_t count)
+{
+    for (std::size_t ind = 0; ind < count; ++ind)
+        out[ind] = horner(c, n, xs[ind]);
+}
+
+#if DONNY_X86
+/*
+ *  Horner across points: each lane holds its own point and accumulator,
+ *  and 8 vectors are in flight so that the FMA latency is hidden.
+ */
+DONNY_TARGET("avx2,fma")
+inline void eval_points_avx2(const double* c, std::size_t n, const double* xs, double* out, std::size_t count)
+{
+    const __m256d top = _mm256_set1_pd(c[n - 1]);
+    std::size_t ind = 0;
+    for (; ind + 32 <= count; ind += 32)
+    {
+        __m256d x[8], r[8];
+        for (int v = 0; v < 8; ++v)
+        {
+            x[v] = _mm256_loadu_pd(xs + ind + 4 * v);
+            r[v] = top;
+        }
+        for (std::size_t k = n - 1; k > 0; --k)
+        {
+            const __m256d ck = _mm256_set1_pd(c[k - 1]);
+            for (int v = 0; v < 8; ++v)
+                r[v] = _mm256_fmadd_pd(r[v], x[v], ck);
+        }
+        for (int v = 0; v < 8; ++v)
+            _mm256_storeu_pd(out + ind + 4 * v, r[v]);
+    }
+    for (; ind + 4 <= count; ind += 4)
+    {
+        __m256d x = _mm256_loadu_pd(xs + ind), r = top;
+        for (std::size_t k = n - 1; k > 0; --k)
+            r = _mm256_fmadd_pd(r, x, _mm256_set1_pd(c[k - 1]));
+        _mm256_storeu_pd(out + ind, r);
+    }
+    for (; ind < count; ++ind)
+    {
+        double r = c[n - 1];
+        for (std::size_t k = n - 1; k > 0; --k)
+            r = std::fma(r, xs[ind], c[k - 1]);
+        out[ind] = r;
+    }
+}
+
+DONNY_TARGET("avx512f")
+inline void eval_points_avx512(const double* c, std::size_t n, const double* xs, double* out, std::size_t count)
+{
+    const __m512d top = _mm512_set1_pd(c[n - 1]);
+    std::size_t ind = 0;
+    for (; ind + 64 <= count; ind += 64)
+    {
+        __m512d x[8], r[8];
+        for (int v = 0; v < 8; ++v)
+        {
+            x[v] = _mm512_loadu_pd(xs + ind + 8 * v);
+            r[v] = top;
+        }
+        for (std::size_t k = n - 1; k > 0; --k)
+        {
+            const __m512d ck = _mm512_set1_pd(c[k - 1]);
+            for (int v = 0; v < 8; ++v)
+                r[v] = _mm512_fmadd_pd(r[v], x[v], ck);
+        }
+        for (int v = 0; v < 8; ++v)
+            _mm512_storeu_pd(out + ind + 8 * v, r[v]);
+    }
+    if (ind < count)
+    {
+        // The rest with masked loads and stores, 8 points at a time.
+        for (; ind < count; ind += 8)
+        {
+            const std::size_t m = (count - ind < 8) ? count - ind : 8;
+            const __mmask8 mask = (__mmask8)((1u << m) - 1);
+            __m512d x = _mm512_maskz_loadu_pd(mask, xs + ind), r = top;
+            for (std::size_t k = n - 1; k > 0; --k)
+                r = _mm512_fmadd_pd(r, x, _mm512_set1_pd(c[k - 1]));
+            _mm512_mask_storeu_pd(out + ind, mask, r);
+        }
+    }
+}
+#endif
+
+typedef void (*eval_points_fn)(const double*, std::size_t, const double*, double*, std::size_t);
+
+inline eval_points_fn eval_points_impl()
+{
+    static const eval_points_fn fn = []() -> eval_points_fn {
+#if DONNY_X86
+        if (cpu().avx512f) return eval_points_avx512;
+        if (cpu().avx2 && cpu().fma) return eval_points_avx2;
+#endif
+        return eval_points_scalar<double>;
+    }();
+    return fn;
+}
+
+template<typename T>
+void eval_points(const T* c, std::size_t n, const T* xs, T* out, std::size_t count)
+{
+    if (n == 0)
+    {
+        for (std::size_t ind = 0; ind < count; ++ind) out[ind] = T(0);
+        return;
+    }
+    eval_points_scalar(c, n, xs, out, count);
+}
+inline void eval_points(const double* c, std::size_t n, const double* xs, double* out, std::size_t count)
+{
+    if (n == 0)
+    {
+        for (std::size_t ind = 0; ind < count; ++ind) out[ind] = 0;
+        return;
+    }
+    eval_points_impl()(c, n, xs, out, count);
+}
+
+/*
+ *  eval_points on nThreads threads, each on a contiguous range of at
+ *  least minPointsPerThread points.
+ */
+template<typename T>
+void eval_points_parallel(const T* c, std::size_t n, const T* xs, T* out, std::size_t count,
+                          unsigned nThreads, std::size_t minPointsPerThread = 1 << 16)
+{
+    if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0) nThreads = 1;
+    const std::size_t maxThreads = (count + minPointsPerThread - 1) / minPointsPerThread;
+    if (nThreads > maxThreads) nThreads = (unsigned)(maxThreads ? maxThreads : 1);
+
+    // Ranges are multiples of 64 points, the widest SIMD block, and
+    // nThreads of them cover all count points.
+    const std::size_t per = (((count + nThreads - 1) / nThreads + 63) / 64) * 64;
+    std::vector<std::thread> threads;
+    for (unsigned id = 1; id < nThreads; ++id)
+    {
+        const std::size_t begin = id * per;
+        if (begin >= count) break;
+        const std::size_t len = (begin + per <= count) ? per : count - begin;
+        threads.emplace_back([=]() { eval_points(c, n, xs + begin, out + begin, len); });
+    }
+    eval_points(c, n, xs, out, (per < count) ? per : count);
+    for (std::thread& t : threads)
+        t.join();
+}
+
+
+} // detail
+} // math
+} // donny
@@ -0,0 +1,468 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * poly_expr.hpp - expression templates for + - of polynomials and the
+ *                 scaling by a constant, evaluated in one pass.
+ * dependency: small_vector, convolution
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <donny/small_vector.hpp>
+
+#include "convolution.hpp"
+
+namespace donny {
+namespace math {
+
+template<typename ValueType>
+class basic_polynomial;
+
+namespace detail {
+
+
+// out[0, na+nb-1) += a * b, by the method suited to T.
+template<typename T>
+void multiply_add(const T* a, std::size_t na, const T* b, std::size_t nb, T* out)
+{
+    if (na == 0 || nb == 0) return;
+    multiply_into(a, na, b, nb, out, typename multiply_method<T>::type());
+}
+
+/*
+ *  An expression node has
+ *  - size(): the number of coefficients of its value, known before
+ *    evaluating it,
+ *  - accumulate(out, scale): out[0, size()) += scale * value,
+ *  - references(p): whether evaluating it reads the polynomial p.
+ *  Leaves also have data(), the coefficients themselves.
+ */
+
+// A polynomial operand given as an lvalue, by reference.
+template<typename ValueType>
+class poly_ref
+{
+public:
+    explicit poly_ref(const basic_polynomial<ValueType>& p) : _p(&p) {}
+
+    std::size_t size() const { return _p->size(); }
+    const ValueType* data() const { return _p->coefficient_vector().data(); }
+    void accumulate(ValueType* out, const ValueType& scale) const
+    {
+        const ValueType* c = data();
+        const std::size_t n = size();
+        if (scale == ValueType(1))
+            for (std::size_t ind = 0; ind < n; ++ind) out[ind] += c[ind];
+        else
+            for (std::size_t ind = 0; ind < n; ++ind) out[ind] += scale * c[ind];
+    }
+    bool references(const void* p) const { return p == _p; }
+
+private:
+    const basic_polynomial<ValueType>* _p;
+};
+
+// A polynomial operand given as an rvalue, moved into the expression so
+// that the expression can outlive the full expression it comes from.
+template<typename ValueType>
+class poly_value
+{
+public:
+    explicit poly_value(basic_polynomial<ValueType>&& p) : _p(std::move(p)) {}
+
+    std::size_t size() const { return _p.size(); }
+    const ValueType* data() const { return _p.coefficient_vector().data(); }
+    void accumulate(ValueType* out, const ValueType& scale) const
+    {
+        poly_ref<ValueType>(_p).accumulate(out, scale);
+    }
+    bool references(const void*) const { return false; }
+
+private:
+    basic_polynomial<ValueType> _p;
+};
+
+// l + r, or l - r with bSubtract
+template<typename L, typename R, bool bSubtract>
+class poly_sum
+{
+public:
+    poly_sum(L l, R r) : _l(std::move(l)), _r(std::move(r)) {}
+
+    std::size_t size() const { return std::max(_l.size(), _r.size()); }
+    template<typename ValueType>
+    void accumulate(ValueType* out, const ValueType& scale) const
+    {
+        _l.accumulate(out, scale);
+        _r.accumulate(out, bSubtract ? -scale : scale);
+    }
+    bool references(const void* p) const { return _l.references(p) || _r.references(p); }
+
+private:
+    L _l;
+    R _r;
+};
+
+// e v, v a constant
+template<typename E, typename ValueType>
+class poly_scaled
+{
+public:
+    poly_scaled(E e, ValueType v) : _e(std::move(e)), _v(v) {}
+
+    std::size_t size() const { return _e.size(); }
+    void accumulate(ValueType* out, const ValueType& scale) const
+    {
+        _e.accumulate(out, scale * _v);
+    }
+    bool references(const void* p) const { return _e.references(p); }
+
+private:
+    E _e;
+    ValueType _v;
+};
+
+template<typename E>
+struct poly_leaf : std::false_type {};
+template<typename ValueType>
+struct poly_leaf<poly_ref<ValueType>> : std::true_type {};
+template<typename ValueType>
+struct poly_leaf<poly_value<ValueType>> : std::true_type {};
+
+// The coefficients of an operand of a product: leaves as they are, other
+// nodes evaluated into storage.
+template<typename E, typename Storage>
+const typename Storage::value_type* operand_data(const E& e, Storage&, std::true_type)
+{
+    return e.data();
+}
+template<typename E, typename Storage>
+const typename Storage::value_type* operand_data(const E& e, Storage& storage, std::false_type)
+{
+    typedef typename Storage::value_type T;
+    storage.assign(e.size(), T(0));
+    e.accumulate(storage.data(), T(1));
+    return storage.data();
+}
+
+// l r, accumulated by the multiply kernels into the polynomial operator*
+// returns.
+template<typename L, typename R, typename ValueType>
+class poly_product
+{
+public:
+    poly_product(L l, R r) : _l(std::move(l)), _r(std::move(r)) {}
+
+    std::size_t size() const
+    {
+        return (_l.size() && _r.size()) ? _l.size() + _r.size() - 1 : 0;
+    }
+    void accumulate(ValueType* out, const ValueType& scale) const
+    {
+        typename basic_polynomial<ValueType>::coefficient_storage sl, sr, scaled;
+        const std::size_t nl = _l.size(), nr = _r.size();
+        if (nl == 0 || nr == 0) return;
+        const ValueType* l = operand_data(_l, sl, poly_leaf<L>());
+        const ValueType* r = operand_data(_r, sr, poly_leaf<R>());
+        if (!(scale == ValueType(1)))
+        {
+            // Scale the shorter operand.
+            const bool bLeft = (nl <= nr);
+            const ValueType* src = bLeft ? l : r;
+            scaled.assign(src, src + (bLeft ? nl : nr));
+            for (ValueType& c : scaled) c *= scale;
+            (bLeft ? l : r) = scaled.data();
+        }
+        multiply_add(l, nl, r, nr, out);
+    }
+    bool references(const void* p) const { return _l.references(p) || _r.references(p); }
+
+private:
+    L _l;
+    R _r;
+};
+
+template<typename T>
+struct is_poly_expr : std::false_type {};
+
+
+} // detail
+
+
+/**
+ *  The unevaluated value of + - of polynomials and of * by a constant,
+ *  when no operand is a temporary polynomial. It is evaluated when it is
+ *  assigned to, added to or used to construct a basic_polynomial: the
+ *  destination gets its final size at once and every term is accumulated
+ *  into it, without a temporary polynomial per operation.
+ *
+ *  Products are computed at once into a polynomial, and so is + - or * by
+ *  a constant with a temporary polynomial operand, in place in that
+ *  temporary: auto x = a * b holds the product, and a*b + c*d - e makes
+ *  the two products and adds into the first. An expression references
+ *  its operands, and auto x = a + b keeps the sum of a and b as they are
+ *  at every use.
+ */
+template<typename ValueType, typename Node>
+class poly_expr
+{
+public:
+    typedef basic_polynomial<ValueType> polynomial;
+
+    explicit poly_expr(Node node) : _node(std::move(node)) {}
+
+    const Node& node() const & { return _node; }
+    Node node() && { return std::move(_node); }
+
+    // Number of coefficients of the value.
+    std::size_t size() const { return _node.size(); }
+    // out[0, size()) += scale * value
+    void accumulate(ValueType* out, const ValueType& scale) const
+    {
+        _node.accumulate(out, scale);
+    }
+    bool references(const basic_polynomial<ValueType>& p) const
+    {
+        return _node.references(&p);
+    }
+
+    ValueType get(int exponent) const { return polynomial(*this).get(exponent); }
+    ValueType eval(ValueType x) const { return polynomial(*this).eval(x); }
+    std::string str(std::string variable = "x") const
+    {
+        return polynomial(*this).str(variable);
+    }
+
+    poly_expr<ValueType, detail::poly_scaled<Node, ValueType>> operator-() const
+    {
+        return poly_expr<ValueType, detail::poly_scaled<Node, ValueType>>(
+            detail::poly_scaled<Node, ValueType>(_node, ValueType(-1)));
+    }
+
+private:
+    Node _node;
+};
+
+namespace detail {
+
+
+template<typename ValueType, typename Node>
+struct is_poly_expr<poly_expr<ValueType, Node>> : std::true_type {};
+
+/*
+ *  What an argument of an operator becomes in an expression: lvalue
+ *  polynomials a poly_ref, rvalue polynomials a poly_value, expressions
+ *  their node. Not defined for anything else, which takes the operators
+ *  out of overload resolution.
+ */
+template<typename A, typename Decayed = typename std::decay<A>::type>
+struct poly_operand {};
+
+template<typename A, typename ValueType>
+struct poly_operand<A, basic_polynomial<ValueType>>
+{
+    typedef ValueType value_type;
+    typedef typename std::conditional<std::is_lvalue_reference<A>::value,
+        poly_ref<ValueType>, poly_value<ValueType>>::type node;
+    static const bool bTemporary = !std::is_lvalue_reference<A>::value;
+
+    static poly_ref<ValueType> make(const basic_polynomial<ValueType>& p, std::true_type)
+    {
+        return poly_ref<ValueType>(p);
+    }
+    static poly_value<ValueType> make(basic_polynomial<ValueType>& p, std::false_type)
+    {
+        return poly_value<ValueType>(std::move(p));
+    }
+    static node make(A& a)
+    {
+        return make(a, std::is_lvalue_reference<A>());
+    }
+};
+
+template<typename A, typename ValueType, typename Node>
+struct poly_operand<A, poly_expr<ValueType, Node>>
+{
+    typedef ValueType value_type;
+    typedef Node node;
+    static const bool bTemporary = false;
+
+    static node make(A& a)
+    {
+        return std::forward<A>(a).node();
+    }
+};
+
+template<typename... T>
+struct voider
+{
+    typedef void type;
+};
+
+// Where a + b or a - b is computed.
+struct sum_expression {}; // in an expression, no operand is a temporary
+struct sum_in_left {};    // in place in a, a temporary polynomial
+struct sum_in_right {};   // in place in b, a temporary polynomial
+
+// The result types of a binary operation, empty (and the operator not
+// viable) unless both are operands of the same value type.
+template<typename A, typename B, typename = void>
+struct poly_binary {};
+
+template<typename A, typename B>
+struct poly_binary<A, B, typename std::enable_if<std::is_same<
+    typename poly_operand<A>::value_type, typename poly_operand<B>::value_type>::value>::type>
+{
+    typedef typename poly_operand<A>::value_type value_type;
+    typedef typename poly_operand<A>::node left;
+    typedef typename poly_operand<B>::node right;
+    typedef basic_polynomial<value_type> polynomial;
+
+    typedef typename std::conditional<poly_operand<A>::bTemporary, sum_in_left,
+        typename std::conditional<poly_operand<B>::bTemporary, sum_in_right,
+                                  sum_expression>::type>::type form;
+    static const bool bExpression = std::is_same<form, sum_expression>::value;
+
+    typedef typename std::conditional<bExpression,
+        poly_expr<value_type, poly_sum<left, right, false>>, polynomial>::type sum;
+    typedef typename std::conditional<bExpression,
+        poly_expr<value_type, poly_sum<left, right, true>>, polynomial>::type difference;
+    typedef poly_expr<value_type, poly_product<left, right, value_type>> product_expr;
+};
+
+template<typename A, typename = void>
+struct poly_unary {};
+
+template<typename A>
+struct poly_unary<A, typename voider<typename poly_operand<A>::value_type>::type>
+{
+    typedef typename poly_operand<A>::value_type value_type;
+    typedef std::integral_constant<bool, poly_operand<A>::bTemporary> in_place;
+    typedef typename std::conditional<in_place::value, basic_polynomial<value_type>,
+        poly_expr<value_type, poly_scaled<typename poly_operand<A>::node, value_type>>>::type scaled;
+};
+
+// a + b, or a - b with bSubtract, in the place form tells.
+template<bool bSubtract, typename Result, typename A, typename B>
+Result poly_add(A& a, B& b, sum_in_left)
+{
+    if (bSubtract) a -= b;
+    else a += b;
+    return std::move(a);
+}
+template<bool bSubtract, typename Result, typename A, typename B>
+Result poly_add(A& a, B& b, sum_in_right)
+{
+    if (bSubtract) b = -std::move(b);
+    b += a;
+    return std::move(b);
+}
+template<bool bSubtract, typename Result, typename A, typename B>
+Result poly_add(A& a, B& b, sum_expression)
+{
+    return Result({ poly_operand<A>::make(a), poly_operand<B>::make(b) });
+}
+
+// a v, in place in a temporary polynomial a.
+template<typename Result, typename A, typename ValueType>
+Result poly_scale(A& a, const ValueType& v, std::true_type)
+{
+    a *= v;
+    return std::move(a);
+}
+template<typename Result, typename A, typename ValueType>
+Result poly_scale(A& a, const ValueType& v, std::false_type)
+{
+    return Result({ poly_operand<A>::make(a), v });
+}
+
+// An operand as a polynomial, evaluating expressions.
+template<typename ValueType>
+const basic_polynomial<ValueType>& as_polynomial(const basic_polynomial<ValueType>& p)
+{
+    return p;
+}
+template<typename ValueType, typename Node>
+basic_polynomial<ValueType> as_polynomial(const poly_expr<ValueType, Node>& e)
+{
+    return basic_polynomial<ValueType>(e);
+}
+
+// R, for operands of which at least one is an expression, for the
+// operators that evaluate them.
+template<typename A, typename B, typename R, typename = void>
+struct if_poly_expr {};
+
+template<typename A, typename B, typename R>
+struct if_poly_expr<A, B, R, typename std::enable_if<
+    (is_poly_expr<typename std::decay<A>::type>::value ||
+     is_poly_expr<typename std::decay<B>::type>::value),
+    typename voider<typename poly_binary<A, B>::value_type>::type>::type>
+{
+    typedef R type;
+};
+
+
+} // detail
+
+template<typename A, typename B>
+typename detail::poly_binary<A, B>::sum operator+(A&& a, B&& b)
+{
+    typedef detail::poly_binary<A, B> binary;
+    return detail::poly_add<false, typename binary::sum, A, B>(a, b, typename binary::form());
+}
+
+template<typename A, typename B>
+typename detail::poly_binary<A, B>::difference operator-(A&& a, B&& b)
+{
+    typedef detail::poly_binary<A, B> binary;
+    return detail::poly_add<true, typename binary::difference, A, B>(a, b, typename binary::form());
+}
+
+// The product is computed at once, in a polynomial of its final size.
+template<typename A, typename B>
+typename detail::poly_binary<A, B>::polynomial operator*(A&& a, B&& b)
+{
+    typedef detail::poly_binary<A, B> binary;
+    return typename binary::polynomial(typename binary::product_expr(
+        { detail::poly_operand<A>::make(a), detail::poly_operand<B>::make(b) }));
+}
+
+template<typename A>
+typename detail::poly_unary<A>::scaled operator*(
+    A&& a, const typename detail::poly_operand<A>::value_type& v)
+{
+    typedef detail::poly_unary<A> unary;
+    return detail::poly_scale<typename unary::scaled, A>(a, v, typename unary::in_place());
+}
+
+template<typename A>
+typename detail::poly_unary<A>::scaled operator*(
+    const typename detail::poly_operand<A>::value_type& v, A&& a)
+{
+    typedef detail::poly_unary<A> unary;
+    return detail::poly_scale<typename unary::scaled, A>(a, v, typename unary::in_place());
+}
+
+template<typename A, typename B>
+typename detail::if_poly_expr<A, B, bool>::type operator==(const A& a, const B& b)
+{
+    return detail::as_polynomial(a) == detail::as_polynomial(b);
+}
+
+template<typename A, typename B>
+typename detail::if_poly_expr<A, B, bool>::type operator!=(const A& a, const B& b)
+{
+    return !(detail::as_polynomial(a) == detail::as_polynomial(b));
+}
+
+
+} // math
+} // donny
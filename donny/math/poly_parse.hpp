@@ -0,0 +1,472 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * poly_parse.hpp - parsing of polynomial expressions, shared by the dense
+ *                  and the sparse polynomial classes.
+ * dependency: format_string, number_reader
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <cctype>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <donny/format_string.hpp>
+#include <donny/number_reader.hpp>
+
+namespace donny {
+namespace math {
+namespace detail {
+
+
+/*
+ *  Precedence climbing over [s, s + n) in a single pass, the input is
+ *  never copied. From loose to tight: + -, then * / and implicit
+ *  multiplication ("2x", "x(x+1)"), then ^ which is left associative,
+ *  then the sign of an operand: -x^2 is (-x)^2, 2^3^2 is (2^3)^2.
+ *
+ *  A value stays a single term c x^e as long as it is one, so
+ *  "3x^2 - 2x + 1" is added term by term into one polynomial with
+ *  add_to(), and no polynomial is built for a term or a number.
+ *
+ *  Errors in the values (a negative exponent or one with the variable,
+ *  a variable in a denominator) are only reported once the whole group
+ *  around them has been read, those of ^ first: a syntax error anywhere
+ *  in the group comes before them, as in the old parser.
+ *
+ *  Polynomial needs: construction from (coefficient, exponent), add_to(),
+ *  unary -, += -= *=, *= and /= by a scalar, ^ int, degree(), get(),
+ *  shrink() and divide_exact().
+ */
+template<typename Polynomial, typename ValueType>
+class polynomial_parser
+{
+public:
+    polynomial_parser(const char* s, std::size_t n, char variable)
+        : _s(s), _n((int)n), _ind(0), _variable(variable), _opPos(-1), _bAfterNumber(false),
+          _deferredRank(0)
+    {
+    }
+
+    Polynomial parse()
+    {
+        if (!std::isalpha((unsigned char)_variable))
+            throw std::invalid_argument("variable should be a letter");
+        if (_n == 0)
+            throw std::invalid_argument("parsing empty string");
+
+        operand r;
+        _prefix(r, -1);
+        _climb(r, 1, -1);
+        _throw_deferred();
+        Polynomial p = r.bMonomial ? Polynomial(r.c, r.e) : std::move(r.p);
+        p.shrink();
+        return p;
+    }
+
+private:
+    // c x^e while the value is a single term, p once it is not.
+    struct operand
+    {
+        operand() : bMonomial(true), c(0), e(0), pos(0) {}
+        void set(ValueType c_, int e_, int pos_)
+        {
+            c = c_;
+            e = e_;
+            pos = pos_;
+        }
+
+        bool bMonomial;
+        ValueType c;
+        int e;
+        Polynomial p;
+        int pos; // where the operand starts, for errors
+    };
+
+    // Numbers are read in ValueType when it is a floating point type.
+    typedef typename std::conditional<std::is_floating_point<ValueType>::value,
+                                      ValueType, double>::type number_type;
+
+    const char* _s;
+    const int _n;
+    int _ind;
+    const char _variable;
+    int _opPos;          // the last operator or sign read
+    bool _bAfterNumber;  // a variable right after a number multiplies it
+    std::string _deferred; // the error in the values of the current group
+    int _deferredRank;     // 2 for ^, 1 for /, 0 without error
+
+    std::invalid_argument _error(const char* msg, int pos) const
+    {
+        return std::invalid_argument(format_string() <<
+            msg << ": \'" << _s[pos] << '\'' <<
+            " at position " << pos << " .");
+    }
+
+    // Keep the first error of the highest rank until the group is read.
+    void _defer(int rank, const std::invalid_argument& error)
+    {
+        if (rank <= _deferredRank) return;
+        _deferredRank = rank;
+        _deferred = error.what();
+    }
+
+    void _throw_deferred() const
+    {
+        if (_deferredRank > 0)
+            throw std::invalid_argument(_deferred);
+    }
+
+    void _skip_spaces()
+    {
+        while (_ind < _n && _s[_ind] == ' ') ++_ind;
+    }
+
+    static int _precedence(char op)
+    {
+        switch (op)
+        {
+        case '+':
+        case '-':
+            return 1;
+        case '*':
+        case '/':
+            return 2;
+        default: // '^'
+            return 3;
+        }
+    }
+
+    /*
+     *  The operator after an operand, '\0' at the end of the input or at
+     *  the ')' closing the group opened at position open (-1 outside any
+     *  group). bImplicit is set for the multiplications without '*'.
+     */
+    char _peek_operator(int open, bool& bImplicit)
+    {
+        _skip_spaces();
+        bImplicit = false;
+        if (_ind >= _n) return '\0';
+
+        const char c = _s[_ind];
+        switch (c)
+        {
+        case '+':
+        case '-':
+        case '*':
+        case '/':
+        case '^':
+            return c;
+        case '(':
+            bImplicit = true;
+            return '*';
+        case ')':
+            if (open >= 0) return '\0';
+            break;
+        default:
+            if (c == _variable && _bAfterNumber)
+            {
+                bImplicit = true;
+                return '*';
+            }
+        }
+        throw _error("expect an operator", _ind);
+    }
+
+    /*
+     *  Apply the operators of precedence minPrecedence or more following
+     *  lhs, in place. Operands are filled in place as well: a value is
+     *  never copied or moved on its way up.
+     */
+    void _climb(operand& lhs, int minPrecedence, int open)
+    {
+        bool bImplicit;
+        for (char op; (op = _peek_operator(open, bImplicit)) != '\0'; )
+        {
+            const int precedence = _precedence(op);
+            if (precedence < minPrecedence) break;
+            if (!bImplicit) _opPos = _ind++;
+
+            operand rhs;
+            _prefix(rhs, open);
+            _climb(rhs, precedence + 1, open);
+            _apply(lhs, op, rhs);
+        }
+    }
+
+    // An operand with an optional sign, which belongs to the operand
+    // before any ^.
+    void _prefix(operand& x, int open)
+    {
+        _skip_spaces();
+        bool bNegative = false;
+        if (_ind < _n && (_s[_ind] == '+' || _s[_ind] == '-'))
+        {
+            bNegative = (_s[_ind] == '-');
+            _opPos = _ind++;
+        }
+        _primary(x, open);
+        if (bNegative) _negate(x);
+    }
+
+    // A number, the variable or a group in parentheses.
+    void _primary(operand& x, int open)
+    {
+        _skip_spaces();
+        if (_ind >= _n)
+        {
+            if (open >= 0)
+                throw _error("parentheses not closed", open);
+            if (_opPos < 0) // only spaces
+                throw std::invalid_argument("parsing empty string");
+            throw _error("expect an operand", _opPos);
+        }
+
+        const int start = _ind;
+        const char c = _s[_ind];
+        _bAfterNumber = false;
+
+        if (c == _variable)
+        {
+            ++_ind;
+            x.set(ValueType(1), 1, start);
+            return;
+        }
+        if (std::isdigit((unsigned char)c) || c == '.')
+        {
+            x.set(_number(), 0, start);
+            _bAfterNumber = true;
+            return;
+        }
+        switch (c)
+        {
+        case '(':
+        {
+            ++_ind;
+            _skip_spaces();
+            if (_ind < _n && _s[_ind] == ')')
+                throw _error("empty parentheses not allowed", start);
+
+            // The group reports its own errors as soon as it is closed.
+            std::string outer;
+            outer.swap(_deferred);
+            const int outerRank = _deferredRank;
+            _deferredRank = 0;
+            _prefix(x, start);
+            _climb(x, 1, start);
+            if (_ind >= _n)
+                throw _error("parentheses not closed", start);
+            ++_ind; // ')'
+            _throw_deferred();
+            _deferred.swap(outer);
+            _deferredRank = outerRank;
+            _bAfterNumber = false;
+            x.pos = start;
+            return;
+        }
+        case ')':
+            if (open >= 0)
+                throw _error("expect an operand", _opPos);
+            throw _error("unexpected symbol", start);
+        case '+':
+        case '-':
+        case '*':
+        case '/':
+        case '^':
+            throw _error("unexpected symbol", start);
+        default:
+            throw _error("unrecognized symbol", start);
+        }
+    }
+
+    // Digits with at most one '.', correctly rounded.
+    ValueType _number()
+    {
+        const int start = _ind;
+        int pPoint = -1;
+        for (; _ind < _n && (std::isdigit((unsigned char)_s[_ind]) || _s[_ind] == '.'); ++_ind)
+        {
+            if (_s[_ind] != '.') continue;
+            if (pPoint != -1)
+                throw _error("unexpected symbol", _ind);
+            pPoint = _ind;
+        }
+        if (_ind - start == 1 && pPoint == start)
+            throw _error("unexpected symbol", start);
+
+        number_type val = 0;
+        parse_float(_s + start, _s + _ind, val);
+        return ValueType(val);
+    }
+
+    static int _degree(const operand& x)
+    {
+        if (x.bMonomial)
+            return (x.c == ValueType(0)) ? -1 : x.e;
+        return x.p.degree();
+    }
+
+    // The coefficient of x^0.
+    static ValueType _constant(const operand& x)
+    {
+        if (x.bMonomial)
+            return (x.e == 0) ? x.c : ValueType(0);
+        return x.p.get(0);
+    }
+
+    static Polynomial& _polynomial(operand& x)
+    {
+        if (x.bMonomial)
+        {
+            x.p = Polynomial(x.c, x.e);
+            x.bMonomial = false;
+        }
+        return x.p;
+    }
+
+    // Take the polynomial of b as the value of a.
+    static void _take(operand& a, operand& b)
+    {
+        a.p = std::move(b.p);
+        a.bMonomial = false;
+    }
+
+    static void _negate(operand& x)
+    {
+        if (x.bMonomial) x.c = -x.c;
+        else x.p = -std::move(x.p);
+    }
+
+    static ValueType _power(ValueType c, int e)
+    {
+        ValueType r(1);
+        for (; e; e >>= 1)
+        {
+            if (e & 1) r *= c;
+            if (e > 1) c *= c;
+        }
+        return r;
+    }
+
+    // a = a op b, nothing is computed any more once an error is deferred.
+    void _apply(operand& a, char op, operand& b)
+    {
+        if (_deferredRank > 0)
+        {
+            // The right operand of ^ never depends on what is skipped.
+            if (op == '^') _check_exponent(b);
+            return;
+        }
+        switch (op)
+        {
+        case '+':
+        case '-':
+            if (b.bMonomial)
+            {
+                const ValueType c = (op == '-') ? -b.c : b.c;
+                if (a.bMonomial && a.e == b.e) a.c += c;
+                else _polynomial(a).add_to(c, b.e);
+            }
+            else if (a.bMonomial)
+            {
+                if (op == '-') _negate(b);
+                b.p.add_to(a.c, a.e);
+                _take(a, b);
+            }
+            else if (op == '-') a.p -= b.p;
+            else a.p += b.p;
+            break;
+
+        case '*':
+            if (a.bMonomial && b.bMonomial)
+            {
+                a.c *= b.c;
+                a.e += b.e;
+                break;
+            }
+            if (b.bMonomial && b.e == 0)
+                a.p *= b.c;
+            else if (a.bMonomial && a.e == 0)
+            {
+                b.p *= a.c;
+                _take(a, b);
+            }
+            else
+                _polynomial(a) *= _polynomial(b);
+            a.p.shrink();
+            break;
+
+        case '/':
+            if (_degree(b) <= 0)
+            {
+                // A zero denominator divides by zero, as the scalar / does.
+                const ValueType d = _constant(b);
+                if (a.bMonomial) a.c /= d;
+                else a.p /= d;
+            }
+            else if (a.bMonomial && b.bMonomial && a.e >= b.e)
+            {
+                a.c /= b.c;
+                a.e -= b.e;
+            }
+            // Only exact divisions give a polynomial.
+            else if (!_polynomial(a).divide_exact(_polynomial(b)))
+                _defer(1, _error("polynomial with variables in denominator is not supported", b.pos));
+            break;
+
+        default: // '^'
+        {
+            if (!_check_exponent(b)) break;
+            const int e = (int)_constant(b);
+            if (a.bMonomial)
+            {
+                a.c = _power(a.c, e);
+                a.e *= e;
+            }
+            else
+            {
+                a.p = a.p ^ e;
+                a.p.shrink();
+            }
+        }
+        }
+    }
+
+    // Defers the error of an exponent which is not a natural number.
+    bool _check_exponent(const operand& b)
+    {
+        const int d = _degree(b);
+        if (d > 0)
+        {
+            _defer(2, _error("polynomial can't have variables in the exponent", b.pos));
+            return false;
+        }
+        if (d == 0 && (int)_constant(b) < 0)
+        {
+            _defer(2, std::invalid_argument("exponent can only be non-negative"));
+            return false;
+        }
+        return true;
+    }
+
+};
+
+/*
+ *  The parser behind basic_polynomial::parse and
+ *  basic_sparse_polynomial::parse, on the n characters at s.
+ */
+template<typename Polynomial, typename ValueType>
+Polynomial parse_polynomial(const char* s, std::size_t n, char variable)
+{
+    return polynomial_parser<Polynomial, ValueType>(s, n, variable).parse();
+}
+
+
+} // detail
+} // math
+} // donny
@@ -2,7 +2,8 @@
  * donnylib - A lightweight library for c++
  * 
  * polynomial.hpp - a non-negative integer exponent polynomial class.
- * dependency: format_string
+ * dependency: format_string, small_vector, vector_view, convolution, poly_divide, poly_eval,
+ *             poly_expr, poly_parse
  * 
  * Author : Donny
  */
@@ -13,32 +14,144 @@
 #include <string>
 #include <stdexcept>
 #include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <utility>
 #include <donny/format_string.hpp>
+#include <donny/small_vector.hpp>
+#include <donny/vector_view.hpp>
+
+#include "convolution.hpp"
+#include "poly_divide.hpp"
+#include "poly_eval.hpp"
+#include "poly_expr.hpp"
+#include "poly_parse.hpp"
 
 namespace donny {
 namespace math {
+namespace detail {
+
+
+// c x^exponent as str() prints it, skipping zeros; a '+' before every
+// positive term but the first.
+template<typename ValueType>
+void append_term(format_string& fs, const ValueType& c, int exponent,
+                 const std::string& variable, bool& bFirst)
+{
+    if (c == (ValueType)0) return;
+
+    if (bFirst) bFirst = false;
+    else if (c > (ValueType)0) fs << '+';
+
+    if (exponent == 0)
+        fs << c;
+    else
+    {
+        if (c == -1)
+            fs << '-';
+        else if (c != 1)
+            fs << c;
+        fs << variable;
+        if (exponent > 1)
+            fs << "^" << exponent;
+    }
+}
+
+
+} // detail
 
 
 template<typename ValueType>
 class basic_polynomial
 {
 public:
+    // Up to degree 7 the coefficients are stored inline, most polynomials
+    // never allocate.
+    typedef small_vector<ValueType, 8> coefficient_storage;
+
     basic_polynomial() {}
     explicit basic_polynomial(ValueType coefficient, int exponent = 0)
     {
-        *this = basic_polynomial().add(coefficient, exponent);
+        add_to(coefficient, exponent);
     }
 
-    basic_polynomial add(ValueType coefficient, int exponent) const
+    // Coefficients of x^0, x^1, ...
+    explicit basic_polynomial(const std::vector<ValueType>& coefficients_)
+        : coefficients(coefficients_.begin(), coefficients_.end())
     {
-        basic_polynomial p = *this;
-        if (p.coefficients.size() <= exponent)
-        {
-            p.coefficients.resize(exponent+1);
-        }
-        p.coefficients[exponent] += coefficient;
+    }
+    explicit basic_polynomial(coefficient_storage coefficients_)
+        : coefficients(std::move(coefficients_))
+    {
+    }
+
+    basic_polynomial(const basic_polynomial&) = default;
+    basic_polynomial(basic_polynomial&&) = default;
+    basic_polynomial& operator=(const basic_polynomial&) = default;
+    basic_polynomial& operator=(basic_polynomial&&) = default;
+
+    // Evaluate an expression of + - * into a polynomial of its final size.
+    template<typename Node>
+    basic_polynomial(const poly_expr<ValueType, Node>& e)
+        : coefficients(e.size())
+    {
+        e.accumulate(coefficients.data(), ValueType(1));
+    }
+    template<typename Node>
+    basic_polynomial& operator=(const poly_expr<ValueType, Node>& e)
+    {
+        if (e.references(*this))
+            return *this = basic_polynomial(e);
+        coefficients.assign(e.size(), ValueType(0));
+        e.accumulate(coefficients.data(), ValueType(1));
+        return *this;
+    }
+
+    // Copy with room for the new exponent, chained temporaries are
+    // updated in place.
+    basic_polynomial add(ValueType coefficient, int exponent) const &
+    {
+        basic_polynomial p;
+        p.coefficients.reserve(std::max<std::size_t>(coefficients.size(), exponent + 1));
+        p.coefficients = coefficients;
+        p.add_to(coefficient, exponent);
         return p;
     }
+    basic_polynomial add(ValueType coefficient, int exponent) &&
+    {
+        add_to(coefficient, exponent);
+        return std::move(*this);
+    }
+    basic_polynomial& add_to(ValueType coefficient, int exponent)
+    {
+        if (coefficients.size() <= (std::size_t)exponent)
+            coefficients.resize(exponent + 1);
+        coefficients[exponent] += coefficient;
+        return *this;
+    }
+
+    // Make room for coefficients up to x^degree.
+    void reserve(int degree)
+    {
+        coefficients.reserve(degree + 1);
+    }
+    // Number of coefficients stored, the degree plus one after shrink().
+    std::size_t size() const
+    {
+        return coefficients.size();
+    }
+    const coefficient_storage& coefficient_vector() const
+    {
+        return coefficients;
+    }
+
+    // The highest exponent with a non-zero coefficient, -1 for zero.
+    int degree() const
+    {
+        int last = (int)coefficients.size() - 1;
+        while (last >= 0 && coefficients[last] == (ValueType)0) --last;
+        return last;
+    }
 
     ValueType get(int exponent) const
     {
@@ -48,26 +161,62 @@ public:
 
     ValueType eval(ValueType x) const
     {
-        ValueType powx = 1;
-        ValueType result = 0;
-        for (int ind = 0; ind < coefficients.size(); ++ind)
-        {
-            result += powx * coefficients[ind];
-            powx *= x;
-        }
-        return result;
+        return detail::eval_one(coefficients.data(), coefficients.size(), x);
+    }
+
+    /**
+     *  out[i] = eval(xs[i]) for every point, several points at once with
+     *  AVX2/AVX-512 when ValueType is double. out holds at least xs.size()
+     *  values.
+     */
+    void eval(vector_view<const ValueType> xs, vector_view<ValueType> out) const
+    {
+        if (out.size() < xs.size())
+            throw std::invalid_argument("eval: output is smaller than input");
+        detail::eval_points(coefficients.data(), coefficients.size(),
+                            xs.data(), out.data(), xs.size());
+    }
+    /**
+     *  eval of very large arrays on nThreads threads.
+     *  @param nThreads : 0 means std::thread::hardware_concurrency().
+     */
+    void eval_parallel(vector_view<const ValueType> xs, vector_view<ValueType> out,
+                       unsigned nThreads = 0) const
+    {
+        if (out.size() < xs.size())
+            throw std::invalid_argument("eval: output is smaller than input");
+        detail::eval_points_parallel(coefficients.data(), coefficients.size(),
+                                     xs.data(), out.data(), xs.size(), nThreads);
     }
 
+    /**
+     *  this(p(x)), by Horner's rule on polynomials: r = r p + c[i] from the
+     *  top coefficient down. The two buffers have the final size from the
+     *  start, nothing is allocated in the loop.
+     */
     basic_polynomial subsitute(const basic_polynomial& p) const
     {
-        basic_polynomial powp(1);
-        basic_polynomial result;
-        for (int ind = 0; ind < coefficients.size(); ++ind)
+        int n = degree();
+        if (n <= 0)
+            return basic_polynomial(get(0));
+
+        const coefficient_storage& c = p.coefficients;
+        const std::size_t np = p.size();
+        if (np == 0)
+            return basic_polynomial(coefficients[0]);
+
+        coefficient_storage r, next;
+        r.reserve(n * (np - 1) + 1);
+        next.reserve(n * (np - 1) + 1);
+        r.assign(1, coefficients[n]);
+        for (int ind = n - 1; ind >= 0; --ind)
         {
-            result = result + powp * coefficients[ind];
-            powp = powp * p;
+            next.assign(r.size() + np - 1, ValueType(0));
+            detail::multiply_add(r.data(), r.size(), c.data(), np, next.data());
+            next[0] += coefficients[ind];
+            r.swap(next);
         }
-        return result;
+        return basic_polynomial(std::move(r));
     }
 
     std::string str(std::string variable = "x") const
@@ -78,25 +227,7 @@ public:
         bool bFirst = true;
 
         for (int ind = 0; ind < coefficients.size(); ++ind)
-        {
-            if (coefficients[ind] == (ValueType)0) continue;
-            
-            if (bFirst) bFirst = false;
-            else if (coefficients[ind] > (ValueType)0) fs << '+';
-
-            if (ind == 0)
-                fs << coefficients[ind];
-            else
-            {
-                if (coefficients[ind] == -1)
-                    fs << '-';
-                else if (coefficients[ind] != 1)
-                    fs << coefficients[ind];
-                fs << variable;
-                if (ind > 1)
-                    fs << "^" << ind;
-            }
-        }
+            detail::append_term(fs, coefficients[ind], ind, variable, bFirst);
 
         std::string s = fs.str();
         return s.empty() ? "0" : s;
@@ -110,62 +241,111 @@ public:
         coefficients.erase(coefficients.begin()+last+1, coefficients.end());
     }
 
-    basic_polynomial operator-()
+    basic_polynomial operator-() const &
     {
         basic_polynomial p;
         p.coefficients.resize(coefficients.size());
-        for (int ind = 0; ind < coefficients.size(); ++ind)
-        {
+        for (std::size_t ind = 0; ind < coefficients.size(); ++ind)
             p.coefficients[ind] = -coefficients[ind];
-        }
         return p;
     }
+    basic_polynomial operator-() &&
+    {
+        for (ValueType& c : coefficients)
+            c = -c;
+        return std::move(*this);
+    }
 
-    basic_polynomial operator=(const basic_polynomial& o)
+    // In place arithmetic, safe with o being *this.
+    basic_polynomial& operator+=(const basic_polynomial& o)
     {
-        coefficients = o.coefficients;
+        if (coefficients.size() < o.coefficients.size())
+            coefficients.resize(o.coefficients.size());
+        for (std::size_t ind = 0; ind < o.coefficients.size(); ++ind)
+            coefficients[ind] += o.coefficients[ind];
         return *this;
     }
-
-    static basic_polynomial parse(const std::string sPolynomial, const char variable)
+    basic_polynomial& operator-=(const basic_polynomial& o)
     {
-        return parse(sPolynomial, variable, 0, sPolynomial.size());
+        if (coefficients.size() < o.coefficients.size())
+            coefficients.resize(o.coefficients.size());
+        for (std::size_t ind = 0; ind < o.coefficients.size(); ++ind)
+            coefficients[ind] -= o.coefficients[ind];
+        return *this;
+    }
+    template<typename Node>
+    basic_polynomial& operator+=(const poly_expr<ValueType, Node>& e)
+    {
+        return _accumulate(e, ValueType(1));
+    }
+    template<typename Node>
+    basic_polynomial& operator-=(const poly_expr<ValueType, Node>& e)
+    {
+        return _accumulate(e, ValueType(-1));
+    }
+    template<typename Node>
+    basic_polynomial& operator*=(const poly_expr<ValueType, Node>& e)
+    {
+        return *this *= basic_polynomial(e);
+    }
+    basic_polynomial& operator*=(const basic_polynomial& o)
+    {
+        coefficient_storage product;
+        detail::multiply(coefficients, o.coefficients, product);
+        coefficients.swap(product);
+        return *this;
+    }
+    basic_polynomial& operator*=(const ValueType v)
+    {
+        for (ValueType& c : coefficients)
+            c *= v;
+        return *this;
+    }
+    basic_polynomial& operator/=(const ValueType v)
+    {
+        for (ValueType& c : coefficients)
+            c /= v;
+        return *this;
+    }
+    // Quotient and remainder of polynomial division, ValueType a field.
+    basic_polynomial& operator/=(const basic_polynomial& d)
+    {
+        coefficient_storage q, r;
+        detail::divmod(coefficients, d.coefficients, q, r);
+        coefficients.swap(q);
+        return *this;
+    }
+    basic_polynomial& operator%=(const basic_polynomial& d)
+    {
+        coefficient_storage q, r;
+        detail::divmod(coefficients, d.coefficients, q, r);
+        coefficients.swap(r);
+        return *this;
     }
 
-    template<typename _ValueType>
-    friend
-    basic_polynomial<_ValueType> operator+(
-        const basic_polynomial<_ValueType>& a,
-        const basic_polynomial<_ValueType>& b
-    );
-
-    template<typename _ValueType>
-    friend
-    basic_polynomial<_ValueType> operator-(
-        const basic_polynomial<_ValueType>& a,
-        const basic_polynomial<_ValueType>& b
-    );
-
-    template<typename _ValueType>
-    friend
-    basic_polynomial<_ValueType> operator*(
-        const basic_polynomial<_ValueType>& a,
-        const basic_polynomial<_ValueType>& b
-    );
-
-    template<typename _ValueType>
-    friend
-    basic_polynomial<_ValueType> operator*(
-        const basic_polynomial<_ValueType>& a,
-        const _ValueType b
-    );
+    /**
+     *  Divide by d when d divides *this, within rounding for floating
+     *  point ValueType. Otherwise leave *this unchanged and return false.
+     */
+    bool divide_exact(const basic_polynomial& d)
+    {
+        coefficient_storage q, r;
+        detail::divmod(coefficients, d.coefficients, q, r);
+        detail::trim_negligible(r, coefficients);
+        if (!r.empty()) return false;
+        coefficients.swap(q);
+        return true;
+    }
 
-    template<typename _ValueType>
-    friend
-    basic_polynomial<_ValueType> operator/(
-        const basic_polynomial<_ValueType>& m,
-        const _ValueType d
-    );
+    static basic_polynomial parse(const std::string& sPolynomial, const char variable)
+    {
+        return parse(sPolynomial.data(), sPolynomial.size(), variable);
+    }
+    // The n characters at s, a line of a larger buffer needs no copy.
+    static basic_polynomial parse(const char* s, std::size_t n, const char variable)
+    {
+        return detail::parse_polynomial<basic_polynomial, ValueType>(s, n, variable);
+    }
 
     template<typename _ValueType>
     friend
@@ -189,83 +369,194 @@ public:
     );
 
 private:
-    std::vector<ValueType> coefficients;
+    coefficient_storage coefficients;
+
+    template<typename Node>
+    basic_polynomial& _accumulate(const poly_expr<ValueType, Node>& e, const ValueType& scale)
+    {
+        if (e.references(*this))
+        {
+            const basic_polynomial value(e);
+            return (scale == ValueType(1)) ? (*this += value) : (*this -= value);
+        }
+        if (coefficients.size() < e.size())
+            coefficients.resize(e.size());
+        e.accumulate(coefficients.data(), scale);
+        return *this;
+    }
 
-    static basic_polynomial parse(
-        const std::string sPolynomial,
-        const char variable,
-        const int pBegin,
-        const int pEnd
-    );
 };
 
 template<typename ValueType>
-basic_polynomial<ValueType> operator+(
-    const basic_polynomial<ValueType>& a,
-    const basic_polynomial<ValueType>& b
+basic_polynomial<ValueType> operator/(
+    const basic_polynomial<ValueType>& m,
+    const ValueType d
 )
 {
-    const basic_polynomial<ValueType>& shorter = (a.coefficients.size() <= b.coefficients.size()) ? a : b;
-    const basic_polynomial<ValueType>& longer = (a.coefficients.size() > b.coefficients.size()) ? a : b;
-    basic_polynomial<ValueType> p = longer;
-    for (int ind = 0; ind < shorter.coefficients.size(); ++ind)
-        p = p.add(shorter.coefficients[ind], ind);
+    basic_polynomial<ValueType> p = m;
+    p /= d;
     return p;
 }
 
 template<typename ValueType>
-basic_polynomial<ValueType> operator-(
+basic_polynomial<ValueType> operator/(
+    basic_polynomial<ValueType>&& m,
+    const ValueType d
+)
+{
+    m /= d;
+    return std::move(m);
+}
+
+/**
+ *  a = q b + r with deg r < deg b, returned as (q, r).
+ *  ValueType must be a field (double, mod_int...). Throws
+ *  std::invalid_argument when b is zero.
+ */
+template<typename ValueType>
+std::pair<basic_polynomial<ValueType>, basic_polynomial<ValueType>> divmod(
     const basic_polynomial<ValueType>& a,
     const basic_polynomial<ValueType>& b
 )
 {
-    const basic_polynomial<ValueType>& shorter = (a.coefficients.size() <= b.coefficients.size()) ? a : b;
-    const basic_polynomial<ValueType>& longer = (a.coefficients.size() > b.coefficients.size()) ? a : b;
-    basic_polynomial<ValueType> p = longer;
-    for (int ind = 0; ind < shorter.coefficients.size(); ++ind)
-        p = p.add(-shorter.coefficients[ind], ind);
-    return p;
+    typename basic_polynomial<ValueType>::coefficient_storage q, r;
+    detail::divmod(a.coefficient_vector(), b.coefficient_vector(), q, r);
+    return std::make_pair(basic_polynomial<ValueType>(std::move(q)),
+                          basic_polynomial<ValueType>(std::move(r)));
 }
 
 template<typename ValueType>
-basic_polynomial<ValueType> operator*(
+basic_polynomial<ValueType> operator/(
     const basic_polynomial<ValueType>& a,
     const basic_polynomial<ValueType>& b
 )
 {
-    basic_polynomial<ValueType> p;
-    for (int ia = 0; ia < a.coefficients.size(); ++ia)
-    {
-        for (int ib = 0; ib < b.coefficients.size(); ++ib)
-            p = p.add(a.coefficients[ia] * b.coefficients[ib], ia + ib);
-    }
-    return p;
+    return divmod(a, b).first;
 }
 
 template<typename ValueType>
-basic_polynomial<ValueType> operator*(
+basic_polynomial<ValueType> operator%(
     const basic_polynomial<ValueType>& a,
-    const ValueType b
+    const basic_polynomial<ValueType>& b
 )
 {
-    basic_polynomial<ValueType> p = a;
-    for (int ind = 0; ind < p.coefficients.size(); ++ind)
-        p.coefficients[ind] = p.coefficients[ind] * b;
-    return p;
+    return divmod(a, b).second;
 }
 
-template<typename ValueType>
+// divmod, / and % with expressions, evaluated first.
+template<typename A, typename B>
+typename detail::if_poly_expr<A, B, std::pair<typename detail::poly_binary<A, B>::polynomial,
+                                              typename detail::poly_binary<A, B>::polynomial>>::type
+divmod(const A& a, const B& b)
+{
+    return divmod(detail::as_polynomial(a), detail::as_polynomial(b));
+}
+
+template<typename A, typename B>
+typename detail::if_poly_expr<A, B, typename detail::poly_binary<A, B>::polynomial>::type
+operator/(const A& a, const B& b)
+{
+    return divmod(detail::as_polynomial(a), detail::as_polynomial(b)).first;
+}
+
+template<typename A, typename B>
+typename detail::if_poly_expr<A, B, typename detail::poly_binary<A, B>::polynomial>::type
+operator%(const A& a, const B& b)
+{
+    return divmod(detail::as_polynomial(a), detail::as_polynomial(b)).second;
+}
+
+template<typename ValueType, typename Node>
 basic_polynomial<ValueType> operator/(
-    const basic_polynomial<ValueType>& m,
+    const poly_expr<ValueType, Node>& m,
     const ValueType d
 )
 {
-    basic_polynomial<ValueType> p = m;
-    for (int ind = 0; ind < p.coefficients.size(); ++ind)
-        p.coefficients[ind] = p.coefficients[ind] / d;
+    basic_polynomial<ValueType> p(m);
+    p /= d;
     return p;
 }
 
+/**
+ *  g = gcd(a, b) = s a + t b, with deg s < deg b and deg t < deg a.
+ */
+template<typename ValueType>
+basic_polynomial<ValueType> extended_gcd(
+    const basic_polynomial<ValueType>& a,
+    const basic_polynomial<ValueType>& b,
+    basic_polynomial<ValueType>& s,
+    basic_polynomial<ValueType>& t
+)
+{
+    typedef basic_polynomial<ValueType> _polynomial;
+
+    typename _polynomial::coefficient_storage r0 = a.coefficient_vector(), r1 = b.coefficient_vector();
+    detail::trim(r0);
+    detail::trim(r1);
+    _polynomial s0(1), s1, t0, t1(1);
+    typename _polynomial::coefficient_storage q, r;
+    while (!r1.empty())
+    {
+        detail::divmod(r0, r1, q, r);
+        detail::trim_negligible(r, r0);
+        _polynomial pq(std::move(q));
+        s0 -= pq * s1;
+        t0 -= pq * t1;
+        std::swap(s0, s1);
+        std::swap(t0, t1);
+        r0.swap(r1);
+        r1.swap(r);
+    }
+
+    if (r0.empty())
+    {
+        s = _polynomial();
+        t = _polynomial();
+        return _polynomial();
+    }
+    const ValueType lead = r0.back();
+    s = std::move(s0 /= lead);
+    t = std::move(t0 /= lead);
+    s.shrink();
+    t.shrink();
+    _polynomial g(std::move(r0));
+    return g /= lead;
+}
+
+/**
+ *  The monic greatest common divisor, zero if both are zero.
+ *
+ *  For floating point ValueType, remainder coefficients below
+ *  detail::gcd_tolerance times the largest coefficient of the dividend
+ *  count as zero.
+ */
+template<typename ValueType>
+basic_polynomial<ValueType> gcd(
+    const basic_polynomial<ValueType>& a,
+    const basic_polynomial<ValueType>& b
+)
+{
+    basic_polynomial<ValueType> s, t;
+    return extended_gcd(a, b, s, t);
+}
+
+// extended_gcd and gcd of expressions, evaluated first.
+template<typename A, typename B>
+typename detail::if_poly_expr<A, B, typename detail::poly_binary<A, B>::polynomial>::type
+extended_gcd(const A& a, const B& b,
+             typename detail::poly_binary<A, B>::polynomial& s,
+             typename detail::poly_binary<A, B>::polynomial& t)
+{
+    return extended_gcd(detail::as_polynomial(a), detail::as_polynomial(b), s, t);
+}
+
+template<typename A, typename B>
+typename detail::if_poly_expr<A, B, typename detail::poly_binary<A, B>::polynomial>::type
+gcd(const A& a, const B& b)
+{
+    return gcd(detail::as_polynomial(a), detail::as_polynomial(b));
+}
+
 template<typename ValueType>
 basic_polynomial<ValueType> operator^(
     const basic_polynomial<ValueType>& _p,
@@ -278,25 +569,28 @@ basic_polynomial<ValueType> operator^(
     if (_e == 0)
         return basic_polynomial<ValueType>(1);
 
+    // Square and multiply, from the highest bit of the exponent down.
+    int bit = 1;
+    while (bit <= _e / 2) bit <<= 1;
     basic_polynomial<ValueType> p = _p;
-    int e = _e - 1;
-    while (e >= 1)
+    for (bit >>= 1; bit; bit >>= 1)
     {
-        if (e % 2 == 0)
-        {
-            e /= 2;
-            p = p * p;
-        }
-        else
-        {
-            e -= 1;
-            p = p * _p;
-        }
+        p *= p;
+        if (_e & bit) p *= _p;
     }
 
     return p;
 }
 
+template<typename ValueType, typename Node>
+basic_polynomial<ValueType> operator^(
+    const poly_expr<ValueType, Node>& p,
+    const int e
+)
+{
+    return basic_polynomial<ValueType>(p) ^ e;
+}
+
 template<typename ValueType>
 bool operator==(
     const basic_polynomial<ValueType>& a,
@@ -332,244 +626,6 @@ bool operator!=(
     return !(a == b);
 }
 
-template<typename ValueType>
-basic_polynomial<ValueType> basic_polynomial<ValueType>::parse(
-    const std::string sPolynomial,
-    const char variable,
-    const int pBegin,
-    const int pEnd
-)
-{
-#define THROW_INVALID_SYMBOL(msg, pos) \
-    throw std::invalid_argument(format_string() << \
-        msg << ": \'" << sPolynomial[pos] << '\'' << \
-        " at position " << (pos) << " .")
-
-#define GET_NEXT_OP \
-    [&]() { \
-        while (ind+1 < pEnd && sPolynomial[ind+1] == ' ') ++ind; \
-        if (ind+1 >= pEnd) return '\0'; \
-        switch(sPolynomial[ind+1]) \
-        { \
-        case '+': \
-        case '-': \
-        case '*': \
-        case '/': \
-        case '^': \
-            if (ind+2 >= pEnd) \
-                THROW_INVALID_SYMBOL("expect an operand", ind+1); \
-            ++ind; \
-            return sPolynomial[ind]; \
-        case '(': \
-            return '*'; \
-        default: \
-            THROW_INVALID_SYMBOL("expect an operator", ind+1); \
-        } \
-    }
-
-    typedef basic_polynomial<ValueType> _polynomial;
-    struct item
-    {
-        _polynomial p;
-        char op; // operation
-        int pos_start;
-    };
-
-    if (!std::isalpha(variable))
-        throw std::invalid_argument("variable should be a letter");
-    if (sPolynomial.empty())
-        throw std::invalid_argument("parsing empty string");
-
-    std::vector<item> poly_items;
-
-    // Convert string to struct item objects
-    int sign = 0; // 0: not specify; 1: positive; -1: negative;
-    int pos_start = 0;
-    int parentheses_cnt = 0;
-    item next_item;
-    for (int ind = pBegin; ind < pEnd; ++ind)
-    {
-        switch (sPolynomial[ind])
-        {
-        case '+':
-            if (sign == 0) sign = 1;
-            else
-                THROW_INVALID_SYMBOL("unexpected symbol", ind);
-            break; // do nothing
-        case '-':
-            if (sign == 0) sign = -1;
-            else
-                THROW_INVALID_SYMBOL("unexpected symbol", ind);
-            break;
-        case ' ':
-            break; // do nothing
-        case '(':
-            pos_start = ind; parentheses_cnt = 1; ++ind;
-            while (ind < pEnd &&
-                   parentheses_cnt != 0)
-            {
-                if (sPolynomial[ind] == '(') ++parentheses_cnt;
-                else if (sPolynomial[ind] == ')') --parentheses_cnt;
-                ++ind;
-            }
-            --ind;
-            if (ind >= pEnd)
-                THROW_INVALID_SYMBOL("parentheses not closed", pos_start);
-            if (ind-pos_start-1 <= 0)
-                THROW_INVALID_SYMBOL("empty parentheses not allowed", pos_start);
-            next_item.pos_start = pos_start;
-            next_item.p = parse(sPolynomial, variable, pos_start+1, ind);
-            if (sign == -1) next_item.p = -next_item.p;
-            next_item.op = GET_NEXT_OP();
-            poly_items.push_back(next_item);
-            sign = 0;
-            break;
-        case '*':
-        case '/':
-        case ')':
-        case '^':
-            THROW_INVALID_SYMBOL("unexpected symbol", ind);
-            break;
-        default:
-            if (sPolynomial[ind] == variable)
-            {
-                next_item.pos_start = ind;
-                next_item.p = _polynomial().add((sign == -1) ? -1 : 1, 1);
-                next_item.op = GET_NEXT_OP();
-                poly_items.push_back(next_item);
-                sign = 0;
-            }
-            else if (std::isdigit(sPolynomial[ind]) || sPolynomial[ind] == '.')
-            {
-                int pPoint = -1;
-                double val = 0;
-                pos_start = ind;
-                while (ind < pEnd &&
-                       (std::isdigit(sPolynomial[ind]) || sPolynomial[ind] == '.'))
-                {
-                    if (sPolynomial[ind] == '.')
-                    {
-                        if (pPoint == -1) pPoint = ind;
-                        else
-                            THROW_INVALID_SYMBOL("unexpected symbol", ind);
-                    }
-                    else
-                    {
-                        val = val * 10 + (sPolynomial[ind] - '0');
-                    }
-                    ++ind;
-                }
-                --ind;
-                if (pPoint != -1 && ind - pos_start + 1 <= 1)
-                    THROW_INVALID_SYMBOL("unexpected symbol", pos_start);
-                if (pPoint != -1)
-                    val = val * std::pow(0.1, ind - pPoint);
-                next_item.pos_start = pos_start;
-                next_item.p = _polynomial((sign == -1) ? -val : val);
-                while (ind+1 < pEnd && sPolynomial[ind+1] == ' ') ++ind;
-                if (ind+1 < pEnd && sPolynomial[ind+1] == variable)
-                    next_item.op = '*';
-                else
-                    next_item.op = GET_NEXT_OP();
-                poly_items.push_back(next_item);
-                sign = 0;
-            }
-            else
-                THROW_INVALID_SYMBOL("unrecognized symbol", ind);
-        } // switch
-    } // for
-
-    if (poly_items.rbegin()->op != '\0')
-        throw std::logic_error("unknown error (0x01)");
-
-    // Calculate power
-    for (int ind = 0; ind < poly_items.size(); )
-    {
-        if (poly_items[ind].op == '^')
-        {
-            auto& C2s = poly_items[ind+1].p.coefficients;
-            if (C2s.size() > 1)
-                THROW_INVALID_SYMBOL(
-                    "polynomial can't have variables in the exponent",
-                    poly_items[ind+1].pos_start
-                );
-            if (C2s.size() == 1)
-                poly_items[ind].p = poly_items[ind].p ^ C2s[0];
-            else // C2s.size() == 0
-                poly_items[ind].p = _polynomial(1);
-            
-            poly_items[ind].p.shrink();
-            poly_items[ind].op = poly_items[ind+1].op;
-            poly_items.erase(poly_items.begin()+ind+1);
-        }
-        else ++ind;
-    }
-
-    // Calculate multiply and divide
-    for (int ind = 0; ind < poly_items.size(); )
-    {
-        if (poly_items[ind].op == '*')
-        {
-            poly_items[ind].p = poly_items[ind].p * poly_items[ind+1].p;
-
-            poly_items[ind].p.shrink();
-            poly_items[ind].op = poly_items[ind+1].op;
-            poly_items.erase(poly_items.begin()+ind+1);
-        }
-        else if (poly_items[ind].op == '/')
-        {
-            auto& C2s = poly_items[ind+1].p.coefficients;
-            if (C2s.size() > 1)
-                THROW_INVALID_SYMBOL(
-                    "polynomial with variables in denominator is not supported",
-                    poly_items[ind+1].pos_start
-                );
-            if (C2s.size() == 1)
-                poly_items[ind].p = poly_items[ind].p / C2s[0];
-            else // C2s.size() == 0
-                poly_items[ind].p = poly_items[ind].p / (ValueType)0;
-
-            poly_items[ind].p.shrink();
-            poly_items[ind].op = poly_items[ind+1].op;
-            poly_items.erase(poly_items.begin()+ind+1);
-        }
-        else ++ind;
-    }
-
-    // Calculate plus and sub
-    for (int ind = 0; ind < poly_items.size(); )
-    {
-        switch (poly_items[ind].op)
-        {
-        case '+':
-            poly_items[ind].p = poly_items[ind].p + poly_items[ind+1].p;
-
-            poly_items[ind].p.shrink();
-            poly_items[ind].op = poly_items[ind+1].op;
-            poly_items.erase(poly_items.begin()+ind+1);
-            break;
-        case '-':
-            poly_items[ind].p = poly_items[ind].p - poly_items[ind+1].p;
-
-            poly_items[ind].p.shrink();
-            poly_items[ind].op = poly_items[ind+1].op;
-            poly_items.erase(poly_items.begin()+ind+1);
-            break;
-        default:
-            ++ind;
-        }
-    }
-
-    if (poly_items.size() != 1)
-        throw std::logic_error("unknown error (0x02)");
-
-    poly_items[0].p.shrink();
-    return poly_items[0].p;
-
-#undef THROW_INVALID_SYMBOL
-#undef GET_NEXT_OP
-}
-
 typedef basic_polynomial<double> polynomial;
 
 
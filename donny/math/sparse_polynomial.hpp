@@ -0,0 +1,740 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * sparse_polynomial.hpp - a polynomial stored as its non-zero terms, for
+ *                         high degrees with few terms.
+ * dependency: format_string, polynomial, convolution, poly_parse
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <donny/format_string.hpp>
+
+#include "polynomial.hpp"
+#include "convolution.hpp"
+#include "poly_parse.hpp"
+
+namespace donny {
+namespace math {
+namespace detail {
+
+
+/*
+ *  A sparse product goes through the dense multiply when its n m term
+ *  products are at least this many per coefficient of the result, that
+ *  is n m >= dense_product_fill (deg a + deg b + 1). Heap vs dense for
+ *  double with gcc -O2, at about that ratio: 0.25 vs 0.23 ms at degree
+ *  2000, 3.3 vs 5.2 ms at degree 20000, 36 vs 105 ms at degree 200000;
+ *  at 10 products per coefficient the heap is 5 to 8 times slower.
+ */
+const double dense_product_fill = 1.0;
+
+/*
+ *  basic_sparse_polynomial keeps a dense coefficient vector while at
+ *  least this fraction of the coefficients up to the degree is non-zero.
+ *  A term is an exponent and a coefficient, so from there on the vector is
+ *  no larger, and get(), add_to() and + - index it instead of searching
+ *  and merging.
+ */
+const double dense_fill = 0.5;
+
+// x^e, e >= 0, by squaring.
+template<typename T>
+T power(T x, unsigned long long e)
+{
+    T r(1);
+    for (; e; e >>= 1, x *= x)
+        if (e & 1) r *= x;
+    return r;
+}
+
+// For floating point, coefficients below gcd_tolerance times the largest
+// coefficient of a are rounding noise.
+template<typename T>
+bool negligible(const T& c, const T& scale, std::true_type)
+{
+    return std::abs(c) <= scale * (T)gcd_tolerance;
+}
+template<typename T>
+bool negligible(const T& c, const T&, std::false_type)
+{
+    return c == T(0);
+}
+
+
+} // detail
+
+
+/**
+ *  A polynomial stored as its non-zero terms, for high degrees with few
+ *  terms. x^1000000 takes one term where basic_polynomial takes a million
+ *  coefficients; memory and time follow the number of terms.
+ *
+ *  The storage follows the fill ratio by itself: (exponent, coefficient)
+ *  pairs sorted by exponent while fewer than detail::dense_fill of the
+ *  coefficients are non-zero, a dense coefficient vector otherwise. Every
+ *  operation leaves the form that fits its result, so a value always has
+ *  the same form.
+ *
+ *  Same operators, parse() and str() as basic_polynomial. Products use a
+ *  heap merge of the term pairs, and switch to the dense multiply when
+ *  the product is expected to be full enough (detail::dense_product_fill).
+ */
+template<typename ValueType>
+class basic_sparse_polynomial
+{
+public:
+    typedef std::pair<int, ValueType> term;
+
+    basic_sparse_polynomial() : _nTerms(0), _bDense(false) {}
+    explicit basic_sparse_polynomial(ValueType coefficient, int exponent = 0)
+        : _nTerms(0), _bDense(false)
+    {
+        add_to(coefficient, exponent);
+    }
+    explicit basic_sparse_polynomial(const basic_polynomial<ValueType>& p)
+        : coefficients(p.coefficient_vector().begin(), p.coefficient_vector().end()),
+          _nTerms(0), _bDense(true)
+    {
+        shrink();
+    }
+
+    basic_sparse_polynomial(const basic_sparse_polynomial&) = default;
+    basic_sparse_polynomial& operator=(const basic_sparse_polynomial&) = default;
+    // The moved-from polynomial is zero.
+    basic_sparse_polynomial(basic_sparse_polynomial&& o)
+        : terms(std::move(o.terms)), coefficients(std::move(o.coefficients)),
+          _nTerms(o._nTerms), _bDense(o._bDense)
+    {
+        o._clear();
+    }
+    basic_sparse_polynomial& operator=(basic_sparse_polynomial&& o)
+    {
+        if (this != &o)
+        {
+            terms = std::move(o.terms);
+            coefficients = std::move(o.coefficients);
+            _nTerms = o._nTerms;
+            _bDense = o._bDense;
+            o._clear();
+        }
+        return *this;
+    }
+
+    basic_polynomial<ValueType> to_dense() const
+    {
+        typedef typename basic_polynomial<ValueType>::coefficient_storage storage;
+        if (_bDense)
+            return basic_polynomial<ValueType>(storage(coefficients.begin(), coefficients.end()));
+        storage c(degree() + 1);
+        for (const term& t : terms)
+            c[t.first] = t.second;
+        return basic_polynomial<ValueType>(std::move(c));
+    }
+
+    basic_sparse_polynomial add(ValueType coefficient, int exponent) const &
+    {
+        basic_sparse_polynomial p = *this;
+        p.add_to(coefficient, exponent);
+        return p;
+    }
+    basic_sparse_polynomial add(ValueType coefficient, int exponent) &&
+    {
+        add_to(coefficient, exponent);
+        return std::move(*this);
+    }
+    basic_sparse_polynomial& add_to(ValueType coefficient, int exponent)
+    {
+        if (exponent < 0)
+            throw std::invalid_argument("exponent can only be non-negative");
+        if (coefficient == (ValueType)0)
+            return *this;
+
+        // Dense while the result stays full enough, x^e past the end included.
+        if (_bDense && ((std::size_t)exponent < coefficients.size() ||
+                        _nTerms + 1 >= detail::dense_fill * (exponent + 1)))
+        {
+            if ((std::size_t)exponent >= coefficients.size())
+                coefficients.resize(exponent + 1, (ValueType)0);
+            _add_at(exponent, coefficient);
+        }
+        else
+        {
+            _to_sparse();
+            auto it = _find(exponent);
+            if (it != terms.end() && it->first == exponent)
+            {
+                it->second += coefficient;
+                if (it->second == (ValueType)0)
+                    terms.erase(it);
+            }
+            else
+                terms.insert(it, term(exponent, coefficient));
+        }
+        _normalize();
+        return *this;
+    }
+
+    // Number of non-zero terms.
+    std::size_t size() const
+    {
+        return _bDense ? _nTerms : terms.size();
+    }
+    // The non-zero terms sorted by exponent, a copy in either form.
+    std::vector<term> term_vector() const
+    {
+        if (!_bDense) return terms;
+        std::vector<term> v;
+        v.reserve(_nTerms);
+        for (std::size_t ind = 0; ind < coefficients.size(); ++ind)
+            if (coefficients[ind] != (ValueType)0)
+                v.push_back(term((int)ind, coefficients[ind]));
+        return v;
+    }
+    // Whether the coefficients are stored as a dense vector.
+    bool is_dense() const
+    {
+        return _bDense;
+    }
+    // The highest exponent with a non-zero coefficient, -1 for zero.
+    int degree() const
+    {
+        if (_bDense) return (int)coefficients.size() - 1;
+        return terms.empty() ? -1 : terms.back().first;
+    }
+    // Non-zero terms over degree() + 1.
+    double fill_ratio() const
+    {
+        return (size() == 0) ? 1.0 : (double)size() / (degree() + 1);
+    }
+
+    ValueType get(int exponent) const
+    {
+        if (_bDense)
+            return (exponent >= 0 && (std::size_t)exponent < coefficients.size())
+                ? coefficients[exponent] : (ValueType)0;
+        auto it = std::lower_bound(terms.begin(), terms.end(), exponent,
+            [](const term& t, int e) { return t.first < e; });
+        if (it == terms.end() || it->first != exponent) return (ValueType)0;
+        return it->second;
+    }
+
+    // Horner, over the gaps between exponents when sparse.
+    ValueType eval(ValueType x) const
+    {
+        if (_bDense)
+        {
+            ValueType r(0);
+            for (std::size_t ind = coefficients.size(); ind > 0; --ind)
+            {
+                r *= x;
+                r += coefficients[ind - 1];
+            }
+            return r;
+        }
+        if (terms.empty()) return (ValueType)0;
+        ValueType r = terms.back().second;
+        for (std::size_t ind = terms.size() - 1; ind > 0; --ind)
+        {
+            r *= detail::power(x, terms[ind].first - terms[ind - 1].first);
+            r += terms[ind - 1].second;
+        }
+        return r * detail::power(x, terms[0].first);
+    }
+
+    basic_sparse_polynomial subsitute(const basic_sparse_polynomial& p) const
+    {
+        basic_sparse_polynomial powp(1);
+        basic_sparse_polynomial result;
+        int exponent = 0;
+        for (const term& t : term_vector())
+        {
+            powp *= p ^ (t.first - exponent);
+            exponent = t.first;
+            result += powp * t.second;
+        }
+        return result;
+    }
+
+    std::string str(std::string variable = "x") const
+    {
+        format_string fs;
+        bool bFirst = true;
+
+        if (_bDense)
+            for (std::size_t ind = 0; ind < coefficients.size(); ++ind)
+                detail::append_term(fs, coefficients[ind], (int)ind, variable, bFirst);
+        else
+            for (const term& t : terms)
+                detail::append_term(fs, t.second, t.first, variable, bFirst);
+
+        std::string s = fs.str();
+        return s.empty() ? "0" : s;
+    }
+
+    // Drop zero coefficients, left only by arithmetic on ValueType.
+    void shrink()
+    {
+        if (_bDense)
+            _nTerms = coefficients.size() - std::count(coefficients.begin(), coefficients.end(), (ValueType)0);
+        else
+            terms.erase(std::remove_if(terms.begin(), terms.end(),
+                            [](const term& t) { return t.second == (ValueType)0; }),
+                        terms.end());
+        _normalize();
+    }
+
+    basic_sparse_polynomial operator-() const &
+    {
+        basic_sparse_polynomial p = *this;
+        return -std::move(p);
+    }
+    basic_sparse_polynomial operator-() &&
+    {
+        for (term& t : terms)
+            t.second = -t.second;
+        for (ValueType& c : coefficients)
+            c = -c;
+        shrink();
+        return std::move(*this);
+    }
+
+    basic_sparse_polynomial& operator+=(const basic_sparse_polynomial& o)
+    {
+        _add(o, ValueType(1));
+        return *this;
+    }
+    basic_sparse_polynomial& operator-=(const basic_sparse_polynomial& o)
+    {
+        _add(o, ValueType(-1));
+        return *this;
+    }
+    basic_sparse_polynomial& operator*=(const basic_sparse_polynomial& o)
+    {
+        if (size() == 0 || o.size() == 0)
+        {
+            _clear();
+            return *this;
+        }
+        const double nProductTerms = (double)size() * o.size();
+        if (nProductTerms >= detail::dense_product_fill * (degree() + o.degree() + 1))
+            _dense_multiply(o);
+        else
+            _heap_multiply(o);
+        _normalize();
+        return *this;
+    }
+    basic_sparse_polynomial& operator*=(const ValueType v)
+    {
+        if (v == (ValueType)0)
+            _clear();
+        for (term& t : terms)
+            t.second *= v;
+        for (ValueType& c : coefficients)
+            c *= v;
+        shrink(); // products may underflow to 0
+        return *this;
+    }
+    basic_sparse_polynomial& operator/=(const ValueType v)
+    {
+        for (term& t : terms)
+            t.second /= v;
+        for (ValueType& c : coefficients)
+            c /= v;
+        shrink();
+        return *this;
+    }
+    // Quotient and remainder of polynomial division, ValueType a field.
+    basic_sparse_polynomial& operator/=(const basic_sparse_polynomial& d)
+    {
+        basic_sparse_polynomial r;
+        _divide(d, r);
+        return *this;
+    }
+    basic_sparse_polynomial& operator%=(const basic_sparse_polynomial& d)
+    {
+        basic_sparse_polynomial r;
+        _divide(d, r);
+        return *this = std::move(r);
+    }
+
+    /**
+     *  Divide by d when d divides *this, within rounding for floating
+     *  point ValueType. Otherwise leave *this unchanged and return false.
+     */
+    bool divide_exact(const basic_sparse_polynomial& d)
+    {
+        ValueType scale(0);
+        for (const term& t : term_vector())
+            scale = std::max(scale, _magnitude(t.second));
+        basic_sparse_polynomial q = *this, r;
+        q._divide(d, r);
+        for (const term& t : r.term_vector())
+            if (!detail::negligible(t.second, scale, std::is_floating_point<ValueType>()))
+                return false;
+        *this = std::move(q);
+        return true;
+    }
+
+    static basic_sparse_polynomial parse(const std::string& sPolynomial, const char variable)
+    {
+        return parse(sPolynomial.data(), sPolynomial.size(), variable);
+    }
+    // The n characters at s, a line of a larger buffer needs no copy.
+    static basic_sparse_polynomial parse(const char* s, std::size_t n, const char variable)
+    {
+        return detail::parse_polynomial<basic_sparse_polynomial, ValueType>(s, n, variable);
+    }
+
+    // Equal values have the same form.
+    friend bool operator==(const basic_sparse_polynomial& a, const basic_sparse_polynomial& b)
+    {
+        if (a._bDense != b._bDense) return false;
+        return a._bDense ? a.coefficients == b.coefficients : a.terms == b.terms;
+    }
+    friend bool operator!=(const basic_sparse_polynomial& a, const basic_sparse_polynomial& b)
+    {
+        return !(a == b);
+    }
+
+private:
+    // One form at a time: terms while sparse, coefficients without
+    // trailing zeros while dense, then _nTerms counts the non-zeros.
+    std::vector<term> terms;
+    std::vector<ValueType> coefficients;
+    std::size_t _nTerms;
+    bool _bDense;
+
+    typename std::vector<term>::iterator _find(int exponent)
+    {
+        return std::lower_bound(terms.begin(), terms.end(), exponent,
+            [](const term& t, int e) { return t.first < e; });
+    }
+
+    template<typename T>
+    static T _magnitude(const T& c) { return c < T(0) ? -c : c; }
+
+    void _clear()
+    {
+        terms.clear();
+        coefficients.clear();
+        _nTerms = 0;
+        _bDense = false;
+    }
+
+    // coefficients[e] += c while dense, keeping _nTerms.
+    void _add_at(std::size_t e, const ValueType& c)
+    {
+        if (c == (ValueType)0) return;
+        ValueType& x = coefficients[e];
+        const bool bWasZero = (x == (ValueType)0);
+        x += c;
+        if (bWasZero) ++_nTerms;
+        else if (x == (ValueType)0) --_nTerms;
+    }
+
+    void _to_sparse()
+    {
+        if (!_bDense) return;
+        terms.clear();
+        terms.reserve(_nTerms);
+        for (std::size_t ind = 0; ind < coefficients.size(); ++ind)
+            if (coefficients[ind] != (ValueType)0)
+                terms.push_back(term((int)ind, coefficients[ind]));
+        std::vector<ValueType>().swap(coefficients);
+        _bDense = false;
+    }
+
+    void _to_dense()
+    {
+        if (_bDense) return;
+        coefficients.assign(degree() + 1, (ValueType)0);
+        for (const term& t : terms)
+            coefficients[t.first] = t.second;
+        _nTerms = terms.size();
+        std::vector<term>().swap(terms);
+        _bDense = true;
+    }
+
+    // Switch to the form the fill ratio asks for, after every change.
+    void _normalize()
+    {
+        if (_bDense)
+        {
+            while (!coefficients.empty() && coefficients.back() == (ValueType)0)
+                coefficients.pop_back();
+            if (coefficients.empty() || _nTerms < detail::dense_fill * coefficients.size())
+                _to_sparse();
+        }
+        else if (!terms.empty() && terms.size() >= detail::dense_fill * (terms.back().first + 1))
+            _to_dense();
+    }
+
+    // *this += scale o, in place while dense and o fits.
+    void _add(const basic_sparse_polynomial& o, const ValueType& scale)
+    {
+        if (_bDense && o._bDense)
+        {
+            if (coefficients.size() < o.coefficients.size())
+                coefficients.resize(o.coefficients.size(), (ValueType)0);
+            // x += x reads every coefficient before writing it.
+            for (std::size_t ind = 0; ind < o.coefficients.size(); ++ind)
+                _add_at(ind, o.coefficients[ind] * scale);
+        }
+        else if (_bDense && o.degree() <= degree())
+        {
+            for (const term& t : o.terms)
+                _add_at(t.first, t.second * scale);
+        }
+        else if (o._bDense)
+        {
+            const std::vector<term> oTerms = o.term_vector();
+            _to_sparse();
+            _merge(oTerms, scale, 0);
+        }
+        else
+        {
+            _to_sparse();
+            _merge(o.terms, scale, 0);
+        }
+        _normalize();
+    }
+
+    // *this += scale x^shift o, merging the two sorted term lists.
+    void _merge(const std::vector<term>& o, const ValueType& scale, int shift)
+    {
+        std::vector<term> merged;
+        merged.reserve(terms.size() + o.size());
+        std::size_t i = 0, j = 0;
+        while (i < terms.size() || j < o.size())
+        {
+            if (j == o.size() ||
+                (i < terms.size() && terms[i].first < o[j].first + shift))
+                merged.push_back(terms[i++]);
+            else if (i == terms.size() || terms[i].first > o[j].first + shift)
+            {
+                merged.push_back(term(o[j].first + shift, o[j].second * scale));
+                ++j;
+            }
+            else
+            {
+                const ValueType c = terms[i].second + o[j].second * scale;
+                if (c != (ValueType)0)
+                    merged.push_back(term(terms[i].first, c));
+                ++i; ++j;
+            }
+        }
+        terms.swap(merged);
+    }
+
+    /*
+     *  Johnson's heap merge: a heap holds, for every term a_i of the
+     *  shorter operand, the next product a_i b_j not yet emitted. Products
+     *  come out sorted by exponent, in O(n m log n) time and O(n) extra
+     *  memory besides the result.
+     */
+    void _heap_multiply(const basic_sparse_polynomial& o)
+    {
+        // x *= x finds o sparse as well.
+        _to_sparse();
+        std::vector<term> oDense;
+        if (o._bDense) oDense = o.term_vector();
+        const std::vector<term>& oTerms = o._bDense ? oDense : o.terms;
+
+        const std::vector<term>& a = (terms.size() <= oTerms.size()) ? terms : oTerms;
+        const std::vector<term>& b = (terms.size() <= oTerms.size()) ? oTerms : terms;
+
+        struct cursor
+        {
+            int exponent;
+            std::size_t i, j;
+        };
+        auto later = [](const cursor& x, const cursor& y) { return x.exponent > y.exponent; };
+        std::vector<cursor> heap;
+        heap.reserve(a.size());
+        for (std::size_t i = 0; i < a.size(); ++i)
+            heap.push_back(cursor{ a[i].first + b[0].first, i, 0 });
+        std::make_heap(heap.begin(), heap.end(), later);
+
+        std::vector<term> product;
+        while (!heap.empty())
+        {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            cursor& c = heap.back();
+            const ValueType v = a[c.i].second * b[c.j].second;
+            if (!product.empty() && product.back().first == c.exponent)
+                product.back().second += v;
+            else
+            {
+                if (!product.empty() && product.back().second == (ValueType)0)
+                    product.pop_back();
+                product.push_back(term(c.exponent, v));
+            }
+            if (++c.j < b.size())
+            {
+                c.exponent = a[c.i].first + b[c.j].first;
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
+            else
+                heap.pop_back();
+        }
+        if (!product.empty() && product.back().second == (ValueType)0)
+            product.pop_back();
+        terms.swap(product);
+    }
+
+    // The coefficient vector, built from the terms while sparse.
+    const std::vector<ValueType>& _dense_view(std::vector<ValueType>& buffer) const
+    {
+        if (_bDense) return coefficients;
+        buffer.assign(degree() + 1, (ValueType)0);
+        for (const term& t : terms) buffer[t.first] = t.second;
+        return buffer;
+    }
+
+    void _dense_multiply(const basic_sparse_polynomial& o)
+    {
+        std::vector<ValueType> bufferA, bufferB, product;
+        detail::multiply(_dense_view(bufferA), o._dense_view(bufferB), product);
+        terms.clear();
+        coefficients.swap(product);
+        _nTerms = coefficients.size() - std::count(coefficients.begin(), coefficients.end(), (ValueType)0);
+        _bDense = true;
+    }
+
+    // Long division over the terms: *this becomes the quotient, r the
+    // remainder.
+    void _divide(const basic_sparse_polynomial& d, basic_sparse_polynomial& r)
+    {
+        if (d.size() == 0)
+            throw std::invalid_argument("polynomial division by zero");
+        // A copy, d may be *this.
+        std::vector<term> rest = d.term_vector();
+        const term lead = rest.back();
+        rest.pop_back();
+        const ValueType inv = ValueType(1) / lead.second;
+
+        _to_sparse();
+        r._clear();
+        r.terms.swap(terms);
+        std::vector<term> q;
+        while (!r.terms.empty() && r.terms.back().first >= lead.first)
+        {
+            const term top = r.terms.back();
+            const ValueType c = top.second * inv;
+            q.push_back(term(top.first - lead.first, c));
+            // The leading term cancels by construction, exactly.
+            r.terms.pop_back();
+            r._merge(rest, -c, top.first - lead.first);
+        }
+        std::reverse(q.begin(), q.end());
+        terms.swap(q);
+        _normalize();
+        r._normalize();
+    }
+
+};
+
+template<typename ValueType>
+basic_sparse_polynomial<ValueType> operator+(
+    basic_sparse_polynomial<ValueType> a,
+    const basic_sparse_polynomial<ValueType>& b
+)
+{
+    a += b;
+    return a;
+}
+
+template<typename ValueType>
+basic_sparse_polynomial<ValueType> operator-(
+    basic_sparse_polynomial<ValueType> a,
+    const basic_sparse_polynomial<ValueType>& b
+)
+{
+    a -= b;
+    return a;
+}
+
+template<typename ValueType>
+basic_sparse_polynomial<ValueType> operator*(
+    basic_sparse_polynomial<ValueType> a,
+    const basic_sparse_polynomial<ValueType>& b
+)
+{
+    a *= b;
+    return a;
+}
+
+template<typename ValueType>
+basic_sparse_polynomial<ValueType> operator*(
+    basic_sparse_polynomial<ValueType> a,
+    const ValueType b
+)
+{
+    a *= b;
+    return a;
+}
+
+template<typename ValueType>
+basic_sparse_polynomial<ValueType> operator/(
+    basic_sparse_polynomial<ValueType> m,
+    const ValueType d
+)
+{
+    m /= d;
+    return m;
+}
+
+template<typename ValueType>
+basic_sparse_polynomial<ValueType> operator/(
+    basic_sparse_polynomial<ValueType> a,
+    const basic_sparse_polynomial<ValueType>& b
+)
+{
+    a /= b;
+    return a;
+}
+
+template<typename ValueType>
+basic_sparse_polynomial<ValueType> operator%(
+    basic_sparse_polynomial<ValueType> a,
+    const basic_sparse_polynomial<ValueType>& b
+)
+{
+    a %= b;
+    return a;
+}
+
+template<typename ValueType>
+basic_sparse_polynomial<ValueType> operator^(
+    const basic_sparse_polynomial<ValueType>& _p,
+    const int _e
+)
+{
+    if (_e < 0)
+        throw std::invalid_argument("exponent can only be non-negative");
+
+    basic_sparse_polynomial<ValueType> r(1), p = _p;
+    for (int e = _e; e; e >>= 1)
+    {
+        if (e & 1) r *= p;
+        if (e > 1) p *= p;
+    }
+    return r;
+}
+
+typedef basic_sparse_polynomial<double> sparse_polynomial;
+
+
+} // math
+} // donny
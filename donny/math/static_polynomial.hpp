@@ -0,0 +1,303 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * static_polynomial.hpp - a polynomial with a degree fixed at compile time,
+ *                         stored in a std::array and usable in constexpr.
+ * dependency: format_string, polynomial
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <donny/format_string.hpp>
+
+#include "polynomial.hpp"
+
+namespace donny {
+namespace math {
+namespace detail {
+
+
+template<std::size_t... I>
+struct index_list {};
+
+template<std::size_t N, std::size_t... I>
+struct make_index_list : make_index_list<N - 1, N - 1, I...> {};
+
+template<std::size_t... I>
+struct make_index_list<0, I...>
+{
+    typedef index_list<I...> type;
+};
+
+constexpr std::size_t max_size(std::size_t a, std::size_t b)
+{
+    return (a < b) ? b : a;
+}
+
+// acc x + c, one instruction for floating point when FMA is enabled
+// (-mfma, -march=haswell...).
+inline float fma_step(float acc, float x, float c) { return std::fma(acc, x, c); }
+inline double fma_step(double acc, double x, double c) { return std::fma(acc, x, c); }
+inline long double fma_step(long double acc, long double x, long double c) { return std::fma(acc, x, c); }
+template<typename T>
+T fma_step(const T& acc, const T& x, const T& c) { return acc * x + c; }
+
+
+} // detail
+
+
+/**
+ *  c[0] + c[1] x + ... + c[N-1] x^(N-1), N known at compile time: the cubic
+ *  of an easing curve is static_polynomial<double, 4>.
+ *
+ *  No allocation, and every operation is constexpr but eval_fma() and the
+ *  conversions to and from basic_polynomial. Evaluation is Horner unrolled
+ *  at compile time. Results of + - * have their size computed from the
+ *  operands' sizes; coefficients may be zero, size() is not the degree.
+ */
+template<typename T, std::size_t N>
+class static_polynomial
+{
+    static_assert(N > 0, "static_polynomial needs at least one coefficient");
+
+public:
+    typedef T ValueType;
+
+    constexpr static_polynomial() : coefficients() {}
+
+    // c0 + c1 x + ..., the coefficients not given are zero.
+    template<typename... Cs>
+    constexpr explicit static_polynomial(T c0, Cs... cs)
+        : coefficients{{ c0, T(cs)... }}
+    {
+        static_assert(sizeof...(Cs) < N, "too many coefficients for static_polynomial");
+    }
+
+    constexpr explicit static_polynomial(const std::array<T, N>& coefficients_)
+        : coefficients(coefficients_)
+    {
+    }
+
+    /**
+     *  The coefficients of p, which must fit in N.
+     *  Throws std::invalid_argument otherwise.
+     */
+    static static_polynomial from_polynomial(const basic_polynomial<T>& p)
+    {
+        if (p.degree() >= (int)N)
+            throw std::invalid_argument("static_polynomial: degree is too high");
+        static_polynomial s;
+        for (std::size_t ind = 0; ind < N; ++ind)
+            s.coefficients[ind] = p.get((int)ind);
+        return s;
+    }
+    basic_polynomial<T> to_polynomial() const
+    {
+        basic_polynomial<T> p(typename basic_polynomial<T>::coefficient_storage(
+            coefficients.begin(), coefficients.end()));
+        p.shrink();
+        return p;
+    }
+
+    static constexpr std::size_t size() { return N; }
+    constexpr const std::array<T, N>& coefficient_array() const { return coefficients; }
+
+    constexpr T get(std::size_t exponent) const
+    {
+        return (exponent < N) ? coefficients[exponent] : T(0);
+    }
+
+    constexpr T eval(T x) const
+    {
+        return _horner(x, coefficients[N - 1], std::integral_constant<std::size_t, N - 1>());
+    }
+    // eval with a fused multiply-add per coefficient.
+    T eval_fma(T x) const
+    {
+        return _horner_fma(x, coefficients[N - 1], std::integral_constant<std::size_t, N - 1>());
+    }
+
+    constexpr static_polynomial<T, (N > 1) ? N - 1 : 1> derivative() const
+    {
+        return _derivative(typename detail::make_index_list<(N > 1) ? N - 1 : 1>::type());
+    }
+
+    std::string str(std::string variable = "x") const
+    {
+        format_string fs;
+        bool bFirst = true;
+
+        for (std::size_t ind = 0; ind < N; ++ind)
+            detail::append_term(fs, coefficients[ind], (int)ind, variable, bFirst);
+
+        std::string s = fs.str();
+        return s.empty() ? "0" : s;
+    }
+
+private:
+    std::array<T, N> coefficients;
+
+    template<std::size_t I>
+    constexpr T _horner(T x, T acc, std::integral_constant<std::size_t, I>) const
+    {
+        return _horner(x, acc * x + coefficients[I - 1], std::integral_constant<std::size_t, I - 1>());
+    }
+    constexpr T _horner(T, T acc, std::integral_constant<std::size_t, 0>) const
+    {
+        return acc;
+    }
+
+    template<std::size_t I>
+    T _horner_fma(T x, T acc, std::integral_constant<std::size_t, I>) const
+    {
+        return _horner_fma(x, detail::fma_step(acc, x, coefficients[I - 1]),
+                           std::integral_constant<std::size_t, I - 1>());
+    }
+    T _horner_fma(T, T acc, std::integral_constant<std::size_t, 0>) const
+    {
+        return acc;
+    }
+
+    template<std::size_t... I>
+    constexpr static_polynomial<T, sizeof...(I)> _derivative(detail::index_list<I...>) const
+    {
+        return static_polynomial<T, sizeof...(I)>(
+            std::array<T, sizeof...(I)>{{ get(I + 1) * T(I + 1)... }});
+    }
+
+};
+
+namespace detail {
+
+
+template<typename T, std::size_t N, std::size_t M, std::size_t... I>
+constexpr static_polynomial<T, sizeof...(I)> static_add(
+    const static_polynomial<T, N>& a, const static_polynomial<T, M>& b, index_list<I...>)
+{
+    return static_polynomial<T, sizeof...(I)>(std::array<T, sizeof...(I)>{{ (a.get(I) + b.get(I))... }});
+}
+
+template<typename T, std::size_t N, std::size_t M, std::size_t... I>
+constexpr static_polynomial<T, sizeof...(I)> static_sub(
+    const static_polynomial<T, N>& a, const static_polynomial<T, M>& b, index_list<I...>)
+{
+    return static_polynomial<T, sizeof...(I)>(std::array<T, sizeof...(I)>{{ (a.get(I) - b.get(I))... }});
+}
+
+template<typename T, std::size_t N, std::size_t... I>
+constexpr static_polynomial<T, N> static_scale(
+    const static_polynomial<T, N>& a, const T& v, index_list<I...>)
+{
+    return static_polynomial<T, N>(std::array<T, N>{{ (a.get(I) * v)... }});
+}
+
+// sum of a[i] b[k-i] for i from ind to k
+template<typename T, std::size_t N, std::size_t M>
+constexpr T static_product_at(
+    const static_polynomial<T, N>& a, const static_polynomial<T, M>& b,
+    std::size_t k, std::size_t ind)
+{
+    return (ind > k || ind >= N) ? T(0)
+        : a.get(ind) * b.get(k - ind) + static_product_at(a, b, k, ind + 1);
+}
+
+template<typename T, std::size_t N, std::size_t M, std::size_t... I>
+constexpr static_polynomial<T, sizeof...(I)> static_multiply(
+    const static_polynomial<T, N>& a, const static_polynomial<T, M>& b, index_list<I...>)
+{
+    return static_polynomial<T, sizeof...(I)>(std::array<T, sizeof...(I)>{{
+        static_product_at(a, b, I, (I < M) ? 0 : I - M + 1)... }});
+}
+
+template<typename T, std::size_t N, std::size_t M>
+constexpr bool static_equal(
+    const static_polynomial<T, N>& a, const static_polynomial<T, M>& b, std::size_t ind)
+{
+    return ind >= max_size(N, M) ||
+        (a.get(ind) == b.get(ind) && static_equal(a, b, ind + 1));
+}
+
+
+} // detail
+
+template<typename T, std::size_t N, std::size_t M>
+constexpr static_polynomial<T, detail::max_size(N, M)> operator+(
+    const static_polynomial<T, N>& a,
+    const static_polynomial<T, M>& b
+)
+{
+    return detail::static_add(a, b, typename detail::make_index_list<detail::max_size(N, M)>::type());
+}
+
+template<typename T, std::size_t N, std::size_t M>
+constexpr static_polynomial<T, detail::max_size(N, M)> operator-(
+    const static_polynomial<T, N>& a,
+    const static_polynomial<T, M>& b
+)
+{
+    return detail::static_sub(a, b, typename detail::make_index_list<detail::max_size(N, M)>::type());
+}
+
+template<typename T, std::size_t N>
+constexpr static_polynomial<T, N> operator-(const static_polynomial<T, N>& a)
+{
+    return detail::static_scale(a, T(-1), typename detail::make_index_list<N>::type());
+}
+
+template<typename T, std::size_t N, std::size_t M>
+constexpr static_polynomial<T, N + M - 1> operator*(
+    const static_polynomial<T, N>& a,
+    const static_polynomial<T, M>& b
+)
+{
+    return detail::static_multiply(a, b, typename detail::make_index_list<N + M - 1>::type());
+}
+
+template<typename T, std::size_t N>
+constexpr static_polynomial<T, N> operator*(
+    const static_polynomial<T, N>& a,
+    const T v
+)
+{
+    return detail::static_scale(a, v, typename detail::make_index_list<N>::type());
+}
+
+template<typename T, std::size_t N>
+constexpr static_polynomial<T, N> operator*(
+    const T v,
+    const static_polynomial<T, N>& a
+)
+{
+    return a * v;
+}
+
+// Equal coefficients, the missing ones of the shorter being zero.
+template<typename T, std::size_t N, std::size_t M>
+constexpr bool operator==(
+    const static_polynomial<T, N>& a,
+    const static_polynomial<T, M>& b
+)
+{
+    return detail::static_equal(a, b, 0);
+}
+
+template<typename T, std::size_t N, std::size_t M>
+constexpr bool operator!=(
+    const static_polynomial<T, N>& a,
+    const static_polynomial<T, M>& b
+)
+{
+    return !(a == b);
+}
+
+
+} // math
+} // donny
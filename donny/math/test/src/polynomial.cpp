@@ -5,6 +5,11 @@
 
 #include <donny/logger.hpp>
 #include <donny/math/polynomial.hpp>
+#include <donny/math/mod_int.hpp>
+#include <donny/math/multipoint.hpp>
+
+#include <cmath>
+#include <random>
 
 using namespace donny;
 using namespace donny::math;
@@ -32,6 +37,61 @@ BOOST_AUTO_TEST_CASE( test_parse )
     p = polynomial::parse(sPolynomial, 'x');
     logstdout << "Parse result of " << sPolynomial << endl << p.str() << endl;
     BOOST_CHECK(sResult == p.str());
+
+    // Numbers are correctly rounded.
+    BOOST_CHECK(polynomial::parse("1.34", 'x').get(0) == 1.34);
+    BOOST_CHECK(polynomial::parse("0.1x + .7", 'x') == polynomial(0.7).add(0.1, 1));
+    BOOST_CHECK(polynomial::parse("123456789012345678901234", 'x').get(0) == 123456789012345678901234.0);
+
+    // A sign belongs to its operand before ^, which is left associative.
+    BOOST_CHECK(polynomial::parse("-x^2", 'x') == polynomial(1, 2));
+    BOOST_CHECK(polynomial::parse("-2^2", 'x') == polynomial(4));
+    BOOST_CHECK(polynomial::parse("2*-x^3", 'x') == polynomial(-2, 3));
+    BOOST_CHECK(polynomial::parse("-(x+1)^2", 'x') == polynomial::parse("(x+1)^2", 'x'));
+    BOOST_CHECK(polynomial::parse("2^3^2", 'x') == polynomial(64));
+    BOOST_CHECK(polynomial::parse("x^2^3", 'x') == polynomial(1, 6));
+    BOOST_CHECK(polynomial::parse("2^3x + 7/2/2x", 'x') == polynomial(9.75, 1));
+
+    // A part of a larger buffer.
+    const char* sLine = "x^2 - 1; 2x";
+    BOOST_CHECK(polynomial::parse(sLine, 7, 'x') == polynomial::parse("(x-1)(x+1)", 'x'));
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_errors )
+{
+    auto message = [](const std::string& s) -> std::string {
+        try
+        {
+            polynomial::parse(s, 'x');
+        }
+        catch (const std::invalid_argument& e)
+        {
+            return e.what();
+        }
+        return "";
+    };
+
+    BOOST_CHECK(message("x + --1") == "unexpected symbol: '-' at position 5 .");
+    BOOST_CHECK(message("1..2") == "unexpected symbol: '.' at position 2 .");
+    BOOST_CHECK(message("2x + ") == "expect an operand: '+' at position 3 .");
+    BOOST_CHECK(message("(x+)") == "expect an operand: '+' at position 2 .");
+    BOOST_CHECK(message("x 2") == "expect an operator: '2' at position 2 .");
+    BOOST_CHECK(message("(x))") == "expect an operator: ')' at position 3 .");
+    BOOST_CHECK(message("2((x+1)") == "parentheses not closed: '(' at position 1 .");
+    BOOST_CHECK(message("x*( )") == "empty parentheses not allowed: '(' at position 2 .");
+    BOOST_CHECK(message("x + y") == "unrecognized symbol: 'y' at position 4 .");
+    BOOST_CHECK(message("2^(x+1)") == "polynomial can't have variables in the exponent: '(' at position 2 .");
+    BOOST_CHECK(message("1/x") == "polynomial with variables in denominator is not supported: 'x' at position 2 .");
+    // Syntax errors come first, then those of ^, then those of /, a group
+    // reporting its own errors as soon as it is closed.
+    BOOST_CHECK(message("7^-1 - y") == "unrecognized symbol: 'y' at position 7 .");
+    BOOST_CHECK(message("x^-2 +") == "expect an operand: '+' at position 5 .");
+    BOOST_CHECK(message("1/x + x^-1") == "exponent can only be non-negative");
+    BOOST_CHECK(message("1/x + 2^x") == "polynomial can't have variables in the exponent: 'x' at position 8 .");
+    BOOST_CHECK(message("(1/x) + x^-1") == "polynomial with variables in denominator is not supported: 'x' at position 3 .");
+    BOOST_CHECK(message("") == "parsing empty string");
+    BOOST_CHECK(message("  ") == "parsing empty string");
+    BOOST_CHECK_THROW(polynomial::parse("x", '1'), std::invalid_argument);
 }
 
 BOOST_AUTO_TEST_CASE( test_subsitute )
@@ -44,3 +104,413 @@ BOOST_AUTO_TEST_CASE( test_subsitute )
     logstdout << "Subsitute with \"t+1\": " << res.str("t") << endl;
 
 }
+
+BOOST_AUTO_TEST_CASE( test_compound_operators )
+{
+    polynomial a = polynomial::parse("1 + 2x + 3x^2", 'x');
+    polynomial b = polynomial::parse("4 - x", 'x');
+
+    polynomial c = a;
+    c += b;
+    BOOST_CHECK(c == polynomial::parse("5 + x + 3x^2", 'x'));
+    c -= b;
+    BOOST_CHECK(c == a);
+    c *= b;
+    BOOST_CHECK(c == a * b);
+    BOOST_CHECK(c.str() == "4+7x+10x^2-3x^3");
+    c *= 2.0;
+    c /= 4.0;
+    BOOST_CHECK(c == (a * b) / 2.0);
+
+    // aliasing
+    c = a;
+    c += c;
+    BOOST_CHECK(c == a * 2.0);
+    c = b;
+    c *= c;
+    BOOST_CHECK(c.str() == "16-8x+x^2");
+
+    // temporaries are reused
+    BOOST_CHECK((a + b) + a == a * 2.0 + b);
+    BOOST_CHECK(a - (b + a) == -b);
+    BOOST_CHECK((a * b) * b == a * (b ^ 2));
+
+    // a - b is a minus b whichever operand is longer or a temporary
+    BOOST_CHECK((a - b).str() == "-3+3x+3x^2");
+    BOOST_CHECK((b - a).str() == "3-3x-3x^2");
+    BOOST_CHECK((polynomial(a) - b).str() == "-3+3x+3x^2");
+    BOOST_CHECK((a - polynomial(b)).str() == "-3+3x+3x^2");
+    BOOST_CHECK((polynomial(b) - polynomial(a)).str() == "3-3x-3x^2");
+    BOOST_CHECK((b - polynomial(a)).str() == "3-3x-3x^2");
+
+    BOOST_CHECK((b ^ 4).str() == "256-256x+96x^2-16x^3+x^4");
+    BOOST_CHECK((b ^ 5) == (b ^ 4) * b);
+    BOOST_CHECK((b ^ 1) == b);
+    BOOST_CHECK((b ^ 0) == polynomial(1));
+
+    polynomial big;
+    big.reserve(99);
+    for (int ind = 0; ind < 100; ++ind)
+        big.add_to(1, ind);
+    BOOST_CHECK(big.size() == 100);
+    BOOST_CHECK(polynomial().add(1, 0).add(2, 3).str() == "1+2x^3");
+}
+
+template<typename T>
+basic_polynomial<T> random_polynomial(int n, std::mt19937& gen)
+{
+    std::uniform_int_distribution<int> dist(-1000, 1000);
+    basic_polynomial<T> p;
+    p.reserve(n - 1);
+    for (int ind = 0; ind < n; ++ind)
+        p.add_to(T(dist(gen)), ind);
+    return p;
+}
+
+template<typename T>
+basic_polynomial<T> naive_product(const basic_polynomial<T>& a, const basic_polynomial<T>& b)
+{
+    basic_polynomial<T> p;
+    for (int ia = 0; ia < (int)a.size(); ++ia)
+        for (int ib = 0; ib < (int)b.size(); ++ib)
+            p.add_to(a.get(ia) * b.get(ib), ia + ib);
+    return p;
+}
+
+BOOST_AUTO_TEST_CASE( test_fast_multiply )
+{
+    std::mt19937 gen(42);
+    const int sizes[][2] = { {5, 7}, {40, 40}, {100, 37}, {300, 300}, {1000, 250}, {700, 2000} };
+    for (auto& sz : sizes)
+    {
+        // Karatsuba for integers
+        auto ia = random_polynomial<long long>(sz[0], gen);
+        auto ib = random_polynomial<long long>(sz[1], gen);
+        BOOST_CHECK(ia * ib == naive_product(ia, ib));
+
+        // NTT for mod_int
+        auto ma = random_polynomial<mod998244353>(sz[0], gen);
+        auto mb = random_polynomial<mod998244353>(sz[1], gen);
+        BOOST_CHECK(ma * mb == naive_product(ma, mb));
+
+        // FFT for double, integer inputs come back within rounding
+        auto da = random_polynomial<double>(sz[0], gen);
+        auto db = random_polynomial<double>(sz[1], gen);
+        auto dp = da * db, dn = naive_product(da, db);
+        BOOST_CHECK(dp.size() == dn.size());
+        double maxError = 0;
+        for (int ind = 0; ind < (int)dn.size(); ++ind)
+            maxError = std::max(maxError, std::fabs(dp.get(ind) - dn.get(ind)));
+        BOOST_CHECK(maxError < 1e-6);
+    }
+
+    // Operands of very different magnitudes keep their precision.
+    auto big = random_polynomial<double>(500, gen) * 1e12;
+    auto small = random_polynomial<double>(500, gen) * 1e-12;
+    auto dp = big * small, dn = naive_product(big, small);
+    double maxError = 0;
+    for (int ind = 0; ind < (int)dn.size(); ++ind)
+        maxError = std::max(maxError, std::fabs(dp.get(ind) - dn.get(ind)));
+    BOOST_CHECK(maxError < 1e-6);
+
+    // (1+x)^n through repeated squaring, against Pascal's triangle.
+    const int n = 3000;
+    basic_polynomial<mod998244353> onePlusX = basic_polynomial<mod998244353>(1).add(1, 1);
+    auto power = onePlusX ^ n;
+    std::vector<mod998244353> row(1, 1);
+    for (int k = 1; k <= n; ++k)
+    {
+        row.push_back(0);
+        for (int ind = k; ind > 0; --ind)
+            row[ind] += row[ind - 1];
+    }
+    bool bSame = (power.size() == row.size());
+    for (int ind = 0; bSame && ind <= n; ++ind)
+        bSame = (power.get(ind) == row[ind]);
+    BOOST_CHECK(bSame);
+}
+
+BOOST_AUTO_TEST_CASE( test_batch_eval )
+{
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    for (int n : { 0, 1, 3, 12, 40, 100 })
+    {
+        polynomial p;
+        for (int ind = 0; ind < n; ++ind)
+            p.add_to(dist(gen), ind);
+
+        const std::size_t count = 1000 + n; // leaves a partial SIMD block
+        std::vector<double> xs(count), out(count), outParallel(count);
+        for (double& x : xs) x = dist(gen);
+
+        p.eval(vector_view<const double>(xs.data(), count), vector_view<double>(out.data(), count));
+        p.eval_parallel(vector_view<const double>(xs.data(), count),
+                        vector_view<double>(outParallel.data(), count), 4);
+
+        double maxError = 0;
+        for (std::size_t ind = 0; ind < count; ++ind)
+        {
+            // plain power sum as reference
+            double ref = 0, powx = 1;
+            for (int k = 0; k < n; ++k, powx *= xs[ind])
+                ref += p.get(k) * powx;
+            maxError = std::max(maxError, std::fabs(out[ind] - ref));
+            maxError = std::max(maxError, std::fabs(p.eval(xs[ind]) - ref));
+        }
+        BOOST_CHECK(maxError < 1e-12);
+        BOOST_CHECK(out == outParallel);
+    }
+
+    // Enough points for several threads, count / 3 is a multiple of 64
+    // with 2 points left over.
+    {
+        polynomial p = polynomial::parse("1 + 2x - x^3", 'x');
+        const std::size_t count = 3 * (1 << 16) + 2;
+        std::vector<double> xs(count), out(count, -1.0), outParallel(count, -1.0);
+        for (double& x : xs) x = dist(gen);
+
+        p.eval(vector_view<const double>(xs.data(), count), vector_view<double>(out.data(), count));
+        p.eval_parallel(vector_view<const double>(xs.data(), count),
+                        vector_view<double>(outParallel.data(), count), 3);
+        BOOST_CHECK(out == outParallel);
+        BOOST_CHECK(std::fabs(outParallel[count - 1] - p.eval(xs[count - 1])) < 1e-12);
+    }
+
+    // Types without SIMD kernels
+    basic_polynomial<long long> q = basic_polynomial<long long>(1).add(2, 1).add(3, 2);
+    long long xs[] = { 0, 1, 2, -3 };
+    long long out[4];
+    q.eval(vector_view<const long long>(xs, 4), vector_view<long long>(out, 4));
+    BOOST_CHECK(out[0] == 1 && out[1] == 6 && out[2] == 17 && out[3] == 22);
+
+    std::vector<double> small(2);
+    BOOST_CHECK_THROW(
+        polynomial(1).eval(vector_view<const double>(small.data(), 2), vector_view<double>(small.data(), 1)),
+        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( test_multipoint )
+{
+    typedef mod998244353 M;
+    std::mt19937 gen(3);
+
+    // Exact with mod_int, across the Horner leaves and the division methods.
+    for (int n : { 1, 2, 33, 100, 700 })
+    {
+        std::vector<M> xs(n), ys(n);
+        for (int ind = 0; ind < n; ++ind)
+        {
+            xs[ind] = M((long long)gen());
+            ys[ind] = M((long long)gen());
+        }
+        basic_polynomial<M> p = interpolate(xs, ys);
+        BOOST_CHECK(p.size() <= (std::size_t)n);
+        BOOST_CHECK(multipoint_eval(p, xs) == ys);
+
+        bool bSame = true;
+        for (int ind = 0; ind < n; ind += 97)
+            bSame = bSame && (p.eval(xs[ind]) == ys[ind]);
+        BOOST_CHECK(bSame);
+    }
+
+    // A polynomial of higher degree than the number of points, the first
+    // remainder takes a Newton division.
+    auto q = random_polynomial<M>(2000, gen);
+    std::vector<M> xs(700);
+    for (M& x : xs) x = M((long long)gen());
+    std::vector<M> values = multipoint_eval(q, xs);
+    bool bSame = true;
+    for (std::size_t ind = 0; ind < xs.size(); ++ind)
+        bSame = bSame && (values[ind] == q.eval(xs[ind]));
+    BOOST_CHECK(bSame);
+
+    // double, points spread over [-1, 1]. The monomial basis itself is ill
+    // conditioned, so only a few points are meaningful in floating point.
+    const int n = 12;
+    std::vector<double> dx(n), dy(n);
+    for (int ind = 0; ind < n; ++ind)
+    {
+        dx[ind] = std::cos(3.14159265358979 * (ind + 0.5) / n);
+        dy[ind] = std::exp(dx[ind]);
+    }
+    polynomial p = interpolate(dx, dy);
+    std::vector<double> back = multipoint_eval(p, dx);
+    double maxError = 0;
+    for (int ind = 0; ind < n; ++ind)
+        maxError = std::max(maxError, std::fabs(back[ind] - dy[ind]));
+    BOOST_CHECK(maxError < 1e-9);
+    BOOST_CHECK(std::fabs(p.eval(0.3) - std::exp(0.3)) < 1e-9);
+
+    std::vector<double> dup = { 1, 2, 1 };
+    BOOST_CHECK_THROW(interpolate(dup, dup), std::invalid_argument);
+    BOOST_CHECK_THROW(interpolate(dup, std::vector<double>(2)), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( test_divmod_gcd )
+{
+    typedef mod998244353 M;
+    typedef basic_polynomial<M> mpolynomial;
+    std::mt19937 gen(5);
+
+    // a = q b + r with deg r < deg b, long division and Newton division.
+    const int sizes[][2] = { {10, 3}, {3, 10}, {200, 50}, {3000, 1000} };
+    for (auto& sz : sizes)
+    {
+        auto a = random_polynomial<M>(sz[0], gen);
+        auto b = random_polynomial<M>(sz[1], gen);
+        auto qr = divmod(a, b);
+        BOOST_CHECK(qr.second.size() < b.size());
+        BOOST_CHECK(qr.first * b + qr.second == a);
+        BOOST_CHECK(a / b == qr.first);
+        BOOST_CHECK(a % b == qr.second);
+    }
+
+    auto da = random_polynomial<double>(60, gen);
+    auto db = random_polynomial<double>(20, gen);
+    polynomial dq = da / db, dr = da % db;
+    polynomial back = dq * db + dr;
+    double maxError = 0;
+    for (int ind = 0; ind < (int)da.size(); ++ind)
+        maxError = std::max(maxError, std::fabs(back.get(ind) - da.get(ind)));
+    BOOST_CHECK(dr.size() < db.size());
+    BOOST_CHECK(maxError < 1e-6);
+
+    // gcd of products with a common factor is that factor, made monic.
+    auto common = random_polynomial<M>(30, gen);
+    auto ma = common * random_polynomial<M>(40, gen);
+    auto mb = common * random_polynomial<M>(25, gen);
+    auto g = gcd(ma, mb);
+    const M lead = common.get((int)common.size() - 1);
+    BOOST_CHECK(g == common / mpolynomial(lead));
+    mpolynomial s, t;
+    BOOST_CHECK(extended_gcd(ma, mb, s, t) == g);
+    BOOST_CHECK(s * ma + t * mb == g);
+    BOOST_CHECK(gcd(mpolynomial(), mpolynomial()) == mpolynomial());
+
+    polynomial pa = polynomial::parse("(x-1)(x+2)(x-3)", 'x');
+    polynomial pb = polynomial::parse("(x-1)(x-3)(2x+5)", 'x');
+    polynomial pg = gcd(pa, pb), expected = polynomial::parse("(x-1)(x-3)", 'x');
+    BOOST_CHECK(pg.size() == expected.size());
+    for (int ind = 0; ind < (int)expected.size(); ++ind)
+        BOOST_CHECK(std::fabs(pg.get(ind) - expected.get(ind)) < 1e-9);
+    BOOST_CHECK(gcd(pa, polynomial::parse("x+7", 'x')) == polynomial(1));
+
+    BOOST_CHECK_THROW(pa / polynomial(), std::invalid_argument);
+    BOOST_CHECK_THROW(pa % polynomial(0), std::invalid_argument);
+
+    // The parser divides exactly, and still rejects rational functions.
+    BOOST_CHECK(polynomial::parse("(x^2-1)/(x-1)", 'x') == polynomial::parse("x+1", 'x'));
+    BOOST_CHECK_THROW(polynomial::parse("x/(x+1)", 'x'), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( test_expression_templates )
+{
+    typedef mod998244353 M;
+    typedef basic_polynomial<M> mpolynomial;
+    std::mt19937 gen(11);
+
+    // Against the compound operators, small and through the NTT.
+    for (int n : { 3, 300 })
+    {
+        auto a = random_polynomial<M>(n, gen), b = random_polynomial<M>(n + 1, gen);
+        auto c = random_polynomial<M>(n / 2 + 1, gen), d = random_polynomial<M>(2 * n, gen);
+        auto e = random_polynomial<M>(4 * n, gen);
+
+        mpolynomial expected = a, cd = c;
+        expected *= b;
+        cd *= d;
+        expected += cd;
+        expected -= e;
+        mpolynomial r = a * b + c * d - e;
+        BOOST_CHECK(r == expected);
+        BOOST_CHECK(r.size() == std::max({ a.size() + b.size() - 1, c.size() + d.size() - 1, e.size() }));
+
+        // Scaled products and nested expressions
+        mpolynomial scaled = -(a * b) * M(3) + (c - e) * (d + a) * M(5);
+        mpolynomial ce = c, da = d;
+        ce -= e;
+        da += a;
+        ce *= da;
+        ce *= M(5);
+        mpolynomial ab = a;
+        ab *= b;
+        ab *= M(-3);
+        ab += ce;
+        BOOST_CHECK(scaled == ab);
+
+        // The destination is an operand.
+        mpolynomial alias = a;
+        alias = alias * b + alias;
+        mpolynomial ab1 = a;
+        ab1 *= b;
+        ab1 += a;
+        BOOST_CHECK(alias == ab1);
+        alias = a;
+        alias += alias * b;
+        BOOST_CHECK(alias == ab1);
+        alias -= a * b;
+        BOOST_CHECK(alias == a);
+    }
+
+    // An expression of lvalues references them.
+    polynomial x = polynomial::parse("x", 'x');
+    polynomial two = polynomial(2);
+    auto expr = x * 2.0 + two;
+    BOOST_CHECK((!std::is_same<decltype(expr), polynomial>::value));
+    BOOST_CHECK(expr == polynomial::parse("2x + 2", 'x'));
+    BOOST_CHECK(expr.eval(3) == 8);
+    BOOST_CHECK((expr ^ 2) == polynomial::parse("(2x+2)^2", 'x'));
+    two.add_to(1, 0);
+    BOOST_CHECK(expr == polynomial::parse("2x + 3", 'x'));
+    BOOST_CHECK((x * x - 1.0 * polynomial(1)) / (x - polynomial(1)) == polynomial::parse("x + 1", 'x'));
+
+    // Products, and + - * by a constant with a temporary, are polynomials,
+    // the temporary taking the result in place.
+    BOOST_CHECK((std::is_same<decltype(x * x), polynomial>::value));
+    BOOST_CHECK((std::is_same<decltype(polynomial(x) + x), polynomial>::value));
+    BOOST_CHECK((std::is_same<decltype(x - polynomial(x)), polynomial>::value));
+    BOOST_CHECK((std::is_same<decltype(polynomial(x) * 2.0), polynomial>::value));
+    polynomial t = polynomial::parse("1 + x^20", 'x');
+    const double* storage = t.coefficient_vector().data();
+    polynomial sum = std::move(t) + x * 2.0;
+    BOOST_CHECK(sum.coefficient_vector().data() == storage);
+    BOOST_CHECK(sum == polynomial::parse("1 + 2x + x^20", 'x'));
+    t = polynomial::parse("1 + x^20", 'x');
+    storage = t.coefficient_vector().data();
+    sum = x - std::move(t);
+    BOOST_CHECK(sum.coefficient_vector().data() == storage);
+    BOOST_CHECK(sum == polynomial::parse("-1 + x - x^20", 'x'));
+
+    // The algorithms take expressions and products.
+    {
+        auto a = random_polynomial<M>(20, gen), b = random_polynomial<M>(15, gen);
+        auto c = random_polynomial<M>(10, gen);
+        auto ac = a * c, bc = b * c;
+        const M lead = c.get((int)c.size() - 1);
+        BOOST_CHECK(gcd(ac, bc) == c / lead);
+        BOOST_CHECK(gcd(a * c, b * c) == c / lead);
+        BOOST_CHECK(gcd(ac + bc, bc) == c / lead);
+        mpolynomial s1, t1;
+        auto g = extended_gcd(ac - bc, bc, s1, t1);
+        BOOST_CHECK(g == c / lead);
+        BOOST_CHECK(s1 * (ac - bc) + t1 * bc == g);
+        BOOST_CHECK(divmod(ac + bc, c).first == a + b);
+        BOOST_CHECK(divmod(ac + bc, c).second == mpolynomial());
+        std::vector<M> xs = { M(1), M(2), M(3) };
+        std::vector<M> ys = multipoint_eval(a + b, xs);
+        BOOST_CHECK(ys[2] == a.eval(M(3)) + b.eval(M(3)));
+    }
+
+    // subsitute against the evaluation of p at s(x)
+    auto p = random_polynomial<M>(40, gen), s = random_polynomial<M>(7, gen);
+    mpolynomial ps = p.subsitute(s);
+    BOOST_CHECK(ps.degree() == p.degree() * s.degree());
+    bool bSame = true;
+    for (long long t = 0; t < 20; ++t)
+        bSame = bSame && (ps.eval(M(t)) == p.eval(s.eval(M(t))));
+    BOOST_CHECK(bSame);
+    BOOST_CHECK(p.subsitute(mpolynomial()) == mpolynomial(p.get(0)));
+    BOOST_CHECK(mpolynomial().subsitute(s) == mpolynomial());
+}
@@ -0,0 +1,129 @@
+#define BOOST_TEST_MODULE sparse_polynomial
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <donny/logger.hpp>
+#include <donny/math/sparse_polynomial.hpp>
+#include <donny/math/mod_int.hpp>
+
+#include <cmath>
+#include <random>
+
+using namespace donny;
+using namespace donny::math;
+
+BOOST_AUTO_TEST_CASE( test_parse_str )
+{
+    std::string sPolynomial = "-x + 1.34x^2 + 1/50 x^3 + 344(x+2)^2 + 2*-1";
+    sparse_polynomial p = sparse_polynomial::parse(sPolynomial, 'x');
+    logstdout << "Parse result of " << sPolynomial << endl << p.str() << endl;
+    BOOST_CHECK(p.str() == polynomial::parse(sPolynomial, 'x').str());
+
+    // One term, not a million coefficients.
+    p = sparse_polynomial::parse("3x^1000000 - x^2 + 1", 'x');
+    BOOST_CHECK(p.size() == 3);
+    BOOST_CHECK(p.degree() == 1000000);
+    BOOST_CHECK(p.str() == "1-x^2+3x^1000000");
+    BOOST_CHECK(p.eval(1) == 3);
+    BOOST_CHECK(std::fabs(p.eval(-1.000001) - (3 * std::pow(-1.000001, 1000000) - 1.000001 * 1.000001 + 1)) < 1e-6);
+
+    p = sparse_polynomial::parse("(x^1000000-1)/(x^1000-1)", 'x');
+    BOOST_CHECK(p.size() == 1000);
+    BOOST_CHECK(p.get(999000) == 1 && p.get(1) == 0);
+    BOOST_CHECK_THROW(sparse_polynomial::parse("x/(x+1)", 'x'), std::invalid_argument);
+    BOOST_CHECK_THROW(sparse_polynomial::parse("2^x", 'x'), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( test_arithmetic )
+{
+    typedef mod998244353 M;
+    typedef basic_sparse_polynomial<M> msparse;
+    std::mt19937 gen(9);
+
+    // Against the dense class, through both the heap and the dense product.
+    const int shapes[][2] = { {5, 50}, {200, 100000}, {400, 1000}, {3000, 6000}, {300, 200} };
+    for (auto& shape : shapes)
+    {
+        msparse a, b;
+        for (int ind = 0; ind < shape[0]; ++ind)
+        {
+            a.add_to(M((long long)gen()), gen() % shape[1]);
+            b.add_to(M((long long)gen()), gen() % shape[1]);
+        }
+        basic_polynomial<M> da = a.to_dense(), db = b.to_dense();
+        BOOST_CHECK(msparse(da) == a);
+        BOOST_CHECK((a + b).to_dense() == da + db);
+        BOOST_CHECK((a - b).to_dense() == da - db);
+        BOOST_CHECK((a * b).to_dense() == da * db);
+        BOOST_CHECK((a * M(7)).to_dense() == da * M(7));
+        BOOST_CHECK(a.eval(M(12345)) == da.eval(M(12345)));
+
+        auto q = a / b, r = a % b;
+        BOOST_CHECK(r.degree() < b.degree());
+        BOOST_CHECK(q * b + r == a);
+    }
+
+    sparse_polynomial x(1, 1), one(1);
+    BOOST_CHECK(((x + one) ^ 3) == sparse_polynomial::parse("x^3+3x^2+3x+1", 'x'));
+    BOOST_CHECK((x - x).size() == 0);
+    BOOST_CHECK((x ^ 0) == one);
+    BOOST_CHECK(sparse_polynomial::parse("x^2", 'x').subsitute(x + one) ==
+                sparse_polynomial::parse("(x+1)^2", 'x'));
+    BOOST_CHECK_THROW(x / sparse_polynomial(), std::invalid_argument);
+
+    sparse_polynomial half = sparse_polynomial(0.5, 3);
+    BOOST_CHECK(half.fill_ratio() == 0.25);
+    BOOST_CHECK((half / 0.5).get(3) == 1);
+
+    // Terms scaled to 0 are dropped in either form.
+    sparse_polynomial tiny = sparse_polynomial(1e-300, 5000) + x;
+    tiny *= 1e-300;
+    BOOST_CHECK(tiny.size() == 1 && tiny.degree() == 1);
+    sparse_polynomial dense = sparse_polynomial::parse("x^2 + x", 'x') + sparse_polynomial(1e-300);
+    BOOST_CHECK(dense.is_dense());
+    dense /= 1e300;
+    BOOST_CHECK(dense.size() == 2 && dense.get(0) == 0);
+    BOOST_CHECK((-dense).size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE( test_dense_switch )
+{
+    // Dense from half full on, sparse below.
+    sparse_polynomial p = sparse_polynomial::parse("1 + x + x^3", 'x');
+    BOOST_CHECK(p.is_dense());
+    BOOST_CHECK(!sparse_polynomial(1, 2).is_dense());
+    BOOST_CHECK(sparse_polynomial(polynomial::parse("1 + x", 'x')).is_dense());
+
+    p.add_to(2, 1000000);
+    BOOST_CHECK(!p.is_dense());
+    BOOST_CHECK(p.size() == 4 && p.degree() == 1000000);
+    p -= sparse_polynomial(2, 1000000);
+    BOOST_CHECK(p.is_dense());
+    BOOST_CHECK(p == sparse_polynomial::parse("1 + x + x^3", 'x'));
+
+    // Built term by term, it turns dense and stays so.
+    sparse_polynomial q;
+    for (int ind = 0; ind < 1000; ++ind)
+        q.add_to(ind + 1, ind);
+    BOOST_CHECK(q.is_dense() && q.size() == 1000);
+    BOOST_CHECK(q.get(999) == 1000 && q.get(1000) == 0);
+    BOOST_CHECK(q.str() == q.to_dense().str());
+
+    // Dense and sparse operands mix, and results take the form they fit.
+    sparse_polynomial x(1, 1), far(1, 5000);
+    BOOST_CHECK(!(q * far).is_dense());
+    BOOST_CHECK((q * far).get(5999) == 1000);
+    BOOST_CHECK((q + far - far) == q);
+    BOOST_CHECK(((q * x) / x) == q);
+    BOOST_CHECK((q % x) == sparse_polynomial(1));
+    BOOST_CHECK((q - q).size() == 0 && !(q - q).is_dense());
+    BOOST_CHECK((q * q).is_dense());
+    BOOST_CHECK((q * q).to_dense() == q.to_dense() * q.to_dense());
+
+    // A cancelled top coefficient leaves no trailing zero.
+    sparse_polynomial r = sparse_polynomial::parse("1 + x + x^2", 'x');
+    r.add_to(-1, 2);
+    BOOST_CHECK(r.degree() == 1 && r == sparse_polynomial::parse("1 + x", 'x'));
+    r.add_to(-1, 0);
+    BOOST_CHECK(r.degree() == 1 && r.size() == 1 && r == x);
+}
@@ -0,0 +1,63 @@
+#define BOOST_TEST_MODULE static_polynomial
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <donny/logger.hpp>
+#include <donny/math/static_polynomial.hpp>
+
+#include <cmath>
+#include <type_traits>
+
+using namespace donny;
+using namespace donny::math;
+
+// 3t^2 - 2t^3, the smoothstep easing curve
+constexpr static_polynomial<double, 4> smoothstep(0, 0, 3, -2);
+
+static_assert(smoothstep.eval(0) == 0 && smoothstep.eval(1) == 1, "constexpr eval");
+static_assert(smoothstep.eval(0.5) == 0.5, "constexpr eval");
+static_assert(smoothstep.derivative().eval(1) == 0, "constexpr derivative");
+
+// Sizes are computed from the operands.
+constexpr static_polynomial<int, 2> xPlusOne(1, 1);
+constexpr static_polynomial<int, 3> xSquared(0, 0, 1);
+static_assert(std::is_same<decltype(xPlusOne * xSquared), static_polynomial<int, 4>>::value,
+              "product size");
+static_assert(xPlusOne * xPlusOne == static_polynomial<int, 3>(1, 2, 1), "constexpr product");
+static_assert(xPlusOne + xSquared == static_polynomial<int, 3>(1, 1, 1), "constexpr sum");
+static_assert(xSquared - xPlusOne == static_polynomial<int, 3>(-1, -1, 1), "constexpr difference");
+static_assert(-xPlusOne * 2 == static_polynomial<int, 2>(-2, -2), "constexpr scaling");
+static_assert(static_polynomial<int, 3>(1, 1) == xPlusOne, "zero padding");
+
+BOOST_AUTO_TEST_CASE( test_eval )
+{
+    polynomial p = smoothstep.to_polynomial();
+    logstdout << "smoothstep: " << smoothstep.str("t") << endl;
+    BOOST_CHECK(p.str("t") == smoothstep.str("t"));
+    for (double t = -1; t <= 2; t += 0.125)
+    {
+        BOOST_CHECK(std::fabs(smoothstep.eval(t) - p.eval(t)) < 1e-12);
+        BOOST_CHECK(std::fabs(smoothstep.eval_fma(t) - p.eval(t)) < 1e-12);
+    }
+
+    // A quintic spline piece, checked against the dense class.
+    const static_polynomial<double, 6> quintic(0.5, -1.25, 2, 0.75, -3, 1.5);
+    polynomial dq = quintic.to_polynomial();
+    BOOST_CHECK(std::fabs(quintic.eval(0.3) - dq.eval(0.3)) < 1e-12);
+    BOOST_CHECK((quintic * smoothstep).to_polynomial() == dq * p);
+    BOOST_CHECK((quintic - smoothstep).to_polynomial() == dq - p);
+}
+
+BOOST_AUTO_TEST_CASE( test_interop )
+{
+    typedef static_polynomial<double, 4> cubic;
+    typedef static_polynomial<double, 6> quintic;
+    typedef static_polynomial<double, 3> quadratic;
+    typedef static_polynomial<double, 1> constant;
+
+    polynomial p = polynomial::parse("1 - 2x + x^3", 'x');
+    BOOST_CHECK(cubic::from_polynomial(p) == cubic(1, -2, 0, 1));
+    BOOST_CHECK(quintic::from_polynomial(p).to_polynomial() == p);
+    BOOST_CHECK_THROW(quadratic::from_polynomial(p), std::invalid_argument);
+    BOOST_CHECK(constant(7).derivative().to_polynomial() == polynomial());
+}
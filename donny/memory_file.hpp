@@ -0,0 +1,245 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * memory_file.hpp - basic_file backed by memory, optionally spilling to disk
+ * dependency : file.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "file.hpp"
+
+namespace donny {
+namespace detail {
+
+// State behind a memory FILE*. Freed when the FILE* is closed.
+struct memory_cookie
+{
+    std::vector<char> data;
+    std::size_t pos = 0;
+    std::size_t threshold = (std::size_t)-1;
+    FILE* spill = nullptr; // once set, every operation goes there
+
+    bool spill_to_disk()
+    {
+        spill = tmpfile();
+        if (spill == nullptr) return false;
+        // The outer FILE* already buffers, don't do it twice.
+        setvbuf(spill, nullptr, _IONBF, 0);
+        if ((!data.empty() && fwrite(data.data(), 1, data.size(), spill) != data.size()) ||
+            fseeko(spill, (off_t)pos, SEEK_SET) != 0)
+        {
+            fclose(spill);
+            spill = nullptr;
+            return false;
+        }
+        std::vector<char>().swap(data);
+        return true;
+    }
+
+    std::size_t size() const
+    {
+        if (spill == nullptr) return data.size();
+        struct stat st;
+        if (fstat(fileno(spill), &st) != 0) return 0;
+        return (std::size_t)st.st_size;
+    }
+};
+
+#ifdef __GLIBC__
+
+inline ssize_t memory_read(void* cookie, char* buf, size_t n)
+{
+    memory_cookie* c = (memory_cookie*)cookie;
+    if (c->spill) return (ssize_t)fread(buf, 1, n, c->spill);
+    if (c->pos >= c->data.size()) return 0;
+    if (n > c->data.size() - c->pos) n = c->data.size() - c->pos;
+    memcpy(buf, c->data.data() + c->pos, n);
+    c->pos += n;
+    return (ssize_t)n;
+}
+
+inline ssize_t memory_write(void* cookie, const char* buf, size_t n)
+{
+    memory_cookie* c = (memory_cookie*)cookie;
+    if (c->spill == nullptr && c->pos + n > c->threshold && !c->spill_to_disk())
+        return -1;
+    if (c->spill)
+    {
+        size_t nWritten = fwrite(buf, 1, n, c->spill);
+        return nWritten ? (ssize_t)nWritten : -1;
+    }
+    if (c->pos + n > c->data.size())
+        c->data.resize(c->pos + n); // writing past the end zero-fills the gap
+    memcpy(c->data.data() + c->pos, buf, n);
+    c->pos += n;
+    return (ssize_t)n;
+}
+
+inline int memory_seek(void* cookie, off64_t* offset, int whence)
+{
+    memory_cookie* c = (memory_cookie*)cookie;
+    if (c->spill)
+    {
+        if (fseeko(c->spill, (off_t)*offset, whence) != 0) return -1;
+        *offset = (off64_t)ftello(c->spill);
+        return 0;
+    }
+    off64_t base = 0;
+    if (whence == SEEK_CUR) base = (off64_t)c->pos;
+    else if (whence == SEEK_END) base = (off64_t)c->data.size();
+    if (base + *offset < 0) return -1;
+    c->pos = (std::size_t)(base + *offset);
+    *offset = (off64_t)c->pos;
+    return 0;
+}
+
+inline int memory_close(void* cookie)
+{
+    memory_cookie* c = (memory_cookie*)cookie;
+    int ret = c->spill ? fclose(c->spill) : 0;
+    delete c;
+    return ret;
+}
+
+inline FILE* open_memory_cookie(memory_cookie* c)
+{
+    cookie_io_functions_t io;
+    io.read = memory_read;
+    io.write = memory_write;
+    io.seek = memory_seek;
+    io.close = memory_close;
+    FILE* f = fopencookie(c, "w+", io);
+    if (f == nullptr) delete c;
+    return f;
+}
+
+#endif
+
+}
+
+namespace filesystem {
+
+/**
+ *  A basic_file whose content lives in a growable memory buffer.
+ *  With a spill threshold, it's a spool: once the content grows past the
+ *  threshold it moves to an anonymous temporary file, transparently.
+ *
+ *  Copies share the same buffer, like copies of basic_file do. The buffer
+ *  is freed with the last copy.
+ *
+ *  Usage:
+ *      memory_file scratch;
+ *      scratch.print("%d\n", 42);
+ *      scratch.seek(0, file::begin);
+ *      std::string line = scratch.gets('\n');
+ *
+ *      memory_file spool(memory_file::spool(1 << 20)); // disk past 1MB
+ *
+ *  Without glibc (no fopencookie), every memory_file is a tmpfile().
+ */
+template<typename CharType>
+class basic_memory_file : public basic_file<CharType>
+{
+public:
+    using SizeType = std::size_t;
+
+    // Never spill.
+    explicit basic_memory_file(SizeType nReserve = 0)
+        : basic_memory_file((SizeType)-1, nReserve)
+    {
+    }
+
+    // Keep at most threshold bytes in memory.
+    static basic_memory_file spool(SizeType threshold)
+    {
+        return basic_memory_file(threshold, 0);
+    }
+
+    // Whether the content has moved to a temporary file.
+    bool spilled() const
+    {
+        return _cookie == nullptr || _cookie->spill != nullptr;
+    }
+
+    // Size of the content in bytes, pending writes included.
+    SizeType size()
+    {
+        if (!this->is_open()) return 0;
+        this->flush();
+        if (_cookie) return _cookie->size();
+        struct stat st;
+        if (fstat(fileno(this->getFILE()), &st) != 0) return 0;
+        return (SizeType)st.st_size;
+    }
+
+    // Copy of the raw bytes. The file position is left untouched.
+    std::string str()
+    {
+        std::string out;
+        if (!this->is_open()) return out;
+        this->flush();
+        if (_cookie && _cookie->spill == nullptr)
+            return std::string(_cookie->data.begin(), _cookie->data.end());
+
+        int fd = fileno(_cookie ? _cookie->spill : this->getFILE());
+        out.resize(size());
+        SizeType done = 0;
+        while (done < out.size())
+        {
+            ssize_t n = pread(fd, &out[done], out.size() - done, (off_t)done);
+            if (n <= 0) break;
+            done += (SizeType)n;
+        }
+        out.resize(done);
+        return out;
+    }
+
+private:
+    detail::memory_cookie* _cookie;
+
+    typedef std::pair<detail::memory_cookie*, FILE*> Opened;
+
+    basic_memory_file(SizeType threshold, SizeType nReserve)
+        : basic_memory_file(_open(threshold, nReserve))
+    {
+    }
+    explicit basic_memory_file(Opened opened)
+        : basic_file<CharType>(opened.second, true)
+        , _cookie(opened.first)
+    {
+    }
+
+    static Opened _open(SizeType threshold, SizeType nReserve)
+    {
+#ifdef __GLIBC__
+        detail::memory_cookie* c = new detail::memory_cookie;
+        c->threshold = threshold;
+        c->data.reserve(nReserve < threshold ? nReserve : threshold);
+        FILE* f = detail::open_memory_cookie(c); // frees c on failure
+        return Opened(f ? c : nullptr, f);
+#else
+        (void)threshold; (void)nReserve;
+        return Opened(nullptr, tmpfile());
+#endif
+    }
+
+};
+
+typedef basic_memory_file<char> memory_file;
+typedef basic_memory_file<wchar_t> wmemory_file;
+
+}
+}
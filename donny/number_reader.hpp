@@ -0,0 +1,505 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * number_reader.hpp - fast locale independent text to number parsing
+ * dependency : base.hpp, file.hpp, mapped_file.hpp, vector_view.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <clocale>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
+
+#include "file.hpp"
+#include "mapped_file.hpp"
+#include "vector_view.hpp"
+
+namespace donny {
+
+inline bool is_space_char(char c)
+{
+    return c == ' ' || (unsigned char)(c - '\t') <= (unsigned char)('\r' - '\t');
+}
+
+/**
+ *  Skip white spaces and the characters in delims.
+ *  @param delims : at most 4 characters are used.
+ *  @return the first position not skipped.
+ */
+inline const char* skip_delimiters(
+    const char* p, const char* end, const char* delims = "")
+{
+    const std::size_t nDelims = std::min<std::size_t>(strlen(delims), 4);
+    auto isDelim = [&](char c) {
+        if (is_space_char(c)) return true;
+        for (std::size_t ind = 0; ind < nDelims; ++ind)
+            if (c == delims[ind]) return true;
+        return false;
+    };
+
+    // Most numbers are separated by a single character.
+    if (p < end && !isDelim(*p)) return p;
+
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i ctrlRange = _mm_set1_epi8('\r' - '\t');
+    __m128i delimVec[4];
+    for (std::size_t ind = 0; ind < nDelims; ++ind)
+        delimVec[ind] = _mm_set1_epi8(delims[ind]);
+
+    while (end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i ctrl = _mm_sub_epi8(v, tab);
+        __m128i match = _mm_or_si128(
+            _mm_cmpeq_epi8(v, space),
+            _mm_cmpeq_epi8(_mm_min_epu8(ctrl, ctrlRange), ctrl));
+        for (std::size_t ind = 0; ind < nDelims; ++ind)
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(v, delimVec[ind]));
+
+        unsigned mask = (unsigned)_mm_movemask_epi8(match);
+        if (mask != 0xFFFFu)
+            return p + __builtin_ctz(~mask);
+        p += 16;
+    }
+#endif
+
+    while (p < end && isDelim(*p)) ++p;
+    return p;
+}
+
+/**
+ *  Parse a decimal integer in [begin, end), with an optional sign.
+ *  @return position after the number, or begin if nothing could be parsed
+ *          or the value overflows IntType.
+ */
+template<typename IntType>
+const char* parse_integer(const char* begin, const char* end, IntType& value)
+{
+    static_assert(std::is_integral<IntType>::value, "IntType should be integral");
+    typedef typename std::make_unsigned<IntType>::type UnsignedType;
+
+    const char* p = begin;
+    bool bNegative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        bNegative = (*p == '-');
+        if (bNegative && !std::is_signed<IntType>::value) return begin;
+        ++p;
+    }
+
+    const char* digits = p;
+    UnsignedType acc = 0;
+    const UnsignedType limit = bNegative
+        ? (UnsignedType)std::numeric_limits<IntType>::max() + 1
+        : (UnsignedType)std::numeric_limits<IntType>::max();
+    for (; p < end; ++p)
+    {
+        unsigned d = (unsigned char)*p - '0';
+        if (d > 9) break;
+        if (acc > (limit - d) / 10) return begin; // overflow
+        acc = acc * 10 + d;
+    }
+    if (p == digits) return begin;
+
+    value = bNegative ? (IntType)(0 - acc) : (IntType)acc;
+    return p;
+}
+
+namespace detail {
+
+template<typename FloatType>
+FloatType pow10_exact(int e)
+{
+    static const double table[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    return (FloatType)table[e];
+}
+
+// The C locale, so '.' is the decimal point whatever setlocale() says.
+#ifdef __WINOS__
+typedef _locale_t c_locale_type;
+inline c_locale_type c_locale()
+{
+    static c_locale_type loc = _create_locale(LC_ALL, "C");
+    return loc;
+}
+inline long double strto_float(const char* s, char** stop, long double*)
+{
+    return _strtold_l(s, stop, c_locale());
+}
+inline double strto_float(const char* s, char** stop, double*)
+{
+    return _strtod_l(s, stop, c_locale());
+}
+inline float strto_float(const char* s, char** stop, float*)
+{
+    return _strtof_l(s, stop, c_locale());
+}
+#else
+typedef locale_t c_locale_type;
+inline c_locale_type c_locale()
+{
+    static c_locale_type loc = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+    return loc;
+}
+inline long double strto_float(const char* s, char** stop, long double*)
+{
+    return strtold_l(s, stop, c_locale());
+}
+inline double strto_float(const char* s, char** stop, double*)
+{
+    return strtod_l(s, stop, c_locale());
+}
+inline float strto_float(const char* s, char** stop, float*)
+{
+    return strtof_l(s, stop, c_locale());
+}
+#endif
+
+// Hand the token to the C library. Only used for inputs out of the fast path.
+template<typename FloatType>
+const char* parse_float_fallback(const char* begin, const char* end, FloatType& value)
+{
+    const char* tokenEnd = begin;
+    while (tokenEnd < end && !is_space_char(*tokenEnd)) ++tokenEnd;
+
+    char local[64];
+    std::string heap;
+    std::size_t n = tokenEnd - begin;
+    char* buf = local;
+    if (n >= sizeof(local))
+    {
+        heap.assign(begin, n);
+        buf = &heap[0];
+    }
+    else
+    {
+        memcpy(local, begin, n);
+        local[n] = '\0';
+    }
+
+    char* stop = nullptr;
+    FloatType v = strto_float(buf, &stop, (FloatType*)nullptr);
+    if (stop == buf) return begin;
+    value = v;
+    return begin + (stop - buf);
+}
+
+// Largest mantissa and power of ten that are both exact in FloatType,
+// so that m * 10^e or m / 10^e is correctly rounded.
+template<typename FloatType>
+struct float_fast_path
+{
+    static const bool enabled = std::numeric_limits<FloatType>::radix == 2
+        && std::numeric_limits<FloatType>::digits >= 24;
+    static const int mantissaBits =
+        std::numeric_limits<FloatType>::digits >= 53 ? 53 : 24;
+    static const int maxExponent =
+        std::numeric_limits<FloatType>::digits >= 53 ? 22 : 10;
+};
+
+}
+
+/**
+ *  Parse a decimal floating point number in [begin, end), in the C locale.
+ *
+ *  Numbers with at most 19 significant digits whose value is exactly
+ *  representable after one multiplication or division by a power of ten
+ *  (Clinger's fast path) are converted without calling the C library.
+ *  That covers almost every number written by printf with %f or %g.
+ *  Everything else (hex floats, inf, nan, long mantissas, large
+ *  exponents) is handed to strtod, so the result is always correctly
+ *  rounded.
+ *
+ *  @return position after the number, or begin if nothing could be parsed.
+ */
+template<typename FloatType>
+const char* parse_float(const char* begin, const char* end, FloatType& value)
+{
+    static_assert(std::is_floating_point<FloatType>::value,
+        "FloatType should be a floating point type");
+
+    const char* p = begin;
+    bool bNegative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        bNegative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int nDigits = 0; // significant digits in mantissa
+    int exponent = 0;
+    bool bTruncated = false;
+    bool bAnyDigit = false;
+
+    for (; p < end; ++p)
+    {
+        unsigned d = (unsigned char)*p - '0';
+        if (d > 9) break;
+        bAnyDigit = true;
+        if (nDigits < 19)
+        {
+            mantissa = mantissa * 10 + d;
+            if (mantissa != 0) ++nDigits;
+        }
+        else
+        {
+            ++exponent;
+            if (d != 0) bTruncated = true;
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        ++p;
+        for (; p < end; ++p)
+        {
+            unsigned d = (unsigned char)*p - '0';
+            if (d > 9) break;
+            bAnyDigit = true;
+            if (nDigits < 19)
+            {
+                mantissa = mantissa * 10 + d;
+                if (mantissa != 0) ++nDigits;
+                --exponent;
+            }
+            else if (d != 0) bTruncated = true;
+        }
+    }
+    if (!bAnyDigit)
+        return detail::parse_float_fallback(begin, end, value); // inf, nan
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        int e = 0;
+        const char* q = parse_integer(p + 1, end, e);
+        if (q != p + 1) // otherwise the number ends before 'e'
+        {
+            if (e > 100000 || e < -100000) bTruncated = true;
+            else exponent += e;
+            p = q;
+        }
+    }
+    if (p < end && (*p == 'x' || *p == 'X'))
+        return detail::parse_float_fallback(begin, end, value); // hex float
+
+    typedef detail::float_fast_path<FloatType> fast_path;
+    const uint64_t maxMantissa = (uint64_t)1 << fast_path::mantissaBits;
+    const bool bFastPath = fast_path::enabled && !bTruncated && mantissa <= maxMantissa;
+
+    if (bFastPath && mantissa == 0)
+    {
+        value = bNegative ? -(FloatType)0 : (FloatType)0;
+        return p;
+    }
+    if (bFastPath && exponent >= -fast_path::maxExponent)
+    {
+        // Move extra powers of ten into the mantissa while it stays exact.
+        while (exponent > fast_path::maxExponent && mantissa <= maxMantissa / 10)
+        {
+            mantissa *= 10;
+            --exponent;
+        }
+        if (exponent <= fast_path::maxExponent)
+        {
+            FloatType v = (FloatType)mantissa;
+            if (exponent < 0) v /= detail::pow10_exact<FloatType>(-exponent);
+            else v *= detail::pow10_exact<FloatType>(exponent);
+            value = bNegative ? -v : v;
+            return p;
+        }
+    }
+
+    return detail::parse_float_fallback(begin, p, value);
+}
+
+template<typename T>
+const char* parse_number(const char* begin, const char* end, T& value, std::true_type)
+{
+    return parse_integer(begin, end, value);
+}
+template<typename T>
+const char* parse_number(const char* begin, const char* end, T& value, std::false_type)
+{
+    return parse_float(begin, end, value);
+}
+// Parse an integer or a floating point number depending on T.
+template<typename T>
+const char* parse_number(const char* begin, const char* end, T& value)
+{
+    return parse_number(begin, end, value,
+        std::integral_constant<bool, std::is_integral<T>::value>());
+}
+
+/**
+ *  Read delimited numbers from a memory region, a mapped file, or a
+ *  basic_file through a private buffer.
+ *
+ *  Usage:
+ *      number_reader reader(file("data.txt", "rb"));
+ *      std::vector<double> values;
+ *      reader.delimiters(",").read(values);
+ */
+class number_reader
+{
+public:
+    using SizeType = std::size_t;
+
+    number_reader(const char* data, SizeType size)
+        : _pos(data)
+        , _end(data + size)
+        , _bEof(true)
+    {
+    }
+    explicit number_reader(const filesystem::mapped_file& mf)
+        : number_reader(mf.data(), mf.size())
+    {
+    }
+    explicit number_reader(filesystem::basic_file<char> f, SizeType bufferSize = 1 << 16)
+        : _file(f)
+        , _buffer(bufferSize < 128 ? 128 : bufferSize)
+        , _pos(_buffer.data())
+        , _end(_buffer.data())
+        , _bEof(!f.is_open())
+    {
+    }
+
+    // White spaces are always delimiters. At most 4 extra characters.
+    number_reader& delimiters(const std::string& delims)
+    {
+        _delims = delims.substr(0, 4);
+        return *this;
+    }
+
+    /**
+     *  Read the next number.
+     *  @return false at the end of input or if the next token is not a
+     *          number of type T; see fail().
+     */
+    template<typename T>
+    bool read(T& value)
+    {
+        _skip();
+        if (_pos == _end) return false;
+
+        if (!_bEof && _end - _pos < kMaxFastToken) _refill();
+
+        for (;;)
+        {
+            const char* stop = parse_number(_pos, _end, value);
+            if (stop == _pos)
+            {
+                _bFail = true;
+                return false;
+            }
+            // The token may continue past the buffered data.
+            if (stop == _end && !_bEof)
+            {
+                _refill();
+                continue;
+            }
+            _pos = stop;
+            return true;
+        }
+    }
+
+    // Append numbers to out until the end of input or maxCount numbers.
+    template<typename T>
+    SizeType read(std::vector<T>& out,
+                  SizeType maxCount = std::numeric_limits<SizeType>::max())
+    {
+        SizeType n = 0;
+        T value;
+        while (n < maxCount && read(value))
+        {
+            out.push_back(value);
+            ++n;
+        }
+        return n;
+    }
+
+    // Fill out until it is full or the input ends.
+    template<typename T>
+    SizeType read(vector_view<T> out)
+    {
+        SizeType n = 0;
+        T* dest = out.data();
+        while (n < out.size() && read(dest[n]))
+            ++n;
+        return n;
+    }
+
+    bool eof()
+    {
+        _skip();
+        return _pos == _end;
+    }
+    bool fail() const
+    {
+        return _bFail;
+    }
+
+private:
+    // Tokens shorter than this never need a retry after a refill.
+    static const int kMaxFastToken = 64;
+
+    filesystem::basic_file<char> _file;
+    std::vector<char> _buffer;
+    const char* _pos;
+    const char* _end;
+    bool _bEof;
+    bool _bFail = false;
+    std::string _delims;
+
+    void _skip()
+    {
+        for (;;)
+        {
+            _pos = skip_delimiters(_pos, _end, _delims.c_str());
+            if (_pos != _end || _bEof) return;
+            _refill();
+        }
+    }
+
+    // Keep the unread data and append more from the file.
+    void _refill()
+    {
+        SizeType remain = _end - _pos;
+        if (remain * 2 > _buffer.size())
+        {
+            std::vector<char> larger(_buffer.size() * 2);
+            memcpy(larger.data(), _pos, remain);
+            _buffer.swap(larger);
+        }
+        else
+            memmove(_buffer.data(), _pos, remain);
+
+        SizeType nRead = _file.read(_buffer.data() + remain, 1, _buffer.size() - remain);
+        if (nRead == 0) _bEof = true;
+
+        _pos = _buffer.data();
+        _end = _buffer.data() + remain + nRead;
+    }
+
+};
+
+}
@@ -0,0 +1,185 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * parallel_scan.hpp - process a text file in line aligned chunks on all cores
+ * dependency : mapped_file.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+namespace donny {
+namespace filesystem {
+
+/**
+ *  Split [data, data+size) into chunks of about chunk_size bytes. Every
+ *  chunk but the last ends right after a '\n', so no line is cut in two.
+ *  @return chunk boundaries, chunk i is [bounds[i], bounds[i+1]).
+ */
+inline std::vector<std::size_t> split_lines(
+    const char* data, std::size_t size, std::size_t chunk_size)
+{
+    if (chunk_size == 0) chunk_size = 1;
+
+    std::vector<std::size_t> bounds(1, 0);
+    std::size_t pos = 0;
+    while (size - pos > chunk_size)
+    {
+        const char* nl = (const char*)memchr(
+            data + pos + chunk_size - 1, '\n', size - pos - chunk_size + 1);
+        if (nl == nullptr) break;
+        pos = nl - data + 1;
+        if (pos < size) bounds.push_back(pos);
+    }
+    bounds.push_back(size);
+    return bounds;
+}
+
+/**
+ *  Process [data, data+size) in line aligned chunks with a pool of threads.
+ *
+ *  Every thread owns a partial result copied from init, fn accumulates the
+ *  chunks the thread takes into it, then the partials are merged with
+ *  reduce. Chunks are handed out dynamically, so reduce should be
+ *  associative and commutative, and init should be its identity.
+ *
+ *  @param fn : void(const char* begin, const char* end, ResultType& partial)
+ *  @param reduce : void(ResultType& into, ResultType& partial)
+ *  @param nThreads : 0 means std::thread::hardware_concurrency().
+ */
+template<typename ResultType, typename MapFunc, typename ReduceFunc>
+ResultType parallel_scan(
+    const char* data,
+    std::size_t size,
+    std::size_t chunk_size,
+    MapFunc fn,
+    ReduceFunc reduce,
+    ResultType init = ResultType(),
+    unsigned nThreads = 0
+)
+{
+    if (size == 0) return init;
+
+    std::vector<std::size_t> bounds = split_lines(data, size, chunk_size);
+    std::size_t nChunks = bounds.size() - 1;
+
+    if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0) nThreads = 1;
+    if (nThreads > nChunks) nThreads = (unsigned)nChunks;
+
+    std::vector<ResultType> partials(nThreads, init);
+    std::atomic<std::size_t> nextChunk(0);
+    std::atomic<bool> bAbort(false);
+    std::exception_ptr exception;
+    std::mutex exceptionMutex;
+
+    auto work = [&](unsigned id) {
+        try
+        {
+            for (std::size_t chunk = nextChunk++;
+                 chunk < nChunks && !bAbort;
+                 chunk = nextChunk++)
+            {
+                fn(data + bounds[chunk], data + bounds[chunk+1], partials[id]);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(exceptionMutex);
+            if (!exception) exception = std::current_exception();
+            bAbort = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned ind = 1; ind < nThreads; ++ind)
+        threads.emplace_back(work, ind);
+    work(0);
+    for (std::thread& t : threads)
+        t.join();
+
+    if (exception)
+        std::rethrow_exception(exception);
+
+    for (unsigned ind = 1; ind < nThreads; ++ind)
+        reduce(partials[0], partials[ind]);
+    return partials[0];
+}
+
+template<typename ResultType, typename MapFunc, typename ReduceFunc>
+ResultType parallel_scan(
+    const std::string& filename,
+    std::size_t chunk_size,
+    MapFunc fn,
+    ReduceFunc reduce,
+    ResultType init = ResultType(),
+    unsigned nThreads = 0
+)
+{
+    mapped_file mf(filename);
+    if (!mf.is_open())
+        throw std::runtime_error("parallel_scan: can't map " + filename);
+    mf.advise(mapped_file::sequential_access);
+    return parallel_scan(mf.data(), mf.size(), chunk_size, fn, reduce, init, nThreads);
+}
+
+template<typename ResultType, typename MapFunc, typename ReduceFunc>
+ResultType parallel_scan(
+    basic_file<char>& f,
+    std::size_t chunk_size,
+    MapFunc fn,
+    ReduceFunc reduce,
+    ResultType init = ResultType(),
+    unsigned nThreads = 0
+)
+{
+    mapped_file mf(f);
+    if (!mf.is_open())
+        throw std::runtime_error("parallel_scan: can't map file");
+    mf.advise(mapped_file::sequential_access);
+    return parallel_scan(mf.data(), mf.size(), chunk_size, fn, reduce, init, nThreads);
+}
+
+/**
+ *  Like parallel_scan, but fn is called once per line.
+ *  @param fn : void(const char* line, std::size_t length, ResultType& partial)
+ *              length excludes the '\n'.
+ */
+template<typename ResultType, typename LineFunc, typename ReduceFunc>
+ResultType parallel_for_each_line(
+    const std::string& filename,
+    std::size_t chunk_size,
+    LineFunc fn,
+    ReduceFunc reduce,
+    ResultType init = ResultType(),
+    unsigned nThreads = 0
+)
+{
+    return parallel_scan(filename, chunk_size,
+        [&fn](const char* begin, const char* end, ResultType& partial) {
+            while (begin < end)
+            {
+                const char* nl = (const char*)memchr(begin, '\n', end - begin);
+                const char* lineEnd = (nl == nullptr) ? end : nl;
+                fn(begin, (std::size_t)(lineEnd - begin), partial);
+                begin = lineEnd + 1;
+            }
+        },
+        reduce, init, nThreads);
+}
+
+}
+}
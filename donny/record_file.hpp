@@ -0,0 +1,226 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * record_file.hpp - checksummed record framing on top of basic_file
+ * dependency : file.hpp, crc32c.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "file.hpp"
+#include "crc32c.hpp"
+
+namespace donny {
+namespace filesystem {
+
+/**
+ *  Every record is written as a frame:
+ *
+ *      magic       u32     RecordMagic
+ *      length      u32     payload length
+ *      crc         u32     crc32c of the payload
+ *      header_crc  u32     crc32c of the three fields above
+ *      payload     length bytes
+ *
+ *  All fields are in the byte order of the host. The header has its own
+ *  checksum, so a damaged length never makes the reader skip valid frames.
+ */
+const uint32_t RecordMagic = 0x52594E44u; // "DNYR" on little endian hosts
+const std::size_t RecordHeaderSize = 16;
+
+class record_writer
+{
+public:
+    using SizeType = std::size_t;
+
+    explicit record_writer(basic_file<char> f)
+        : _file(f)
+    {
+    }
+
+    bool write(const void* data, uint32_t size)
+    {
+        uint32_t header[4] = { RecordMagic, size, crc32c(data, size), 0 };
+        header[3] = crc32c(header, 12);
+        if (_file.write(header, 1, sizeof(header)) != sizeof(header)) return false;
+        if (size != 0 && _file.write(data, 1, size) != size) return false;
+        ++_nRecords;
+        return true;
+    }
+    bool write(const std::string& record)
+    {
+        return write(record.data(), (uint32_t)record.size());
+    }
+
+    int flush()
+    {
+        return _file.flush();
+    }
+    SizeType records() const
+    {
+        return _nRecords;
+    }
+
+private:
+    basic_file<char> _file;
+    SizeType _nRecords = 0;
+
+};
+
+/**
+ *  Read frames written by record_writer. A frame whose header or payload
+ *  fails the checksum is skipped, and the reader resynchronizes on the
+ *  next magic number instead of giving up.
+ */
+class record_reader
+{
+public:
+    using SizeType = std::size_t;
+
+    explicit record_reader(basic_file<char> f, SizeType bufferSize = 1 << 16)
+        : _file(f)
+        , _buffer(bufferSize < 64 ? 64 : bufferSize)
+    {
+    }
+
+    // Frames claiming a larger payload are treated as damaged.
+    record_reader& max_record_size(uint32_t size)
+    {
+        _maxRecordSize = size;
+        return *this;
+    }
+
+    /**
+     *  Read the next intact record.
+     *  @return false at the end of the file.
+     */
+    bool read(std::string& record)
+    {
+        for (;;)
+        {
+            if (!_fill(RecordHeaderSize))
+            {
+                _skip(_end - _begin); // trailing garbage
+                return false;
+            }
+
+            uint32_t header[4];
+            memcpy(header, &_buffer[_begin], sizeof(header));
+            if (header[0] != RecordMagic)
+            {
+                _resync();
+                continue;
+            }
+            if (crc32c(header, 12) != header[3] || header[1] > _maxRecordSize)
+            {
+                ++_nCorrupted;
+                _skip(1);
+                _resync();
+                continue;
+            }
+
+            // A write cut short leaves a header whose payload runs over the
+            // frames appended after it, or past the end of the file: they
+            // are looked for inside.
+            SizeType frameSize = RecordHeaderSize + header[1];
+            if (!_fill(frameSize)
+                || crc32c(&_buffer[_begin + RecordHeaderSize], header[1]) != header[2])
+            {
+                ++_nCorrupted;
+                _skip(1);
+                _resync();
+                continue;
+            }
+
+            const char* payload = &_buffer[_begin + RecordHeaderSize];
+
+            record.assign(payload, header[1]);
+            _begin += frameSize;
+            ++_nRecords;
+            return true;
+        }
+    }
+
+    SizeType records() const { return _nRecords; }
+    // Number of damaged frames met so far.
+    SizeType corrupted() const { return _nCorrupted; }
+    // Number of bytes dropped with damaged frames and garbage.
+    SizeType skipped_bytes() const { return _nSkipped; }
+
+private:
+    basic_file<char> _file;
+    std::vector<char> _buffer;
+    SizeType _begin = 0;
+    SizeType _end = 0;
+    bool _bEof = false;
+    uint32_t _maxRecordSize = 1u << 30;
+
+    SizeType _nRecords = 0;
+    SizeType _nCorrupted = 0;
+    SizeType _nSkipped = 0;
+
+    // Make sure n bytes are buffered. @return false if the file is too short.
+    bool _fill(SizeType n)
+    {
+        while (_end - _begin < n)
+        {
+            if (_bEof) return false;
+            if (_begin != 0)
+            {
+                memmove(&_buffer[0], &_buffer[_begin], _end - _begin);
+                _end -= _begin;
+                _begin = 0;
+            }
+            if (_buffer.size() < n)
+                _buffer.resize(n);
+            SizeType nRead = _file.read(&_buffer[_end], 1, _buffer.size() - _end);
+            if (nRead == 0) _bEof = true;
+            _end += nRead;
+        }
+        return true;
+    }
+
+    void _skip(SizeType n)
+    {
+        _begin += n;
+        _nSkipped += n;
+    }
+
+    // Drop bytes until the buffer starts with the magic number.
+    void _resync()
+    {
+        char magic[4];
+        memcpy(magic, &RecordMagic, 4);
+        for (;;)
+        {
+            for (SizeType pos = _begin; pos + 4 <= _end; ++pos)
+            {
+                const char* hit = (const char*)memchr(&_buffer[pos], magic[0], _end - pos);
+                if (hit == nullptr) break;
+                pos = hit - &_buffer[0];
+                if (pos + 4 > _end) break;
+                if (memcmp(hit, magic, 4) == 0)
+                {
+                    _skip(pos - _begin);
+                    return;
+                }
+            }
+            // Keep the last 3 bytes, they may start a magic number.
+            SizeType keep = std::min<SizeType>(3, _end - _begin);
+            _skip(_end - _begin - keep);
+            if (!_fill(keep + 1)) return;
+        }
+    }
+
+};
+
+}
+}
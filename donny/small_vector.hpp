@@ -0,0 +1,346 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * small_vector.hpp - a vector keeping up to N elements inline, on the heap
+ *                    only beyond that.
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace donny {
+
+/**
+ *  The subset of std::vector used for numeric coefficients, without
+ *  insert and emplace. Elements move when the storage
+ *  switches between inline and heap, so pointers into it are invalidated
+ *  like std::vector's on growth, and by swap and move as well.
+ *
+ *  Trivially copyable T is copied with memcpy.
+ */
+template<typename T, std::size_t N>
+class small_vector
+{
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    small_vector() : _p(_inline()), _size(0), _capacity(N) {}
+    explicit small_vector(size_type n) : small_vector()
+    {
+        resize(n);
+    }
+    small_vector(size_type n, const T& v) : small_vector()
+    {
+        assign(n, v);
+    }
+    template<typename InputIt,
+             typename = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+    small_vector(InputIt first, InputIt last) : small_vector()
+    {
+        assign(first, last);
+    }
+    small_vector(std::initializer_list<T> l) : small_vector()
+    {
+        assign(l.begin(), l.end());
+    }
+
+    small_vector(const small_vector& o) : small_vector()
+    {
+        _copy_from(o);
+    }
+    small_vector(small_vector&& o) noexcept : small_vector()
+    {
+        _steal(o);
+    }
+    small_vector& operator=(const small_vector& o)
+    {
+        if (this != &o)
+        {
+            clear();
+            _copy_from(o);
+        }
+        return *this;
+    }
+    small_vector& operator=(small_vector&& o) noexcept
+    {
+        if (this != &o)
+        {
+            _release();
+            _steal(o);
+        }
+        return *this;
+    }
+    ~small_vector()
+    {
+        _release();
+    }
+
+    void assign(size_type n, const T& v)
+    {
+        // v may be an element of this vector.
+        T copy(v);
+        clear();
+        reserve(n);
+        std::uninitialized_fill_n(_p, n, copy);
+        _size = n;
+    }
+    template<typename InputIt,
+             typename = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+    void assign(InputIt first, InputIt last)
+    {
+        clear();
+        _assign(first, last, typename std::iterator_traits<InputIt>::iterator_category());
+    }
+
+    size_type size() const { return _size; }
+    size_type capacity() const { return _capacity; }
+    bool empty() const { return _size == 0; }
+    // Whether the elements live in the inline buffer.
+    bool is_inline() const { return _p == _inline(); }
+
+    T* data() { return _p; }
+    const T* data() const { return _p; }
+    T& operator[](size_type ind) { return _p[ind]; }
+    const T& operator[](size_type ind) const { return _p[ind]; }
+    T& front() { return _p[0]; }
+    const T& front() const { return _p[0]; }
+    T& back() { return _p[_size - 1]; }
+    const T& back() const { return _p[_size - 1]; }
+
+    iterator begin() { return _p; }
+    iterator end() { return _p + _size; }
+    const_iterator begin() const { return _p; }
+    const_iterator end() const { return _p + _size; }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+    void reserve(size_type n)
+    {
+        if (n > _capacity)
+            _grow(n);
+    }
+    void resize(size_type n)
+    {
+        resize(n, T());
+    }
+    void resize(size_type n, const T& v)
+    {
+        if (n > _capacity)
+        {
+            // v may be an element of this vector.
+            T copy(v);
+            _grow(std::max(n, 2 * _size));
+            std::uninitialized_fill(_p + _size, _p + n, copy);
+        }
+        else if (n > _size)
+            std::uninitialized_fill(_p + _size, _p + n, v);
+        else
+            _destroy(_p + n, _p + _size);
+        _size = n;
+    }
+    void clear()
+    {
+        _destroy(_p, _p + _size);
+        _size = 0;
+    }
+    void push_back(const T& v)
+    {
+        if (_size == _capacity)
+        {
+            // v may be an element of this vector.
+            T copy(v);
+            _grow(2 * _capacity);
+            new (_p + _size) T(std::move(copy));
+        }
+        else
+            new (_p + _size) T(v);
+        ++_size;
+    }
+    void push_back(T&& v)
+    {
+        if (_size == _capacity)
+        {
+            T moved(std::move(v));
+            _grow(2 * _capacity);
+            new (_p + _size) T(std::move(moved));
+        }
+        else
+            new (_p + _size) T(std::move(v));
+        ++_size;
+    }
+    void pop_back()
+    {
+        --_size;
+        _p[_size].~T();
+    }
+    iterator erase(iterator first, iterator last)
+    {
+        iterator e = end();
+        std::move(last, e, first);
+        const size_type nErased = last - first;
+        _destroy(e - nErased, e);
+        _size -= nErased;
+        return first;
+    }
+
+    void swap(small_vector& o)
+    {
+        if (!is_inline() && !o.is_inline())
+        {
+            std::swap(_p, o._p);
+            std::swap(_size, o._size);
+            std::swap(_capacity, o._capacity);
+            return;
+        }
+        if (std::is_trivially_copyable<T>::value && is_inline() && o.is_inline())
+        {
+            std::swap(_buffer, o._buffer);
+            std::swap(_size, o._size);
+            return;
+        }
+        small_vector t(std::move(o));
+        o = std::move(*this);
+        *this = std::move(t);
+    }
+
+    friend bool operator==(const small_vector& a, const small_vector& b)
+    {
+        return a._size == b._size && std::equal(a.begin(), a.end(), b.begin());
+    }
+    friend bool operator!=(const small_vector& a, const small_vector& b)
+    {
+        return !(a == b);
+    }
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type _slot;
+
+    T* _p;
+    size_type _size;
+    size_type _capacity;
+    _slot _buffer[N];
+
+    T* _inline() { return reinterpret_cast<T*>(_buffer); }
+    const T* _inline() const { return reinterpret_cast<const T*>(_buffer); }
+
+    static void _destroy(T* first, T* last)
+    {
+        if (!std::is_trivially_destructible<T>::value)
+            for (; first != last; ++first)
+                first->~T();
+    }
+
+    // A single pass input range can only be read once, it grows as it goes.
+    template<typename InputIt>
+    void _assign(InputIt first, InputIt last, std::input_iterator_tag)
+    {
+        for (; first != last; ++first)
+            push_back(*first);
+    }
+    template<typename ForwardIt>
+    void _assign(ForwardIt first, ForwardIt last, std::forward_iterator_tag)
+    {
+        reserve(std::distance(first, last));
+        for (; first != last; ++first)
+            new (_p + _size++) T(*first);
+    }
+
+    // Move the elements to n slots, n > _capacity.
+    void _grow(size_type n)
+    {
+        T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+        _relocate(_p, _size, p);
+        if (!is_inline())
+            ::operator delete(_p);
+        _p = p;
+        _capacity = n;
+    }
+
+    static void _relocate(T* from, size_type n, T* to)
+    {
+        if (std::is_trivially_copyable<T>::value)
+        {
+            if (n) std::memcpy(static_cast<void*>(to), from, n * sizeof(T));
+            return;
+        }
+        for (size_type ind = 0; ind < n; ++ind)
+        {
+            new (to + ind) T(std::move(from[ind]));
+            from[ind].~T();
+        }
+    }
+
+    void _copy_from(const small_vector& o)
+    {
+        reserve(o._size);
+        if (std::is_trivially_copyable<T>::value)
+        {
+            // The whole inline buffer, a fixed size copy the compiler
+            // inlines, is cheaper than a call for the used part.
+            if (o.is_inline() && is_inline())
+                std::memcpy(static_cast<void*>(_buffer), o._buffer, sizeof(_buffer));
+            else if (o._size)
+                std::memcpy(static_cast<void*>(_p), o._p, o._size * sizeof(T));
+        }
+        else
+            std::uninitialized_copy(o.begin(), o.end(), _p);
+        _size = o._size;
+    }
+
+    // Take o's elements, *this being empty and inline; o is left empty.
+    void _steal(small_vector& o)
+    {
+        if (o.is_inline())
+        {
+            if (std::is_trivially_copyable<T>::value)
+                std::memcpy(static_cast<void*>(_buffer), o._buffer, sizeof(_buffer));
+            else
+                _relocate(o._p, o._size, _p);
+            _size = o._size;
+        }
+        else
+        {
+            _p = o._p;
+            _size = o._size;
+            _capacity = o._capacity;
+            o._p = o._inline();
+            o._capacity = N;
+        }
+        o._size = 0;
+    }
+
+    // Destroy the elements and give back the heap block, back to empty
+    // and inline.
+    void _release()
+    {
+        clear();
+        if (!is_inline())
+            ::operator delete(_p);
+        _p = _inline();
+        _capacity = N;
+    }
+
+};
+
+} // donny
@@ -0,0 +1,852 @@
+/**
+ * donnylib - A lightweight library for c++
+ *
+ * unicode.hpp - transcoding between UTF-8, UTF-16 and UTF-32
+ * dependency : base.hpp, file.hpp, cpu_features.hpp
+ *
+ * Author : Donny
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "file.hpp"
+#include "cpu_features.hpp"
+
+namespace donny {
+namespace unicode {
+
+enum Encoding {
+    UNKNOWN = 0,
+    UTF8,
+    UTF16LE,
+    UTF16BE,
+    UTF32LE,
+    UTF32BE,
+};
+
+const char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+const Encoding NativeUTF16 = UTF16BE;
+const Encoding NativeUTF32 = UTF32BE;
+#else
+const Encoding NativeUTF16 = UTF16LE;
+const Encoding NativeUTF32 = UTF32LE;
+#endif
+
+/**
+ *  Detect the encoding from the byte order mark at the beginning of data.
+ *  @param bomLength : set to the length of the BOM, 0 if there is none.
+ */
+inline Encoding detect_bom(const char* data, std::size_t size, std::size_t& bomLength)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    bomLength = 0;
+    if (size >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF)
+        return bomLength = 3, UTF8;
+    if (size >= 4 && p[0] == 0xFF && p[1] == 0xFE && p[2] == 0 && p[3] == 0)
+        return bomLength = 4, UTF32LE;
+    if (size >= 4 && p[0] == 0 && p[1] == 0 && p[2] == 0xFE && p[3] == 0xFF)
+        return bomLength = 4, UTF32BE;
+    if (size >= 2 && p[0] == 0xFF && p[1] == 0xFE)
+        return bomLength = 2, UTF16LE;
+    if (size >= 2 && p[0] == 0xFE && p[1] == 0xFF)
+        return bomLength = 2, UTF16BE;
+    return UNKNOWN;
+}
+
+inline std::string bom(Encoding enc)
+{
+    switch (enc)
+    {
+    case UTF8: return std::string("\xEF\xBB\xBF", 3);
+    case UTF16LE: return std::string("\xFF\xFE", 2);
+    case UTF16BE: return std::string("\xFE\xFF", 2);
+    case UTF32LE: return std::string("\xFF\xFE\0\0", 4);
+    case UTF32BE: return std::string("\0\0\xFE\xFF", 4);
+    default: return std::string();
+    }
+}
+
+namespace detail {
+
+// The kernels convert whole blocks of ASCII characters from the start of
+// the input and return how many characters they converted. The scalar
+// code takes over at the first block holding a non-ASCII character.
+struct kernels
+{
+    std::size_t (*widen16)(const char*, std::size_t, char16_t*);
+    std::size_t (*widen32)(const char*, std::size_t, char32_t*);
+    std::size_t (*narrow16)(const char16_t*, std::size_t, char*);
+    std::size_t (*narrow32)(const char32_t*, std::size_t, char*);
+    void (*bswap16)(char16_t*, std::size_t);
+    void (*bswap32)(char32_t*, std::size_t);
+};
+
+inline std::size_t widen16_scalar(const char* src, std::size_t n, char16_t* dst)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, src + i, 8);
+        if (word & 0x8080808080808080ull) break;
+        for (int k = 0; k < 8; ++k) dst[i+k] = (char16_t)src[i+k];
+    }
+    return i;
+}
+inline std::size_t widen32_scalar(const char* src, std::size_t n, char32_t* dst)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, src + i, 8);
+        if (word & 0x8080808080808080ull) break;
+        for (int k = 0; k < 8; ++k) dst[i+k] = (char32_t)src[i+k];
+    }
+    return i;
+}
+inline std::size_t narrow16_scalar(const char16_t* src, std::size_t n, char* dst)
+{
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        if ((src[i] | src[i+1] | src[i+2] | src[i+3]) >= 0x80) break;
+        for (int k = 0; k < 4; ++k) dst[i+k] = (char)src[i+k];
+    }
+    return i;
+}
+inline std::size_t narrow32_scalar(const char32_t* src, std::size_t n, char* dst)
+{
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        if ((src[i] | src[i+1] | src[i+2] | src[i+3]) >= 0x80) break;
+        for (int k = 0; k < 4; ++k) dst[i+k] = (char)src[i+k];
+    }
+    return i;
+}
+inline void bswap16_scalar(char16_t* p, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+        p[i] = (char16_t)((p[i] << 8) | (p[i] >> 8));
+}
+inline void bswap32_scalar(char32_t* p, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+        p[i] = __builtin_bswap32(p[i]);
+}
+
+#if DONNY_X86
+
+DONNY_TARGET("sse2")
+inline std::size_t widen16_sse2(const char* src, std::size_t n, char16_t* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        if (_mm_movemask_epi8(v)) break;
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+    return i;
+}
+DONNY_TARGET("sse2")
+inline std::size_t widen32_sse2(const char* src, std::size_t n, char32_t* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        if (_mm_movemask_epi8(v)) break;
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+    }
+    return i;
+}
+DONNY_TARGET("sse2")
+inline std::size_t narrow16_sse2(const char16_t* src, std::size_t n, char* dst)
+{
+    const __m128i high = _mm_set1_epi16((short)0xFF80);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 8));
+        __m128i bits = _mm_and_si128(_mm_or_si128(a, b), high);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(bits, _mm_setzero_si128())) != 0xFFFF)
+            break;
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+    }
+    return i;
+}
+DONNY_TARGET("sse2")
+inline std::size_t narrow32_sse2(const char32_t* src, std::size_t n, char* dst)
+{
+    const __m128i high = _mm_set1_epi32((int)0xFFFFFF80);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 4));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 8));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 12));
+        __m128i bits = _mm_and_si128(
+            _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), high);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(bits, _mm_setzero_si128())) != 0xFFFF)
+            break;
+        __m128i ab = _mm_packs_epi32(a, b);
+        __m128i cd = _mm_packs_epi32(c, d);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(ab, cd));
+    }
+    return i;
+}
+DONNY_TARGET("sse2")
+inline void bswap16_sse2(char16_t* p, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i*)(p + i), v);
+    }
+    bswap16_scalar(p + i, n - i);
+}
+DONNY_TARGET("sse2")
+inline void bswap32_sse2(char32_t* p, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        v = _mm_shufflelo_epi16(_mm_shufflehi_epi16(v, 0xB1), 0xB1);
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i*)(p + i), v);
+    }
+    bswap32_scalar(p + i, n - i);
+}
+
+DONNY_TARGET("avx2")
+inline std::size_t widen16_avx2(const char* src, std::size_t n, char16_t* dst)
+{
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        if (_mm256_movemask_epi8(v)) break;
+        _mm256_storeu_si256((__m256i*)(dst + i),
+            _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+        _mm256_storeu_si256((__m256i*)(dst + i + 16),
+            _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+    }
+    return i;
+}
+DONNY_TARGET("avx2")
+inline std::size_t widen32_avx2(const char* src, std::size_t n, char32_t* dst)
+{
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        if (_mm256_movemask_epi8(v)) break;
+        for (int k = 0; k < 4; ++k)
+            _mm256_storeu_si256((__m256i*)(dst + i + k * 8),
+                _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i + k * 8))));
+    }
+    return i;
+}
+DONNY_TARGET("avx2")
+inline std::size_t narrow16_avx2(const char16_t* src, std::size_t n, char* dst)
+{
+    const __m256i high = _mm256_set1_epi16((short)0xFF80);
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+        if (!_mm256_testz_si256(_mm256_or_si256(a, b), high)) break;
+        // packus works within 128 bit lanes, restore the order afterwards.
+        __m256i packed = _mm256_packus_epi16(a, b);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    return i;
+}
+DONNY_TARGET("avx2")
+inline std::size_t narrow32_avx2(const char32_t* src, std::size_t n, char* dst)
+{
+    const __m256i high = _mm256_set1_epi32((int)0xFFFFFF80);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(src + i + 24));
+        __m256i bits = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+        if (!_mm256_testz_si256(bits, high)) break;
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    return i;
+}
+DONNY_TARGET("avx2")
+inline void bswap16_avx2(char16_t* p, std::size_t n)
+{
+    const __m256i mask = _mm256_setr_epi8(
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        _mm256_storeu_si256((__m256i*)(p + i), _mm256_shuffle_epi8(v, mask));
+    }
+    bswap16_scalar(p + i, n - i);
+}
+DONNY_TARGET("avx2")
+inline void bswap32_avx2(char32_t* p, std::size_t n)
+{
+    const __m256i mask = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        _mm256_storeu_si256((__m256i*)(p + i), _mm256_shuffle_epi8(v, mask));
+    }
+    bswap32_scalar(p + i, n - i);
+}
+
+#endif // DONNY_X86
+
+inline const kernels& get_kernels()
+{
+    static const kernels k = []() {
+        kernels k = {
+            widen16_scalar, widen32_scalar, narrow16_scalar, narrow32_scalar,
+            bswap16_scalar, bswap32_scalar,
+        };
+#if DONNY_X86
+        if (cpu().avx2)
+            k = kernels{
+                widen16_avx2, widen32_avx2, narrow16_avx2, narrow32_avx2,
+                bswap16_avx2, bswap32_avx2,
+            };
+        else if (cpu().sse2)
+            k = kernels{
+                widen16_sse2, widen32_sse2, narrow16_sse2, narrow32_sse2,
+                bswap16_sse2, bswap32_sse2,
+            };
+#endif
+        return k;
+    }();
+    return k;
+}
+
+/**
+ *  Decode one code point from a non-ASCII lead byte.
+ *  @return the length of the sequence; 0 if the input ends inside a valid
+ *          prefix; -n if the n bytes are an invalid (maximal) subpart.
+ */
+inline int decode_utf8(const unsigned char* p, const unsigned char* end, char32_t& cp)
+{
+    unsigned c = p[0];
+    int len;
+    if (c >= 0xC2 && c <= 0xDF) { len = 2; cp = c & 0x1F; }
+    else if (c >= 0xE0 && c <= 0xEF) { len = 3; cp = c & 0x0F; }
+    else if (c >= 0xF0 && c <= 0xF4) { len = 4; cp = c & 0x07; }
+    else return -1;
+
+    for (int ind = 1; ind < len; ++ind)
+    {
+        if (p + ind >= end) return 0;
+        unsigned cc = p[ind];
+        unsigned lo = 0x80, hi = 0xBF;
+        if (ind == 1)
+        {
+            // Reject overlong forms, surrogates and code points > U+10FFFF.
+            if (c == 0xE0) lo = 0xA0;
+            else if (c == 0xED) hi = 0x9F;
+            else if (c == 0xF0) lo = 0x90;
+            else if (c == 0xF4) hi = 0x8F;
+        }
+        if (cc < lo || cc > hi) return -ind;
+        cp = (cp << 6) | (cc & 0x3F);
+    }
+    return len;
+}
+
+inline char* encode_utf8(char32_t cp, char* dst)
+{
+    if (cp < 0x80)
+        *dst++ = (char)cp;
+    else if (cp < 0x800)
+    {
+        *dst++ = (char)(0xC0 | (cp >> 6));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        *dst++ = (char)(0xE0 | (cp >> 12));
+        *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        *dst++ = (char)(0xF0 | (cp >> 18));
+        *dst++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return dst;
+}
+
+inline char16_t* encode_utf16(char32_t cp, char16_t* dst)
+{
+    if (cp < 0x10000)
+        *dst++ = (char16_t)cp;
+    else
+    {
+        cp -= 0x10000;
+        *dst++ = (char16_t)(0xD800 | (cp >> 10));
+        *dst++ = (char16_t)(0xDC00 | (cp & 0x3FF));
+    }
+    return dst;
+}
+inline char32_t* encode_utf16(char32_t cp, char32_t* dst)
+{
+    *dst++ = cp;
+    return dst;
+}
+
+inline std::size_t widen(const kernels& k, const char* src, std::size_t n, char16_t* dst)
+{
+    return k.widen16(src, n, dst);
+}
+inline std::size_t widen(const kernels& k, const char* src, std::size_t n, char32_t* dst)
+{
+    return k.widen32(src, n, dst);
+}
+
+/**
+ *  Append the UTF-16 or UTF-32 form of the UTF-8 input to out. Invalid
+ *  sequences become U+FFFD.
+ *  @param bFinal : false if more input follows, an incomplete sequence at
+ *                  the end is left unconsumed.
+ *  @return number of bytes consumed.
+ */
+template<typename UnitType>
+std::size_t from_utf8(const char* src, std::size_t n,
+    std::basic_string<UnitType>& out, bool bFinal, std::size_t& nErrors)
+{
+    const kernels& k = get_kernels();
+    const unsigned char* s = (const unsigned char*)src;
+    std::size_t base = out.size();
+    out.resize(base + n); // every byte makes at most one code unit
+    UnitType* const begin = &out[0] + base;
+    UnitType* dst = begin;
+
+    std::size_t i = 0;
+    while (i < n)
+    {
+        if (s[i] < 0x80)
+        {
+            std::size_t m = widen(k, src + i, n - i, dst);
+            i += m; dst += m;
+            while (i < n && s[i] < 0x80)
+                *dst++ = (UnitType)s[i++];
+            continue;
+        }
+
+        char32_t cp;
+        int len = decode_utf8(s + i, s + n, cp);
+        if (len == 0)
+        {
+            if (!bFinal) break;
+            len = -(int)(n - i);
+        }
+        if (len < 0)
+        {
+            ++nErrors;
+            cp = REPLACEMENT_CHARACTER;
+            len = -len;
+        }
+        dst = encode_utf16(cp, dst);
+        i += len;
+    }
+
+    out.resize(base + (dst - begin));
+    return i;
+}
+
+inline std::size_t narrow(const kernels& k, const char16_t* src, std::size_t n, char* dst)
+{
+    return k.narrow16(src, n, dst);
+}
+inline std::size_t narrow(const kernels& k, const char32_t* src, std::size_t n, char* dst)
+{
+    return k.narrow32(src, n, dst);
+}
+
+// @return the code point at src[i], advancing i; 0 units consumed if the
+//         input ends inside a surrogate pair and more input follows.
+inline char32_t decode_unit(const char16_t* src, std::size_t n, std::size_t& i,
+    bool bFinal, std::size_t& nErrors, bool& bIncomplete)
+{
+    char32_t u = src[i];
+    if (u < 0xD800 || u > 0xDFFF) { ++i; return u; }
+    if (u <= 0xDBFF)
+    {
+        if (i + 1 >= n && !bFinal) { bIncomplete = true; return 0; }
+        if (i + 1 < n && src[i+1] >= 0xDC00 && src[i+1] <= 0xDFFF)
+        {
+            char32_t cp = 0x10000 + ((u - 0xD800) << 10) + (src[i+1] - 0xDC00);
+            i += 2;
+            return cp;
+        }
+    }
+    ++i;
+    ++nErrors;
+    return REPLACEMENT_CHARACTER;
+}
+inline char32_t decode_unit(const char32_t* src, std::size_t, std::size_t& i,
+    bool, std::size_t& nErrors, bool&)
+{
+    char32_t u = src[i++];
+    if (u > 0x10FFFF || (u >= 0xD800 && u <= 0xDFFF))
+    {
+        ++nErrors;
+        return REPLACEMENT_CHARACTER;
+    }
+    return u;
+}
+
+/**
+ *  Append the UTF-8 form of the UTF-16 or UTF-32 input to out.
+ *  @return number of code units consumed.
+ */
+template<typename UnitType>
+std::size_t to_utf8(const UnitType* src, std::size_t n,
+    std::string& out, bool bFinal, std::size_t& nErrors)
+{
+    const kernels& k = get_kernels();
+    std::size_t base = out.size();
+    out.resize(base + n * (sizeof(UnitType) == 2 ? 3 : 4));
+    char* const begin = &out[0] + base;
+    char* dst = begin;
+
+    std::size_t i = 0;
+    while (i < n)
+    {
+        if (src[i] < 0x80)
+        {
+            std::size_t m = narrow(k, src + i, n - i, dst);
+            i += m; dst += m;
+            while (i < n && src[i] < 0x80)
+                *dst++ = (char)src[i++];
+            continue;
+        }
+
+        bool bIncomplete = false;
+        char32_t cp = decode_unit(src, n, i, bFinal, nErrors, bIncomplete);
+        if (bIncomplete) break;
+        dst = encode_utf8(cp, dst);
+    }
+
+    out.resize(base + (dst - begin));
+    return i;
+}
+
+}
+
+inline std::u16string utf8_to_utf16(const std::string& s, std::size_t* nErrors = nullptr)
+{
+    std::u16string out;
+    std::size_t errors = 0;
+    detail::from_utf8(s.data(), s.size(), out, true, errors);
+    if (nErrors) *nErrors = errors;
+    return out;
+}
+inline std::u32string utf8_to_utf32(const std::string& s, std::size_t* nErrors = nullptr)
+{
+    std::u32string out;
+    std::size_t errors = 0;
+    detail::from_utf8(s.data(), s.size(), out, true, errors);
+    if (nErrors) *nErrors = errors;
+    return out;
+}
+inline std::string utf16_to_utf8(const std::u16string& s, std::size_t* nErrors = nullptr)
+{
+    std::string out;
+    std::size_t errors = 0;
+    detail::to_utf8(s.data(), s.size(), out, true, errors);
+    if (nErrors) *nErrors = errors;
+    return out;
+}
+inline std::string utf32_to_utf8(const std::u32string& s, std::size_t* nErrors = nullptr)
+{
+    std::string out;
+    std::size_t errors = 0;
+    detail::to_utf8(s.data(), s.size(), out, true, errors);
+    if (nErrors) *nErrors = errors;
+    return out;
+}
+
+// wchar_t is UTF-32 on unix like systems and UTF-16 on windows.
+inline std::string wstring_to_utf8(const std::wstring& s, std::size_t* nErrors = nullptr)
+{
+    typedef std::conditional<sizeof(wchar_t) == 2, char16_t, char32_t>::type UnitType;
+    std::string out;
+    std::size_t errors = 0;
+    detail::to_utf8((const UnitType*)s.data(), s.size(), out, true, errors);
+    if (nErrors) *nErrors = errors;
+    return out;
+}
+inline std::wstring utf8_to_wstring(const std::string& s, std::size_t* nErrors = nullptr)
+{
+    typedef std::conditional<sizeof(wchar_t) == 2, char16_t, char32_t>::type UnitType;
+    std::basic_string<UnitType> units;
+    std::size_t errors = 0;
+    detail::from_utf8(s.data(), s.size(), units, true, errors);
+    if (nErrors) *nErrors = errors;
+    return std::wstring((const wchar_t*)units.data(), units.size());
+}
+
+inline bool validate_utf8(const char* data, std::size_t size)
+{
+    const unsigned char* s = (const unsigned char*)data;
+    const unsigned char* end = s + size;
+    const detail::kernels& k = detail::get_kernels();
+    char16_t scratch[32];
+    while (s < end)
+    {
+        if (*s < 0x80)
+        {
+            // The widening kernel tells how long the ASCII run is.
+            std::size_t m = k.widen16((const char*)s, std::min<std::size_t>(end - s, 32), scratch);
+            s += m;
+            if (m == 0) ++s;
+            continue;
+        }
+        char32_t cp;
+        int len = detail::decode_utf8(s, end, cp);
+        if (len <= 0) return false;
+        s += len;
+    }
+    return true;
+}
+
+/**
+ *  Convert a byte stream between UTF-8 and UTF-16 / UTF-32 of either
+ *  endianness, chunk by chunk. A chunk may end anywhere, incomplete
+ *  sequences are kept until the next call to feed().
+ *
+ *  Usage:
+ *      stream_transcoder tc(unicode::UNKNOWN, unicode::UTF8);
+ *      while (...) tc.feed(buf, n, out);
+ *      tc.finish(out);
+ */
+class stream_transcoder
+{
+public:
+    /**
+     *  @param from : UNKNOWN means detecting it from the BOM, UTF-8 if
+     *                there is none.
+     *  @param to : one of from and to should be UTF8.
+     *  @param bWriteBom : start the output with the BOM of to.
+     */
+    stream_transcoder(Encoding from, Encoding to, bool bWriteBom = false)
+        : _from(from)
+        , _to(to)
+        , _bWriteBom(bWriteBom)
+    {
+        if (to == UNKNOWN)
+            throw std::invalid_argument("unknown target encoding");
+        if (from != UNKNOWN && from != UTF8 && to != UTF8)
+            throw std::invalid_argument("one of the encodings should be UTF-8");
+    }
+
+    void feed(const char* data, std::size_t size, std::string& out)
+    {
+        _process(data, size, out, false);
+    }
+    void finish(std::string& out)
+    {
+        _process(nullptr, 0, out, true);
+    }
+
+    Encoding source_encoding() const { return _from; }
+    std::size_t errors() const { return _nErrors; }
+
+private:
+    Encoding _from;
+    Encoding _to;
+    bool _bWriteBom;
+    bool _bStarted = false;
+    std::size_t _nErrors = 0;
+    std::string _carry;
+    std::u16string _u16;
+    std::u32string _u32;
+
+    void _process(const char* data, std::size_t size, std::string& out, bool bFinal)
+    {
+        const char* p = data;
+        std::size_t n = size;
+        if (!_carry.empty())
+        {
+            _carry.append(data, size);
+            p = _carry.data();
+            n = _carry.size();
+        }
+
+        std::size_t bomLength = 0;
+        if (!_bStarted)
+        {
+            // Wait for enough bytes to recognize any BOM.
+            if (n < 4 && !bFinal)
+            {
+                _keep(p, n, 0);
+                return;
+            }
+            bomLength = _start(p, n, out);
+        }
+
+        std::size_t used = bomLength + _convert(p + bomLength, n - bomLength, out, bFinal);
+        _keep(p, n, used);
+    }
+
+    // Settle the source encoding and write the BOM.
+    // @return length of the BOM to skip in the input.
+    std::size_t _start(const char* p, std::size_t n, std::string& out)
+    {
+        std::size_t bomLength = 0;
+        Encoding detected = detect_bom(p, n, bomLength);
+        if (_from == UNKNOWN)
+            _from = (detected == UNKNOWN) ? UTF8 : detected;
+        if (detected != _from) bomLength = 0;
+        if (_from != UTF8 && _to != UTF8)
+            throw std::invalid_argument("one of the encodings should be UTF-8");
+        if (_bWriteBom) out += bom(_to);
+        _bStarted = true;
+        return bomLength;
+    }
+
+    // Keep [p+used, p+n) for the next call.
+    void _keep(const char* p, std::size_t n, std::size_t used)
+    {
+        std::string rest(p + used, n - used);
+        _carry.swap(rest);
+    }
+
+    static bool _is_utf16(Encoding e) { return e == UTF16LE || e == UTF16BE; }
+    static bool _is_utf32(Encoding e) { return e == UTF32LE || e == UTF32BE; }
+
+    std::size_t _convert(const char* p, std::size_t n, std::string& out, bool bFinal)
+    {
+        const detail::kernels& k = detail::get_kernels();
+
+        if (_from == UTF8 && _to == UTF8)
+        {
+            _u32.clear();
+            std::size_t used = detail::from_utf8(p, n, _u32, bFinal, _nErrors);
+            std::size_t dummy = 0;
+            detail::to_utf8(_u32.data(), _u32.size(), out, true, dummy);
+            return used;
+        }
+        if (_from == UTF8 && _is_utf16(_to))
+        {
+            _u16.clear();
+            std::size_t used = detail::from_utf8(p, n, _u16, bFinal, _nErrors);
+            if (_to != NativeUTF16) k.bswap16(&_u16[0], _u16.size());
+            out.append((const char*)_u16.data(), _u16.size() * 2);
+            return used;
+        }
+        if (_from == UTF8 && _is_utf32(_to))
+        {
+            _u32.clear();
+            std::size_t used = detail::from_utf8(p, n, _u32, bFinal, _nErrors);
+            if (_to != NativeUTF32) k.bswap32(&_u32[0], _u32.size());
+            out.append((const char*)_u32.data(), _u32.size() * 4);
+            return used;
+        }
+        if (_is_utf16(_from))
+        {
+            std::size_t nUnits = n / 2;
+            _u16.resize(nUnits);
+            if (nUnits) memcpy(&_u16[0], p, nUnits * 2);
+            if (_from != NativeUTF16) k.bswap16(&_u16[0], nUnits);
+            std::size_t used = detail::to_utf8(_u16.data(), nUnits, out, bFinal, _nErrors) * 2;
+            return _finish_odd(used, n, out, bFinal);
+        }
+        // _is_utf32(_from)
+        std::size_t nUnits = n / 4;
+        _u32.resize(nUnits);
+        if (nUnits) memcpy(&_u32[0], p, nUnits * 4);
+        if (_from != NativeUTF32) k.bswap32(&_u32[0], nUnits);
+        std::size_t used = detail::to_utf8(_u32.data(), nUnits, out, bFinal, _nErrors) * 4;
+        return _finish_odd(used, n, out, bFinal);
+    }
+
+    // Trailing bytes which can't make a whole code unit at the end of input.
+    std::size_t _finish_odd(std::size_t used, std::size_t n, std::string& out, bool bFinal)
+    {
+        if (bFinal && used < n)
+        {
+            char buf[4];
+            out.append(buf, detail::encode_utf8(REPLACEMENT_CHARACTER, buf) - buf);
+            ++_nErrors;
+            return n;
+        }
+        return used;
+    }
+
+};
+
+/**
+ *  Transcode the whole content of in and write it to out.
+ *  @return number of invalid sequences replaced by U+FFFD.
+ */
+inline std::size_t transcode(
+    filesystem::basic_file<char> in,
+    filesystem::basic_file<char> out,
+    Encoding to,
+    Encoding from = UNKNOWN,
+    bool bWriteBom = false,
+    std::size_t bufferSize = 1 << 20
+)
+{
+    stream_transcoder tc(from, to, bWriteBom);
+    std::string inbuf(bufferSize, '\0');
+    std::string outbuf;
+    for (;;)
+    {
+        std::size_t n = in.read(&inbuf[0], 1, bufferSize);
+        outbuf.clear();
+        if (n == 0) tc.finish(outbuf);
+        else tc.feed(inbuf.data(), n, outbuf);
+        if (!outbuf.empty()) out.write(outbuf.data(), 1, outbuf.size());
+        if (n == 0) break;
+    }
+    return tc.errors();
+}
+
+}
+}
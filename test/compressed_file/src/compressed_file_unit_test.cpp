@@ -0,0 +1,185 @@
+#define BOOST_TEST_MODULE compressed_file
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <random>
+#include <string>
+
+#include <donny/lz_block.hpp>
+#include <donny/compressed_file.hpp>
+
+using namespace donny;
+using namespace donny::filesystem;
+
+static std::string make_text(std::size_t n)
+{
+    std::string s;
+    for (std::size_t ind = 0; s.size() < n; ++ind)
+        s += "line " + std::to_string(ind % 997) + " the quick brown fox\n";
+    s.resize(n);
+    return s;
+}
+
+static std::string make_random(std::size_t n)
+{
+    std::mt19937 gen(42);
+    std::string s(n, '\0');
+    for (char& c : s) c = (char)gen();
+    return s;
+}
+
+static bool round_trip(const std::string& raw)
+{
+    std::string packed;
+    lz_compress(raw.data(), raw.size(), packed);
+    std::string out(raw.size(), '\0');
+    return lz_decompress(packed.data(), packed.size(), &out[0], out.size()) && out == raw;
+}
+
+BOOST_AUTO_TEST_CASE( test_lz_block )
+{
+    BOOST_CHECK(round_trip(""));
+    BOOST_CHECK(round_trip("a"));
+    BOOST_CHECK(round_trip(std::string(100000, 'x')));
+    BOOST_CHECK(round_trip(make_text(200000)));
+    BOOST_CHECK(round_trip(make_random(70000)));
+
+    std::string text = make_text(100000), packed;
+    lz_compress(text.data(), text.size(), packed);
+    BOOST_CHECK(packed.size() < text.size() / 4);
+
+    // Truncated or damaged input is rejected, never overruns.
+    std::string out(text.size(), '\0');
+    BOOST_CHECK(!lz_decompress(packed.data(), packed.size() / 2, &out[0], out.size()));
+    BOOST_CHECK(!lz_decompress(packed.data(), packed.size(), &out[0], out.size() - 1));
+}
+
+BOOST_AUTO_TEST_CASE( test_compressed_file )
+{
+    std::string data = make_text(1000000) + make_random(300000) + make_text(12345);
+    {
+        compressed_file out(file("data.dz", "wb"), compressed_file::write_mode, 1 << 14);
+        BOOST_REQUIRE(out.is_open());
+        for (std::size_t pos = 0; pos < data.size(); pos += 1000)
+            out.write(data.data() + pos, std::min<std::size_t>(1000, data.size() - pos));
+        BOOST_CHECK(out.size() == data.size());
+        BOOST_CHECK(out.close());
+    }
+
+    compressed_file in(file("data.dz", "rb"), compressed_file::read_mode, 0, 4);
+    BOOST_REQUIRE(in.is_open());
+    BOOST_CHECK(in.size() == data.size());
+    BOOST_CHECK(in.blocks() == (data.size() + (1 << 14) - 1) / (1 << 14));
+
+    std::string back(data.size(), '\0');
+    BOOST_CHECK(in.read(&back[0], back.size()) == data.size());
+    BOOST_CHECK(back == data);
+    BOOST_CHECK(in.read(&back[0], 1) == 0);
+
+    for (std::size_t pos : { 0, 1, 16383, 16384, 500000, 1300000 })
+    {
+        char buf[5000];
+        BOOST_REQUIRE(in.seek(pos));
+        std::size_t n = in.read(buf, sizeof(buf));
+        BOOST_CHECK(n == std::min<std::size_t>(sizeof(buf), data.size() - pos));
+        BOOST_CHECK(std::string(buf, n) == data.substr(pos, n));
+        BOOST_CHECK(in.tell() == pos + n);
+    }
+    BOOST_CHECK(!in.seek(data.size() + 1));
+
+    std::string block;
+    BOOST_CHECK(in.read_block(3, block));
+    BOOST_CHECK(block == data.substr(3 << 14, 1 << 14));
+    BOOST_CHECK(!in.read_block(in.blocks(), block));
+}
+
+BOOST_AUTO_TEST_CASE( test_damaged )
+{
+    std::string data = make_text(100000);
+    {
+        compressed_file out(file("damaged.dz", "wb"), compressed_file::write_mode, 1 << 12);
+        out.write(data);
+    }
+    {
+        // Flip a byte in one of the first blocks.
+        file f("damaged.dz", "r+b");
+        f.seek(12 + (1 << 10) + 100, file::begin);
+        char c = 0;
+        f.read(&c, 1, 1);
+        c ^= 0x55;
+        f.seek(-1, file::current);
+        f.write(&c, 1, 1);
+        f.flush();
+    }
+
+    compressed_file in(file("damaged.dz", "rb"), compressed_file::read_mode);
+    BOOST_REQUIRE(in.is_open());
+    std::string back(data.size(), '\0');
+    std::size_t n = in.read(&back[0], back.size());
+    BOOST_CHECK(n < data.size());
+    BOOST_CHECK(back.substr(0, n) == data.substr(0, n));
+
+    // Reading stops at the damaged block, the other blocks stay readable.
+    std::string block;
+    BOOST_CHECK(in.read_block(in.blocks() - 1, block));
+}
+
+BOOST_AUTO_TEST_CASE( test_missing_footer )
+{
+    {
+        file f("nofooter.dz", "wb");
+        f.write("DNYZ", 1, 4);
+        f.flush();
+    }
+    compressed_file in(file("nofooter.dz", "rb"), compressed_file::read_mode);
+    BOOST_CHECK(!in.is_open());
+}
+
+// Overwrite n bytes at offset from the end of the file.
+static void patch_tail(const char* filename, long offset, const void* p, std::size_t n)
+{
+    file f(filename, "r+b");
+    f.seek(-offset, file::end);
+    f.write(p, 1, n);
+    f.flush();
+}
+
+BOOST_AUTO_TEST_CASE( test_damaged_index )
+{
+    std::string data = make_text(10000);
+    for (const char* name : { "count.dz", "offset.dz", "entry.dz" })
+    {
+        compressed_file out(file(name, "wb"), compressed_file::write_mode, 1 << 12);
+        out.write(data);
+    }
+
+    // A block count which doesn't match the index size, nothing is allocated.
+    uint64_t nBlocks = uint64_t(1) << 60;
+    patch_tail("count.dz", 20, &nBlocks, 8);
+    compressed_file count(file("count.dz", "rb"), compressed_file::read_mode);
+    BOOST_CHECK(!count.is_open());
+    BOOST_CHECK(count.blocks() == 0);
+
+    uint64_t indexOffset = 1;
+    patch_tail("offset.dz", 12, &indexOffset, 8);
+    compressed_file offset(file("offset.dz", "rb"), compressed_file::read_mode);
+    BOOST_CHECK(!offset.is_open());
+
+    // The last block compresses, stored whole it would run into the index.
+    uint32_t storedSize = 10000 - 2 * (1 << 12);
+    patch_tail("entry.dz", 24, &storedSize, 4);
+    compressed_file entry(file("entry.dz", "rb"), compressed_file::read_mode);
+    BOOST_CHECK(!entry.is_open());
+    BOOST_CHECK(entry.read_block(0, data) == false);
+}
+
+BOOST_AUTO_TEST_CASE( test_write_open_fails )
+{
+    {
+        file f("readonly.dz", "wb");
+    }
+    // The header cannot be written to a file opened for reading.
+    compressed_file out(file("readonly.dz", "rb"), compressed_file::write_mode);
+    BOOST_CHECK(!out.is_open());
+    BOOST_CHECK(out.close());
+}
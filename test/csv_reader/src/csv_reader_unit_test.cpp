@@ -0,0 +1,148 @@
+#define BOOST_TEST_MODULE csv_reader
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <donny/file.hpp>
+#include <donny/csv_reader.hpp>
+
+using namespace donny;
+using namespace donny::filesystem;
+
+static std::vector<std::vector<std::string>> read_rows(csv_reader& csv)
+{
+    std::vector<std::vector<std::string>> rows;
+    std::vector<csv_field> row;
+    while (csv.next_row(row))
+    {
+        rows.push_back(std::vector<std::string>());
+        for (const csv_field& f : row)
+            rows.back().push_back(f.str());
+    }
+    return rows;
+}
+
+BOOST_AUTO_TEST_CASE( test_classify )
+{
+    std::string block;
+    for (int ind = 0; ind < 64; ++ind)
+        block += ",\"\n\tx"[ind % 5];
+    detail::csv_masks expected, m;
+    detail::csv_classify_scalar(block.data(), '"', ',', expected);
+#if DONNY_X86
+    detail::csv_classify_sse2(block.data(), '"', ',', m);
+    BOOST_CHECK(m.quote == expected.quote && m.delim == expected.delim && m.newline == expected.newline);
+    if (cpu().avx2)
+    {
+        detail::csv_classify_avx2(block.data(), '"', ',', m);
+        BOOST_CHECK(m.quote == expected.quote && m.delim == expected.delim && m.newline == expected.newline);
+    }
+#endif
+    BOOST_CHECK(detail::prefix_xor(0x11) == 0x0F);
+}
+
+BOOST_AUTO_TEST_CASE( test_rows )
+{
+    std::string data =
+        "a,b,c\r\n"
+        "1,,\"x,y\"\n"
+        "\n"
+        "\"multi\nline\",\"say \"\"hi\"\"\",3\n"
+        "last,row";
+    csv_reader csv(data.data(), data.size());
+    std::vector<std::vector<std::string>> rows = read_rows(csv);
+    BOOST_REQUIRE(rows.size() == 4);
+    BOOST_CHECK(rows[0] == std::vector<std::string>({ "a", "b", "c" }));
+    BOOST_CHECK(rows[1] == std::vector<std::string>({ "1", "", "x,y" }));
+    BOOST_CHECK(rows[2] == std::vector<std::string>({ "multi\nline", "say \"hi\"", "3" }));
+    BOOST_CHECK(rows[3] == std::vector<std::string>({ "last", "row" }));
+
+    // Quotes spanning 64-byte blocks.
+    std::string longField(150, 'q');
+    longField[70] = ',';
+    longField[130] = '\n';
+    data = "x,\"" + longField + "\",y\nz\n";
+    csv_reader blocks(data.data(), data.size());
+    rows = read_rows(blocks);
+    BOOST_REQUIRE(rows.size() == 2);
+    BOOST_CHECK(rows[0] == std::vector<std::string>({ "x", longField, "y" }));
+
+    data = "a\tb c\td\n";
+    csv_reader tsv(data.data(), data.size());
+    tsv.delimiter('\t');
+    rows = read_rows(tsv);
+    BOOST_REQUIRE(rows.size() == 1);
+    BOOST_CHECK(rows[0] == std::vector<std::string>({ "a", "b c", "d" }));
+}
+
+static std::string make_table(int n, bool bQuoted)
+{
+    std::string s = "id,price,name\n";
+    for (int ind = 0; ind < n; ++ind)
+    {
+        s += std::to_string(ind) + "," + std::to_string(ind) + ".5,";
+        s += bQuoted && ind % 3 == 0 ? "\"item\n" + std::to_string(ind) + "\"" : "item" + std::to_string(ind);
+        s += "\n";
+    }
+    return s;
+}
+
+BOOST_AUTO_TEST_CASE( test_columns )
+{
+    for (bool bQuoted : { false, true })
+        for (unsigned nThreads : { 1, 4 })
+        {
+            const int n = 20000;
+            std::string data = make_table(n, bQuoted);
+            csv_reader csv(data.data(), data.size());
+            std::vector<int64_t> id;
+            std::vector<double> price;
+            std::vector<std::string> name;
+            csv.header(true).column("price", price).column(0, id).column("name", name);
+            BOOST_CHECK(csv.column_names() == std::vector<std::string>({ "id", "price", "name" }));
+
+            BOOST_REQUIRE(csv.read_columns(nThreads) == (std::size_t)n);
+            BOOST_CHECK(csv.errors() == 0);
+            bool bOk = true;
+            for (int ind = 0; ind < n; ++ind)
+            {
+                std::string expected = bQuoted && ind % 3 == 0 ? "item\n" + std::to_string(ind)
+                                                              : "item" + std::to_string(ind);
+                bOk = bOk && id[ind] == ind && price[ind] == ind + 0.5 && name[ind] == expected;
+            }
+            BOOST_CHECK(bOk);
+        }
+
+    std::string bad = "a,b\n1,2\nx,3\n4\n";
+    csv_reader csv(bad.data(), bad.size());
+    std::vector<int> a, b;
+    csv.header(true).column("a", a).column("b", b);
+    BOOST_CHECK(csv.read_columns() == 3);
+    BOOST_CHECK(csv.errors() == 2); // "x" and the missing field
+    BOOST_CHECK(a == std::vector<int>({ 1, 0, 4 }));
+    BOOST_CHECK(b == std::vector<int>({ 2, 3, 0 }));
+
+    std::vector<int> none;
+    csv.column("nope", none);
+    BOOST_CHECK_THROW(csv.read_columns(), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( test_file )
+{
+    std::string data = make_table(1000, true);
+    {
+        file f("table.csv", "wb");
+        f.write(data.data(), 1, data.size());
+        f.flush();
+    }
+    csv_reader csv(file("table.csv", "rb"));
+    csv.header(true);
+    std::vector<double> price;
+    csv.column("price", price);
+    BOOST_CHECK(csv.read_columns() == 1000);
+    BOOST_CHECK(price[999] == 999.5);
+}
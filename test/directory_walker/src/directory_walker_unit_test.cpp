@@ -0,0 +1,187 @@
+#define BOOST_TEST_MODULE directory_walker
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include <sys/resource.h>
+
+#include <donny/directory_walker.hpp>
+#include <donny/file.hpp>
+
+using namespace donny::filesystem;
+
+static void write_file(const std::string& path, const std::string& content)
+{
+    file f(path.c_str(), "wb");
+    f.puts(content);
+    f.flush();
+}
+
+// Build tree:
+//   root/a.log root/b.txt
+//   root/d0/{0.log, 1.log, 2.log}, root/d1/..., root/d2/...
+//   root/d0/sub/deep.log
+static std::string make_tree()
+{
+    char tmpl[] = "/tmp/donny_walker_XXXXXX";
+    std::string root = mkdtemp(tmpl);
+
+    write_file(root + "/a.log", "a");
+    write_file(root + "/b.txt", "b");
+    for (int d = 0; d < 3; ++d)
+    {
+        std::string dir = root + "/d" + std::to_string(d);
+        mkdir(dir.c_str(), 0755);
+        for (int f = 0; f < 3; ++f)
+            write_file(dir + "/" + std::to_string(f) + ".log", "x");
+    }
+    mkdir(std::string(root + "/d0/sub").c_str(), 0755);
+    write_file(root + "/d0/sub/deep.log", "deep");
+    return root;
+}
+
+static void remove_tree(const std::string& root)
+{
+    std::string cmd = "rm -rf " + root;
+    BOOST_REQUIRE(system(cmd.c_str()) == 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_walk_all )
+{
+    std::string root = make_tree();
+
+    std::mutex mutex;
+    std::set<std::string> paths;
+    directory_walker walker;
+    std::size_t n = walker.threads(4).walk(root, [&](const directory_entry& e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        paths.insert(e.path);
+    });
+
+    // 2 files + 3 dirs + 9 files + 1 dir + 1 file
+    BOOST_CHECK(n == 16);
+    BOOST_CHECK(paths.size() == 16);
+    BOOST_CHECK(paths.count(root + "/d0/sub/deep.log") == 1);
+    BOOST_CHECK(walker.errors() == 0);
+
+    remove_tree(root);
+}
+
+BOOST_AUTO_TEST_CASE( test_filter_and_depth )
+{
+    std::string root = make_tree();
+
+    directory_walker walker;
+    walker.filter([](const directory_entry& e) {
+        return e.is_regular_file() && e.name.size() > 4 &&
+            e.name.compare(e.name.size() - 4, 4, ".log") == 0;
+    });
+
+    std::atomic<std::size_t> nBytes(0);
+    std::atomic<std::size_t> nNoStatus(0);
+    std::size_t n = walker.walk(root, [&](const directory_entry& e) {
+        if (!e.bHasStatus) ++nNoStatus;
+        nBytes += e.status.st_size;
+    });
+    BOOST_CHECK(n == 11);
+    BOOST_CHECK(nNoStatus == 0);
+    BOOST_CHECK(nBytes == 1 + 9 + 4);
+
+    std::atomic<int> maxDepth(0);
+    n = walker.max_depth(2).walk(root, [&](const directory_entry& e) {
+        int d = maxDepth;
+        while (e.depth > d && !maxDepth.compare_exchange_weak(d, e.depth)) {}
+    });
+    BOOST_CHECK(n == 10);
+    BOOST_CHECK(maxDepth == 2);
+
+    n = walker.max_depth(-1)
+        .descend_if([](const directory_entry& e) { return e.name != "d0"; })
+        .walk(root, [](const directory_entry&) {});
+    BOOST_CHECK(n == 7);
+
+    remove_tree(root);
+}
+
+BOOST_AUTO_TEST_CASE( test_walk_queue )
+{
+    std::string root = make_tree();
+
+    donny::bounded_queue<directory_entry> queue(2);
+    directory_walker walker;
+    std::future<std::size_t> result = walker.stat(false).walk_async(root, queue);
+
+    std::size_t nPopped = 0;
+    directory_entry e;
+    while (queue.pop(e))
+        ++nPopped;
+
+    BOOST_CHECK(result.get() == 16);
+    BOOST_CHECK(nPopped == 16);
+
+    remove_tree(root);
+}
+
+BOOST_AUTO_TEST_CASE( test_close_queue )
+{
+    std::string root = make_tree();
+
+    // Closing the queue stops the walk in the directory being read.
+    donny::bounded_queue<directory_entry> queue(1);
+    directory_walker walker;
+    std::future<std::size_t> result = walker.threads(1).walk_async(root, queue);
+
+    directory_entry e;
+    BOOST_CHECK(queue.pop(e));
+    queue.close();
+    BOOST_CHECK(result.get() <= 5);
+
+    remove_tree(root);
+}
+
+static rlim_t open_fds()
+{
+    rlim_t n = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    BOOST_REQUIRE(dir != nullptr);
+    while (readdir(dir)) ++n;
+    closedir(dir);
+    return n;
+}
+
+BOOST_AUTO_TEST_CASE( test_few_fds )
+{
+    // 60 levels of root/n/n/..., each with the empty directories a, b, c,
+    // which keep their parent open until they are walked.
+    char tmpl[] = "/tmp/donny_walker_XXXXXX";
+    std::string root = mkdtemp(tmpl);
+    std::string dir = root;
+    for (int level = 0; level < 60; ++level)
+    {
+        for (const char* name : { "/a", "/b", "/c" })
+            mkdir((dir + name).c_str(), 0755);
+        dir += "/n";
+        mkdir(dir.c_str(), 0755);
+    }
+
+    struct rlimit saved, limit;
+    BOOST_REQUIRE(getrlimit(RLIMIT_NOFILE, &saved) == 0);
+    limit = saved;
+    // Leave 24 fds free, whatever is already open.
+    limit.rlim_cur = open_fds() + 24;
+    BOOST_REQUIRE(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+    directory_walker walker;
+    std::size_t n = walker.threads(1).walk(root, [](const directory_entry&) {});
+    setrlimit(RLIMIT_NOFILE, &saved);
+
+    BOOST_CHECK(n == 60 * 4);
+    BOOST_CHECK(walker.errors() == 0);
+
+    remove_tree(root);
+}
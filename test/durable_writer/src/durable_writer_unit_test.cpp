@@ -0,0 +1,113 @@
+#define BOOST_TEST_MODULE durable_writer
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <donny/durable_writer.hpp>
+
+using namespace donny;
+using namespace donny::filesystem;
+
+static std::string read_all(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+BOOST_AUTO_TEST_CASE( test_group_commit )
+{
+    const int nThreads = 8, nPerThread = 200;
+    std::atomic<int> nFailed(0);
+    {
+        durable_writer writer(file("audit.log", "wb"));
+        BOOST_REQUIRE(writer.is_open());
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < nThreads; ++t)
+            threads.emplace_back([&, t]() {
+                for (int ind = 0; ind < nPerThread; ++ind)
+                {
+                    std::string line = std::to_string(t) + ":" + std::to_string(ind) + "\n";
+                    if (!writer.write(line)) ++nFailed;
+                }
+            });
+        for (std::thread& t : threads)
+            t.join();
+
+        BOOST_CHECK(writer.records() == (std::size_t)(nThreads * nPerThread));
+        BOOST_CHECK(writer.commits() <= writer.records());
+    }
+    BOOST_CHECK(nFailed == 0);
+
+    std::vector<std::string> lines;
+    std::istringstream in(read_all("audit.log"));
+    for (std::string line; std::getline(in, line); )
+        lines.push_back(line);
+    BOOST_REQUIRE(lines.size() == (std::size_t)(nThreads * nPerThread));
+
+    // Every record once, each thread's records in order.
+    std::vector<int> next(nThreads, 0);
+    for (const std::string& line : lines)
+    {
+        int t = std::stoi(line);
+        int ind = std::stoi(line.substr(line.find(':') + 1));
+        BOOST_CHECK(ind == next[t]);
+        next[t] = ind + 1;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_futures )
+{
+    std::vector<std::future<bool>> done;
+    durable_writer writer(std::string("futures.log"), 64);
+    for (int ind = 0; ind < 100; ++ind)
+        done.push_back(writer.submit("record " + std::to_string(ind) + "\n"));
+    for (std::future<bool>& f : done)
+        BOOST_CHECK(f.get());
+    writer.close();
+    BOOST_CHECK(!writer.submit("late", 4).get());
+    BOOST_CHECK(read_all("futures.log").find("record 99\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( test_atomic_write_file )
+{
+    BOOST_CHECK(atomic_write_file("config.txt", "first"));
+    BOOST_CHECK(read_all("config.txt") == "first");
+    BOOST_CHECK(atomic_write_file("config.txt", std::string(10000, 'x')));
+    BOOST_CHECK(read_all("config.txt") == std::string(10000, 'x'));
+    BOOST_CHECK(sync_directory("."));
+
+    BOOST_CHECK(!atomic_write_file("no/such/dir/config.txt", "data"));
+
+    // The replacement keeps the permissions of the file it replaces.
+    BOOST_REQUIRE(chmod("config.txt", 0640) == 0);
+    BOOST_CHECK(atomic_write_file("config.txt", "second"));
+    struct stat st;
+    BOOST_REQUIRE(stat("config.txt", &st) == 0);
+    BOOST_CHECK((st.st_mode & 07777) == 0640);
+
+    // Threads replacing the same file each leave a whole version.
+    std::vector<std::thread> threads;
+    std::atomic<int> nFailed(0);
+    for (int t = 0; t < 8; ++t)
+        threads.emplace_back([t, &nFailed]() {
+            for (int ind = 0; ind < 50; ++ind)
+                if (!atomic_write_file("shared.txt", std::string(4096 + ind, (char)('a' + t))))
+                    ++nFailed;
+        });
+    for (std::thread& th : threads)
+        th.join();
+    BOOST_CHECK(nFailed == 0);
+    std::string content = read_all("shared.txt");
+    BOOST_CHECK(content.size() >= 4096 &&
+                content == std::string(content.size(), content[0]));
+}
@@ -0,0 +1,136 @@
+#define BOOST_TEST_MODULE external_sort
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <donny/external_sort.hpp>
+
+using namespace donny;
+using namespace donny::filesystem;
+
+static std::string read_all(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static void write_all(const std::string& filename, const std::string& data)
+{
+    std::ofstream out(filename, std::ios::binary);
+    out << data;
+}
+
+static std::vector<std::string> make_lines(int n)
+{
+    std::mt19937 gen(7);
+    std::vector<std::string> lines;
+    for (int ind = 0; ind < n; ++ind)
+        lines.push_back(std::string(gen() % 40, 'a' + gen() % 3) + std::to_string(gen()));
+    return lines;
+}
+
+static std::string join(const std::vector<std::string>& lines)
+{
+    std::string s;
+    for (const std::string& line : lines)
+        s += line + "\n";
+    return s;
+}
+
+BOOST_AUTO_TEST_CASE( test_loser_tree )
+{
+    std::vector<std::vector<int>> sources = { { 1, 4, 9 }, { 2, 3 }, {}, { 0, 5, 6, 7 }, { 8 } };
+    std::vector<std::size_t> pos(sources.size(), 0);
+    auto less = [&](int a, int b) {
+        if (pos[a] == sources[a].size()) return false;
+        if (pos[b] == sources[b].size()) return true;
+        return sources[a][pos[a]] < sources[b][pos[b]];
+    };
+    detail::loser_tree<decltype(less)> tree((int)sources.size(), less);
+    std::vector<int> merged;
+    for (;;)
+    {
+        const int w = tree.winner();
+        if (pos[w] == sources[w].size()) break;
+        merged.push_back(sources[w][pos[w]]);
+        ++pos[w];
+        tree.replay();
+    }
+    BOOST_CHECK(merged == std::vector<int>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+}
+
+BOOST_AUTO_TEST_CASE( test_sort_lines )
+{
+    std::vector<std::string> lines = make_lines(50000);
+    write_all("lines.txt", join(lines));
+    std::sort(lines.begin(), lines.end());
+
+    // Small budget and fan-in, to get many runs and intermediate merges.
+    external_sorter sorter;
+    sorter.memory(1 << 16).threads(4).fan_in(3).temp_directory(".");
+    BOOST_CHECK(sorter.sort_lines(file("lines.txt", "rb"), file("sorted.txt", "wb")) == lines.size());
+    BOOST_CHECK(read_all("sorted.txt") == join(lines));
+
+    // Everything in memory, descending, no trailing newline in the input.
+    std::string input = join(lines);
+    input.pop_back();
+    write_all("lines.txt", input);
+    external_sorter big;
+    std::size_t n = big.sort_lines(file("lines.txt", "rb"), file("sorted.txt", "wb"),
+        [](const char* a, std::size_t na, const char* b, std::size_t nb) {
+            return std::string(b, nb) < std::string(a, na);
+        });
+    BOOST_CHECK(n == lines.size());
+    std::reverse(lines.begin(), lines.end());
+    BOOST_CHECK(read_all("sorted.txt") == join(lines));
+
+    write_all("empty.txt", "");
+    BOOST_CHECK(big.sort_lines(file("empty.txt", "rb"), file("sorted.txt", "wb")) == 0);
+    BOOST_CHECK(read_all("sorted.txt").empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_sort_records )
+{
+    struct record { uint64_t key; uint64_t value; };
+    std::mt19937_64 gen(11);
+    std::vector<record> records(100000);
+    for (std::size_t ind = 0; ind < records.size(); ++ind)
+        records[ind] = record{ gen() % 1000, ind };
+    write_all("records.bin", std::string((const char*)records.data(), records.size() * sizeof(record)));
+
+    external_sorter sorter;
+    sorter.memory(1 << 18).threads(3);
+    std::size_t n = sorter.sort_records(file("records.bin", "rb"), file("sorted.bin", "wb"), sizeof(record),
+        [](const char* a, const char* b) {
+            uint64_t ka, kb;
+            memcpy(&ka, a, 8);
+            memcpy(&kb, b, 8);
+            return ka < kb;
+        });
+    BOOST_CHECK(n == records.size());
+
+    std::string sorted = read_all("sorted.bin");
+    BOOST_REQUIRE(sorted.size() == records.size() * sizeof(record));
+    std::vector<record> back(records.size());
+    memcpy(back.data(), sorted.data(), sorted.size());
+    BOOST_CHECK(std::is_sorted(back.begin(), back.end(),
+        [](const record& a, const record& b) { return a.key < b.key; }));
+    uint64_t sum = 0;
+    for (const record& r : back) sum += r.value;
+    BOOST_CHECK(sum == (uint64_t)records.size() * (records.size() - 1) / 2);
+
+    write_all("odd.bin", std::string(17, 'x'));
+    BOOST_CHECK_THROW(sorter.sort_records(file("odd.bin", "rb"), file("sorted.bin", "wb"), 16),
+                      std::runtime_error);
+}
@@ -130,3 +130,51 @@ BOOST_AUTO_TEST_CASE( writeu16file )
 //     readfile();
 //     return 0;
 // }
+
+BOOST_AUTO_TEST_CASE( access_advice )
+{
+    string data(3 << 20, 'x');
+    for (size_t ind = 0; ind < data.size(); ind += 4096)
+        data[ind] = (char)('a' + ind / 4096 % 26);
+    ofstream ofs("advice.bin", ios_base::binary);
+    ofs << data;
+    ofs.close();
+
+    file ifs("advice.bin", "rb");
+    BOOST_CHECK(ifs.advise(file::random_access));
+    BOOST_CHECK(ifs.advise(file::will_need, 0, 1 << 20));
+    BOOST_CHECK(ifs.readahead(1 << 20, 1 << 20));
+    BOOST_CHECK(ifs.advise(file::normal_access));
+
+    // Drop behind doesn't change what is read.
+    BOOST_CHECK(ifs.drop_behind(true, 1 << 20));
+    string back(data.size(), '\0');
+    for (size_t pos = 0; pos < back.size(); pos += 10000)
+        ifs.read(&back[pos], 1, min<size_t>(10000, back.size() - pos));
+    BOOST_CHECK(back == data);
+    BOOST_CHECK(ifs.drop_behind(false));
+    ifs.close();
+
+    file closed;
+    BOOST_CHECK(!closed.advise(file::sequential_access));
+}
+
+BOOST_AUTO_TEST_CASE( drop_behind_lines )
+{
+    string data;
+    for (int ind = 0; data.size() < (2 << 20); ++ind)
+        data += "line " + to_string(ind) + "\n";
+    ofstream ofs("lines.txt", ios_base::binary);
+    ofs << data;
+    ofs.close();
+
+    // Reading lines moves the drop behind position as read() does.
+    file ifs("lines.txt", "rb");
+    BOOST_CHECK(ifs.drop_behind(true, 1 << 16));
+    string back;
+    for (string line; !(line = ifs.gets('\n')).empty(); )
+        back += line;
+    BOOST_CHECK(back == data);
+    BOOST_CHECK(ifs.tell() == (long)data.size());
+    ifs.close();
+}
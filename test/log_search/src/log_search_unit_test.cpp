@@ -0,0 +1,207 @@
+#define BOOST_TEST_MODULE log_search
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <donny/log_search.hpp>
+
+using namespace donny;
+using namespace donny::filesystem;
+
+BOOST_AUTO_TEST_CASE( test_find_substring )
+{
+    std::mt19937 gen(3);
+    std::string hay(5000, 'a');
+    for (char& c : hay) c = 'a' + gen() % 4;
+    for (std::size_t m : { 1, 2, 3, 5, 17, 40 })
+        for (int trial = 0; trial < 50; ++trial)
+        {
+            std::string needle(m, 'a');
+            for (char& c : needle) c = 'a' + gen() % 4;
+            std::size_t expected = hay.find(needle);
+            const char* hit = find_substring(hay.data(), hay.size(), needle.data(), m);
+            BOOST_CHECK((hit ? (std::size_t)(hit - hay.data()) : std::string::npos) == expected);
+#if DONNY_X86
+            if (m >= 2)
+            {
+                const char* sse = detail::find_substring_sse2(hay.data(), hay.size(), needle.data(), m);
+                BOOST_CHECK(sse == hit);
+                if (cpu().avx2)
+                    BOOST_CHECK(detail::find_substring_avx2(hay.data(), hay.size(), needle.data(), m) == hit);
+            }
+#endif
+        }
+    BOOST_CHECK(find_substring("abc", 3, "abcd", 4) == nullptr);
+}
+
+// One line every 10 seconds from t0, in logger's format.
+static const time_t t0 = 1700000000;
+static std::string make_log(int n)
+{
+    std::string log;
+    for (int ind = 0; ind < n; ++ind)
+    {
+        time_t t = t0 + ind * 10;
+        std::string ts = datetime::getUTCTime(gmtime(&t), "[%a %b %d %T %Y]");
+        const char* level = (ind % 7 == 0) ? "[ERR] " : "[INFO] ";
+        log += ts + level + "request " + std::to_string(ind) + (ind % 5 == 0 ? " timeout" : " ok") + "\n";
+        if (ind % 11 == 0) log += "    continuation without timestamp\n";
+    }
+    return log;
+}
+
+static std::vector<std::string> collect(const log_search& search, const std::string& data)
+{
+    std::vector<std::string> lines;
+    search.search(data.data(), data.size(), [&](const char* line, std::size_t len) {
+        lines.push_back(std::string(line, len));
+    });
+    return lines;
+}
+
+BOOST_AUTO_TEST_CASE( test_search )
+{
+    const int n = 1000;
+    std::string log = make_log(n);
+
+    log_search errors;
+    errors.level(logger<char>::ERR);
+    BOOST_CHECK(collect(errors, log).size() == (n + 6) / 7);
+
+    log_search timeouts;
+    timeouts.contains("timeout");
+    BOOST_CHECK(collect(timeouts, log).size() == (n + 4) / 5);
+
+    log_search both;
+    both.level(logger<char>::ERR).contains("timeout");
+    std::vector<std::string> lines = collect(both, log);
+    BOOST_CHECK(lines.size() == (n + 34) / 35);
+    BOOST_CHECK(lines[1].find("[ERR] request 35 timeout\n") != std::string::npos);
+
+    // "request 1" also matches in request 10, 100...; only once per line.
+    log_search literal;
+    literal.contains("request 1");
+    BOOST_CHECK(collect(literal, log).size() == 1 + 10 + 100);
+}
+
+BOOST_AUTO_TEST_CASE( test_time_range )
+{
+    const int n = 1000;
+    std::string log = make_log(n);
+
+    log_search range;
+    BOOST_CHECK(range.timestamp(log.data(), log.size()) == t0);
+    range.since(t0 + 100).until(t0 + 200);
+    std::vector<std::string> lines = collect(range, log);
+    // Lines 10..19, and the continuation of line 11.
+    BOOST_REQUIRE(lines.size() == 11);
+    BOOST_CHECK(lines[0].find("request 10 timeout") != std::string::npos);
+    BOOST_CHECK(lines.back().find("request 19 ok") != std::string::npos);
+
+    log_search after;
+    after.since(t0 + 5).contains("request 99");
+    BOOST_CHECK(collect(after, log).size() == 11);
+
+    log_search none;
+    none.since(t0 + n * 10);
+    BOOST_CHECK(collect(none, log).empty());
+    none.since(t0 - 100).until(t0);
+    BOOST_CHECK(collect(none, log).empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_files )
+{
+    std::string log = make_log(3000);
+    {
+        file f("service.log", "wb");
+        f.write(log.data(), 1, log.size());
+        f.flush();
+    }
+    log_search search;
+    search.contains("timeout").since(t0 + 1000);
+    std::size_t expected = collect(search, log).size();
+    BOOST_CHECK(search.search(std::string("service.log"), [](const char*, std::size_t) {}) == (long)expected);
+    BOOST_CHECK(search.search(std::string("no_such.log"), [](const char*, std::size_t) {}) == -1);
+
+    {
+        compressed_file out(file("service.log.dz", "wb"), compressed_file::write_mode, 4096);
+        out.write(log);
+    }
+    compressed_file in(file("service.log.dz", "rb"), compressed_file::read_mode);
+    std::vector<std::string> lines;
+    search.search(in, [&](const char* line, std::size_t len) { lines.push_back(std::string(line, len)); });
+    BOOST_CHECK(lines == collect(search, log));
+}
+
+BOOST_AUTO_TEST_CASE( test_follow )
+{
+    {
+        file f("follow.log", "wb");
+        f.puts("[INFO] first\n[ERR] second\n");
+        f.flush();
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> nErrors(0);
+    log_search search;
+    search.level(logger<char>::ERR);
+    std::thread follower([&]() {
+        search.follow("follow.log", [&](const char*, std::size_t) { ++nErrors; },
+                      stop, std::chrono::milliseconds(5));
+    });
+
+    file f("follow.log", "ab");
+    f.puts("[ERR] third");
+    f.flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int nBeforeNewLine = nErrors;
+    f.puts("\n[INFO] fourth\n");
+    f.flush();
+    for (int wait = 0; wait < 200 && nErrors < 2; ++wait)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    stop = true;
+    follower.join();
+
+    BOOST_CHECK(nBeforeNewLine == 1); // the third line wasn't complete
+    BOOST_CHECK(nErrors == 2);
+}
+
+BOOST_AUTO_TEST_CASE( test_follow_chunks )
+{
+    // Several times the read size, with lines across the chunk boundaries.
+    int nExpected = 0;
+    {
+        file f("follow_big.log", "wb");
+        for (int ind = 0; ind < 20000; ++ind)
+        {
+            bool bErr = (ind % 7 == 0);
+            nExpected += bErr;
+            f.puts(std::string(bErr ? "[ERR] " : "[INFO] ") + "line " +
+                   std::to_string(ind) + std::string(ind % 13, '.') + "\n");
+        }
+        f.puts(std::string("[ERR] ") + std::string(200000, 'x') + "\n");
+        ++nExpected;
+        f.flush();
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> nErrors(0);
+    log_search search;
+    search.level(logger<char>::ERR);
+    std::thread follower([&]() {
+        search.follow("follow_big.log", [&](const char*, std::size_t) { ++nErrors; },
+                      stop, std::chrono::milliseconds(5));
+    });
+    for (int wait = 0; wait < 500 && nErrors < nExpected; ++wait)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    stop = true;
+    follower.join();
+
+    BOOST_CHECK_EQUAL(nErrors, nExpected);
+}
@@ -6,6 +6,7 @@
 #include <boost/test/minimal.hpp>
 
 #include <donny/logger.hpp>
+#include <donny/memory_file.hpp>
 
 using namespace donny::filesystem;
 
@@ -138,12 +139,108 @@ int pressure_test()
     return 0;
 }
 
+int disabled_level_test()
+{
+    using namespace std::chrono;
+
+    file logfile("disabled-test.txt", "w");
+    donny::logger<> log(logfile);
+    log.enableLogLevel(donny::logger<>::DEB, false);
+
+    BOOST_CHECK( !log.d().enabled() );
+
+    const ulong times = 9999999L;
+    auto tb = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    for (ulong i = 0; i < times; ++i)
+        log.d() << i << " messages " << 1.0 / (i + 1) << endl;
+    auto te = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    logfile.flush();
+
+    BOOST_CHECK( ftell(logfile.getFILE()) == 0 );
+    printf("Skipped %lu disabled messages in %ld ms.\n", times, te - tb);
+
+    // The stream can still be kept as an lvalue, disabled or not.
+    donny::logger<>::logger_stream& deb = log.d();
+    deb << "discarded" << endl;
+    logfile.flush();
+    BOOST_CHECK( ftell(logfile.getFILE()) == 0 );
+    donny::logger<>::logger_stream& info = log.i();
+    info << "kept" << endl;
+    logfile.flush();
+    BOOST_CHECK( ftell(logfile.getFILE()) > 0 );
+
+    return 0;
+}
+
+int structured_test()
+{
+    using donny::kv;
+    using logger = donny::logger<>;
+
+    memory_file out;
+    logger log(out);
+    log.useTimeStamp(false);
+
+    log.setRecordFormat(logger::JSON);
+    log.i("request done", kv("user", 42), kv("latency_us", 12.5), kv("ok", true));
+    log.e("say \"hi\"\n", kv("path", std::string("C:\\tmp")), kv("neg", -7L));
+    log.d("formatted %d", 3);
+    log.setPrefix(logger::VERB, "<trace>");
+    log.v("custom", kv("ctl", "\x01\t"));
+    BOOST_CHECK( out.str() ==
+        "{\"level\":\"INFO\",\"msg\":\"request done\",\"user\":42,\"latency_us\":12.5,\"ok\":true}\n"
+        "{\"level\":\"ERR\",\"msg\":\"say \\\"hi\\\"\\n\",\"path\":\"C:\\\\tmp\",\"neg\":-7}\n"
+        "{\"level\":\"DEB\",\"msg\":\"formatted 3\"}\n"
+        "{\"level\":\"<trace>\",\"msg\":\"custom\",\"ctl\":\"\\u0001\\t\"}\n" );
+
+    memory_file out2;
+    logger log2(out2);
+    log2.useTimeStamp(false);
+    log2.setRecordFormat(logger::LOGFMT);
+    log2.i("request done", kv("user", "bob"), kv("q", "a=b c"), kv("empty", ""), kv("r", 0.1));
+    BOOST_CHECK( out2.str() ==
+        "level=INFO msg=\"request done\" user=bob q=\"a=b c\" empty=\"\" r=0.1\n" );
+
+    // Fields still work with the printf style line.
+    memory_file out3;
+    logger log3(out3);
+    log3.useTimeStamp(false);
+    log3.i("plain", kv("n", 1u));
+    log3.i("%s", "classic");
+    BOOST_CHECK( out3.str() == "[INFO] plain n=1\n[INFO] classic\n" );
+
+    // Timestamps become an ISO 8601 ts field.
+    memory_file out4;
+    logger log4(out4);
+    log4.setRecordFormat(logger::JSON);
+    log4.i("t");
+    std::string rec = out4.str();
+    BOOST_CHECK( rec.compare(0, 7, "{\"ts\":\"") == 0 );
+    BOOST_CHECK( rec.size() > 28 && rec[17] == 'T' && rec[26] == 'Z' );
+
+    // Long strings go through the SIMD scan.
+    std::string longValue(1000, 'x');
+    longValue[700] = '"';
+    memory_file out5;
+    logger log5(out5);
+    log5.useTimeStamp(false);
+    log5.setRecordFormat(logger::JSON);
+    log5.i("m", kv("v", longValue));
+    std::string expected = "{\"level\":\"INFO\",\"msg\":\"m\",\"v\":\""
+        + std::string(700, 'x') + "\\\"" + std::string(299, 'x') + "\"}\n";
+    BOOST_CHECK( out5.str() == expected );
+
+    return 0;
+}
+
 int test_main(int, char**)
 {
     test_logger();
     test_wlogger();
     test_screen_logger();
     pressure_test();
+    disabled_level_test();
+    structured_test();
 
     return 0;
 }
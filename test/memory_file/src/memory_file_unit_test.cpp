@@ -0,0 +1,74 @@
+#define BOOST_TEST_MODULE memory_file
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <string>
+
+#include <donny/memory_file.hpp>
+
+using namespace donny;
+using namespace donny::filesystem;
+
+BOOST_AUTO_TEST_CASE( test_memory_file )
+{
+    memory_file f;
+    BOOST_REQUIRE(f.is_open());
+    BOOST_CHECK(f.size() == 0);
+
+    f.print("%d %s\n", 42, "hello");
+    f.puts("second line\n");
+    BOOST_CHECK(f.size() == 21);
+    BOOST_CHECK(f.str() == "42 hello\nsecond line\n");
+    BOOST_CHECK(!f.spilled());
+
+    BOOST_CHECK(f.seek(0, file::begin));
+    BOOST_CHECK(f.gets('\n') == "42 hello\n");
+    BOOST_CHECK(f.tell() == 9);
+    char buf[6] = { 0 };
+    BOOST_CHECK(f.read(buf, 1, 6) == 6);
+    BOOST_CHECK(std::string(buf, 6) == "second");
+
+    // Overwrite in place, then write past the end.
+    BOOST_CHECK(f.seek(0, file::begin));
+    f.write("XY", 1, 2);
+    BOOST_CHECK(f.seek(4, file::end));
+    f.write("!", 1, 1);
+    std::string s = f.str();
+    BOOST_CHECK(s.size() == 26);
+    BOOST_CHECK(s.compare(0, 9, "XY hello\n") == 0);
+    BOOST_CHECK(s.substr(21) == std::string(4, '\0') + "!");
+
+    // Copies share the content.
+    file other = f;
+    BOOST_CHECK(other.seek(0, file::begin));
+    BOOST_CHECK(other.getc() == 'X');
+}
+
+BOOST_AUTO_TEST_CASE( test_spool )
+{
+    memory_file spool = memory_file::spool(1000);
+    std::string expected;
+    for (int ind = 0; ind < 300; ++ind)
+    {
+        std::string line = "line " + std::to_string(ind) + "\n";
+        spool.puts(line);
+        expected += line;
+    }
+    BOOST_CHECK(spool.size() == expected.size());
+    BOOST_CHECK(spool.spilled());
+    BOOST_CHECK(spool.str() == expected);
+
+    BOOST_CHECK(spool.seek(0, file::begin));
+    std::string back;
+    for (std::string line; !(line = spool.gets('\n')).empty(); )
+        back += line;
+    BOOST_CHECK(back == expected);
+
+    BOOST_CHECK(spool.seek(-9, file::end));
+    BOOST_CHECK(spool.gets('\n') == "line 299\n");
+
+    memory_file small = memory_file::spool(1000);
+    small.puts(expected.substr(0, 500));
+    BOOST_CHECK(small.size() == 500);
+    BOOST_CHECK(!small.spilled());
+}
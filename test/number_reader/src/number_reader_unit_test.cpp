@@ -0,0 +1,146 @@
+#define BOOST_TEST_MODULE number_reader
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <donny/number_reader.hpp>
+
+using namespace donny;
+using donny::filesystem::file;
+
+static double parse(const std::string& s)
+{
+    double v = -1;
+    const char* end = parse_float(s.data(), s.data() + s.size(), v);
+    BOOST_CHECK(end == s.data() + s.size());
+    return v;
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_integer )
+{
+    std::string s = "-9223372036854775808 9223372036854775808 255 256 -1";
+    const char* p = s.data();
+    const char* end = s.data() + s.size();
+
+    long long ll = 0;
+    p = parse_integer(p, end, ll);
+    BOOST_CHECK(ll == std::numeric_limits<long long>::min());
+
+    p = skip_delimiters(p, end);
+    BOOST_CHECK(parse_integer(p, end, ll) == p); // overflow
+    unsigned long long ull = 0;
+    p = parse_integer(p, end, ull);
+    BOOST_CHECK(ull == 9223372036854775808ull);
+
+    unsigned char uc = 0;
+    p = parse_integer(skip_delimiters(p, end), end, uc);
+    BOOST_CHECK(uc == 255);
+    p = skip_delimiters(p, end);
+    BOOST_CHECK(parse_integer(p, end, uc) == p);
+    p += 4;
+    BOOST_CHECK(parse_integer(p, end, ull) == p); // negative unsigned
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_float )
+{
+    BOOST_CHECK(parse("0") == 0.0);
+    BOOST_CHECK(parse("-0.0") == 0.0);
+    BOOST_CHECK(parse("1.34") == 1.34);
+    BOOST_CHECK(parse(".5") == 0.5);
+    BOOST_CHECK(parse("1e22") == 1e22);
+    BOOST_CHECK(parse("1e23") == 1e23);
+    BOOST_CHECK(parse("2.2250738585072014e-308") == 2.2250738585072014e-308);
+    BOOST_CHECK(parse("123456789012345678901234567890") == 123456789012345678901234567890.0);
+    BOOST_CHECK(parse("0.000000000000000000000000123") == 0.000000000000000000000000123);
+    BOOST_CHECK(parse("inf") == std::numeric_limits<double>::infinity());
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1e6, 1e6);
+    const char* formats[] = { "%.17g", "%g", "%f", "%.3f", "%e" };
+    char buf[64];
+    for (int ind = 0; ind < 20000; ++ind)
+    {
+        double x = dist(rng);
+        snprintf(buf, sizeof(buf), formats[ind % length_of_array(formats)], x);
+        double expected = strtod(buf, nullptr);
+        double v = parse(buf);
+        BOOST_REQUIRE(v == expected);
+
+        float f = 0;
+        parse_float(buf, buf + strlen(buf), f);
+        BOOST_REQUIRE(f == strtof(buf, nullptr));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_float_locale )
+{
+    // Numbers out of the fast path still use '.' with a ',' locale.
+    const char* names[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8" };
+    bool bSet = false;
+    for (const char* name : names)
+        if ((bSet = (setlocale(LC_NUMERIC, name) != nullptr))) break;
+    if (!bSet)
+    {
+        BOOST_TEST_MESSAGE("no locale with a decimal comma, skipped");
+        return;
+    }
+    BOOST_CHECK(parse("1.5e300") == 1.5e300);
+    BOOST_CHECK(parse("0x1.8p1") == 3.0);
+    BOOST_CHECK(parse("123456789012345678901234567890.5") == 123456789012345678901234567890.5);
+    setlocale(LC_NUMERIC, "C");
+}
+
+BOOST_AUTO_TEST_CASE( test_reader_memory )
+{
+    std::string s = "1, 2,3 ,\n\t 4.5e1,   -6\n";
+    number_reader reader(s.data(), s.size());
+    reader.delimiters(",");
+
+    std::vector<double> values;
+    BOOST_CHECK(reader.read(values) == 5);
+    BOOST_CHECK(reader.eof());
+    BOOST_CHECK(!reader.fail());
+    BOOST_CHECK(values[3] == 45.0);
+    BOOST_CHECK(values[4] == -6.0);
+
+    s = "7 8 nine";
+    number_reader reader2(s.data(), s.size());
+    int arr[3] = { 0, 0, 0 };
+    BOOST_CHECK(reader2.read(vector_view<int>(arr)) == 2);
+    BOOST_CHECK(reader2.fail());
+    BOOST_CHECK(arr[1] == 8);
+}
+
+BOOST_AUTO_TEST_CASE( test_reader_file )
+{
+    const int n = 50000;
+    {
+        file f("numbers.txt", "wb");
+        for (int ind = 0; ind < n; ++ind)
+            f.print("%d %.6f\n", ind, ind / 7.0);
+        f.flush();
+    }
+
+    // A small buffer makes numbers straddle refills.
+    number_reader reader(file("numbers.txt", "rb"), 128);
+    int iv = 0;
+    double dv = 0;
+    char buf[32];
+    for (int ind = 0; ind < n; ++ind)
+    {
+        BOOST_REQUIRE(reader.read(iv));
+        BOOST_REQUIRE(iv == ind);
+        BOOST_REQUIRE(reader.read(dv));
+        snprintf(buf, sizeof(buf), "%.6f", ind / 7.0);
+        BOOST_REQUIRE(dv == strtod(buf, nullptr));
+    }
+    BOOST_CHECK(!reader.read(iv));
+    BOOST_CHECK(reader.eof());
+    BOOST_CHECK(!reader.fail());
+}
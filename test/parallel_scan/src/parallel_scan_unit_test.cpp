@@ -0,0 +1,69 @@
+#define BOOST_TEST_MODULE parallel_scan
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include <donny/file.hpp>
+#include <donny/parallel_scan.hpp>
+
+using namespace donny::filesystem;
+
+const int nLines = 100000;
+
+static void write_numbers(const char* filename)
+{
+    file f(filename, "wb");
+    for (int ind = 1; ind <= nLines; ++ind)
+        f.print("%d\n", ind);
+    f.flush();
+}
+
+BOOST_AUTO_TEST_CASE( test_split_lines )
+{
+    std::string text = "a\nbb\nccc\ndddd\n";
+    std::vector<std::size_t> bounds = split_lines(text.data(), text.size(), 3);
+
+    BOOST_REQUIRE(bounds.front() == 0);
+    BOOST_REQUIRE(bounds.back() == text.size());
+    for (std::size_t ind = 1; ind + 1 < bounds.size(); ++ind)
+        BOOST_CHECK(text[bounds[ind]-1] == '\n');
+}
+
+BOOST_AUTO_TEST_CASE( test_parallel_scan )
+{
+    write_numbers("numbers.txt");
+
+    long long sum = parallel_for_each_line("numbers.txt", 4096,
+        [](const char* line, std::size_t len, long long& partial) {
+            partial += atoll(std::string(line, len).c_str());
+        },
+        [](long long& into, long long& partial) { into += partial; },
+        0LL, 4);
+    BOOST_CHECK(sum == (long long)nLines * (nLines + 1) / 2);
+
+    std::size_t nNewLines = parallel_scan("numbers.txt", 1000,
+        [](const char* begin, const char* end, std::size_t& partial) {
+            if (*(end-1) != '\n')
+                throw std::logic_error("chunk is not line aligned");
+            partial += std::count(begin, end, '\n');
+        },
+        [](std::size_t& into, std::size_t& partial) { into += partial; },
+        (std::size_t)0);
+    BOOST_CHECK(nNewLines == (std::size_t)nLines);
+}
+
+BOOST_AUTO_TEST_CASE( test_mapped_file_advise )
+{
+    write_numbers("numbers.txt");
+    mapped_file mf("numbers.txt");
+    BOOST_REQUIRE(mf.is_open());
+    BOOST_CHECK(mf.advise(mapped_file::sequential_access));
+    BOOST_CHECK(mf.advise(mapped_file::will_need, 100, 5000));
+    BOOST_CHECK(mf.advise(mapped_file::dont_need));
+    // Dropped pages come back from the file.
+    BOOST_CHECK(std::count(mf.begin(), mf.end(), '\n') == nLines);
+    BOOST_CHECK(!mf.advise(mapped_file::random_access, mf.size()));
+}
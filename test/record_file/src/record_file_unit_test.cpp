@@ -0,0 +1,150 @@
+#define BOOST_TEST_MODULE record_file
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include <donny/crc32c.hpp>
+#include <donny/record_file.hpp>
+
+using namespace donny;
+using namespace donny::filesystem;
+
+BOOST_AUTO_TEST_CASE( test_crc32c )
+{
+    const char* check = "123456789";
+    BOOST_CHECK(crc32c(check, 9) == 0xE3069283u);
+    BOOST_CHECK(crc32c(check + 4, 5, crc32c(check, 4)) == 0xE3069283u);
+
+    std::string data(100000, '\0');
+    for (std::size_t ind = 0; ind < data.size(); ++ind)
+        data[ind] = (char)(ind * 7 + ind / 13);
+    for (std::size_t n : { 0, 1, 7, 8, 9, 1000, 100000 })
+    {
+        uint32_t sw = ~detail::crc32c_sw(~0u, (const unsigned char*)data.data(), n);
+        BOOST_CHECK(crc32c(data.data(), n) == sw);
+#if DONNY_X86
+        if (cpu().sse42)
+            BOOST_CHECK(~detail::crc32c_hw(~0u, (const unsigned char*)data.data(), n) == sw);
+#endif
+    }
+}
+
+static std::string make_record(int ind)
+{
+    return std::string(ind % 50, (char)('a' + ind % 26)) + std::to_string(ind);
+}
+
+BOOST_AUTO_TEST_CASE( test_records )
+{
+    const int n = 1000;
+    {
+        file f("records.bin", "wb");
+        record_writer writer(f);
+        for (int ind = 0; ind < n; ++ind)
+            BOOST_REQUIRE(writer.write(make_record(ind)));
+        writer.flush();
+    }
+
+    record_reader reader(file("records.bin", "rb"), 100);
+    std::string record;
+    int ind = 0;
+    while (reader.read(record))
+    {
+        BOOST_REQUIRE(ind < n);
+        BOOST_REQUIRE(record == make_record(ind));
+        ++ind;
+    }
+    BOOST_CHECK(ind == n);
+    BOOST_CHECK(reader.corrupted() == 0);
+    BOOST_CHECK(reader.skipped_bytes() == 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_recovery )
+{
+    std::vector<std::size_t> offsets;
+    const int n = 100;
+    {
+        file f("records.bin", "wb");
+        record_writer writer(f);
+        for (int ind = 0; ind < n; ++ind)
+        {
+            offsets.push_back(f.tell());
+            writer.write(make_record(ind));
+        }
+        f.puts("garbage at the end");
+        writer.flush();
+    }
+
+    // Damage a payload, a length field, and cut the file with garbage.
+    {
+        file f("records.bin", "r+b");
+        f.seek(offsets[10] + RecordHeaderSize, file::begin);
+        f.putc('!');
+        f.seek(offsets[20] + 4, file::begin);
+        f.putc('\x7f');
+        f.flush();
+    }
+
+    record_reader reader(file("records.bin", "rb"));
+    std::string record;
+    std::vector<std::string> records;
+    while (reader.read(record))
+        records.push_back(record);
+
+    BOOST_CHECK(records.size() == (std::size_t)n - 2);
+    BOOST_CHECK(reader.corrupted() == 2);
+    BOOST_CHECK(reader.skipped_bytes() > 0);
+    BOOST_CHECK(records[10] == make_record(11));
+    BOOST_CHECK(records[19] == make_record(21));
+    BOOST_CHECK(records.back() == make_record(n - 1));
+}
+
+BOOST_AUTO_TEST_CASE( test_cut_write )
+{
+    // The frame of a long record, cut after its header and a few bytes.
+    std::string cut;
+    {
+        file f("long.bin", "wb");
+        record_writer writer(f);
+        writer.write(std::string(300, 'x'));
+        writer.flush();
+    }
+    {
+        file f("long.bin", "rb");
+        cut.resize(RecordHeaderSize + 10);
+        BOOST_REQUIRE(f.read(&cut[0], 1, cut.size()) == cut.size());
+    }
+
+    // Records go on right after each cut frame, one in the middle of the
+    // file and one at the end with less than its length after it.
+    const int n = 40;
+    {
+        file f("records.bin", "wb");
+        record_writer writer(f);
+        for (int ind = 0; ind < n; ++ind)
+        {
+            if (ind == 10 || ind == n - 2)
+            {
+                writer.flush();
+                f.write(cut.data(), 1, cut.size());
+            }
+            writer.write(make_record(ind));
+        }
+        writer.flush();
+    }
+
+    record_reader reader(file("records.bin", "rb"));
+    std::string record;
+    int ind = 0;
+    while (reader.read(record))
+    {
+        BOOST_REQUIRE(ind < n);
+        BOOST_CHECK(record == make_record(ind));
+        ++ind;
+    }
+    BOOST_CHECK(ind == n);
+    BOOST_CHECK(reader.corrupted() == 2);
+    BOOST_CHECK(reader.skipped_bytes() == 2 * cut.size());
+}
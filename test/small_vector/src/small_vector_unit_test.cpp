@@ -0,0 +1,116 @@
+#define BOOST_TEST_MODULE small_vector
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <donny/small_vector.hpp>
+
+using donny::small_vector;
+
+// Test the inline buffer and the switch to the heap
+BOOST_AUTO_TEST_CASE( test_inline_and_heap )
+{
+    small_vector<double, 4> v;
+    BOOST_CHECK(v.empty());
+    BOOST_CHECK(v.is_inline());
+    BOOST_CHECK(v.capacity() == 4);
+
+    for (int ind = 0; ind < 4; ++ind)
+        v.push_back(ind);
+    BOOST_CHECK(v.is_inline());
+
+    v.push_back(v[0]);
+    BOOST_CHECK(!v.is_inline());
+    BOOST_CHECK(v.size() == 5);
+    std::vector<double> expected = { 0, 1, 2, 3, 0 };
+    BOOST_CHECK(std::vector<double>(v.begin(), v.end()) == expected);
+
+    v.resize(2);
+    BOOST_CHECK(v.size() == 2 && v.back() == 1);
+    v.resize(6, 7);
+    BOOST_CHECK(v[5] == 7);
+    v.erase(v.begin() + 1, v.begin() + 3);
+    expected = { 0, 7, 7, 7 };
+    BOOST_CHECK(std::vector<double>(v.begin(), v.end()) == expected);
+    BOOST_CHECK(std::vector<double>(v.rbegin(), v.rend()) ==
+                std::vector<double>(expected.rbegin(), expected.rend()));
+}
+
+// Test filling with one of the elements, moved away when the vector grows
+BOOST_AUTO_TEST_CASE( test_fill_with_element )
+{
+    const std::string first = "a string too long for the small string buffer";
+    small_vector<std::string, 2> v;
+    v.push_back(first);
+    v.push_back("b");
+
+    v.resize(8, v[0]);
+    BOOST_CHECK(v.size() == 8);
+    for (const std::string& s : v)
+        BOOST_CHECK(s == first || s == "b");
+    BOOST_CHECK(v[7] == first);
+
+    v.assign(20, v[0]);
+    BOOST_CHECK(v.size() == 20);
+    for (const std::string& s : v)
+        BOOST_CHECK(s == first);
+}
+
+// Test copy, move and swap across inline and heap storage
+BOOST_AUTO_TEST_CASE( test_copy_move_swap )
+{
+    small_vector<std::string, 2> a = { "one", "two" };
+    small_vector<std::string, 2> b = { "three", "four", "five" };
+    BOOST_CHECK(a.is_inline() && !b.is_inline());
+
+    small_vector<std::string, 2> c = a, d = b;
+    BOOST_CHECK(c == a && d == b);
+    BOOST_CHECK(c.is_inline() && !d.is_inline());
+
+    const std::string* heap = d.data();
+    small_vector<std::string, 2> e(std::move(d));
+    BOOST_CHECK(e.data() == heap && e == b);
+    BOOST_CHECK(d.empty() && d.is_inline());
+
+    small_vector<std::string, 2> f(std::move(c));
+    BOOST_CHECK(f == a && c.empty());
+
+    a.swap(b);
+    BOOST_CHECK(a.size() == 3 && a[2] == "five");
+    BOOST_CHECK(b.size() == 2 && b[0] == "one");
+    BOOST_CHECK(!a.is_inline() && b.is_inline());
+
+    a = b;
+    BOOST_CHECK(a == b && a.size() == 2);
+    b = std::move(e);
+    BOOST_CHECK(b.size() == 3 && b.data() == heap);
+    b.pop_back();
+    b.clear();
+    BOOST_CHECK(b.empty() && b != a);
+
+    small_vector<int, 3> n(5, 2), m(n.begin(), n.begin() + 2);
+    BOOST_CHECK(n.size() == 5 && n[4] == 2);
+    BOOST_CHECK(m.size() == 2 && m.is_inline());
+}
+
+// Test ranges of single pass and multi pass iterators
+BOOST_AUTO_TEST_CASE( test_iterator_ranges )
+{
+    std::istringstream in("1 2 3 4 5 6");
+    small_vector<int, 4> v((std::istream_iterator<int>(in)), std::istream_iterator<int>());
+    BOOST_CHECK(v.size() == 6 && !v.is_inline());
+    BOOST_CHECK(v.front() == 1 && v.back() == 6);
+
+    std::istringstream more("7 8");
+    v.assign(std::istream_iterator<int>(more), std::istream_iterator<int>());
+    BOOST_CHECK(v.size() == 2 && v[0] == 7 && v[1] == 8);
+
+    std::list<std::string> l = { "a", "b", "c", "d", "e" };
+    small_vector<std::string, 2> s(l.begin(), l.end());
+    BOOST_CHECK(s.size() == 5 && s.capacity() == 5 && s[4] == "e");
+}
@@ -0,0 +1,147 @@
+#define BOOST_TEST_MODULE unicode
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <random>
+#include <string>
+
+#include <donny/unicode.hpp>
+
+using namespace donny::unicode;
+
+static std::u32string random_text(std::size_t n, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::u32string s;
+    for (std::size_t ind = 0; ind < n; ++ind)
+    {
+        char32_t cp;
+        switch (rng() % 8)
+        {
+        case 0: cp = 0x80 + rng() % 0x780; break;
+        case 1: cp = 0x800 + rng() % 0xD000; break;
+        case 2: cp = 0x10000 + rng() % 0x100000; break;
+        default: cp = 0x20 + rng() % 0x5F; break;
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF) cp = 'x';
+        s += cp;
+    }
+    return s;
+}
+
+BOOST_AUTO_TEST_CASE( test_round_trip )
+{
+    std::u32string text = random_text(10000, 1);
+    text += std::u32string(1000, U'a'); // long ASCII run for the kernels
+
+    std::size_t nErrors = 1;
+    std::string u8 = utf32_to_utf8(text, &nErrors);
+    BOOST_CHECK(nErrors == 0);
+    BOOST_CHECK(validate_utf8(u8.data(), u8.size()));
+
+    BOOST_CHECK(utf8_to_utf32(u8) == text);
+    std::u16string u16 = utf8_to_utf16(u8);
+    BOOST_CHECK(utf16_to_utf8(u16) == u8);
+    BOOST_CHECK(utf8_to_wstring(u8).size() == (sizeof(wchar_t) == 4 ? text.size() : u16.size()));
+    BOOST_CHECK(wstring_to_utf8(utf8_to_wstring(u8)) == u8);
+
+    BOOST_CHECK(utf16_to_utf8(u"豆沙包") == u8"豆沙包");
+}
+
+BOOST_AUTO_TEST_CASE( test_invalid )
+{
+    // overlong, surrogate, truncated, > U+10FFFF
+    const char* bad[] = { "\xC0\xAF", "\xED\xA0\x80", "a\xE4\xB8", "\xF4\x90\x80\x80" };
+    for (const char* s : bad)
+    {
+        BOOST_CHECK(!validate_utf8(s, strlen(s)));
+        std::size_t nErrors = 0;
+        std::u32string u32 = utf8_to_utf32(s, &nErrors);
+        BOOST_CHECK(nErrors > 0);
+        BOOST_CHECK(u32.find(REPLACEMENT_CHARACTER) != std::u32string::npos);
+    }
+
+    std::size_t nErrors = 0;
+    std::u16string lone = { u'a', (char16_t)0xD800, u'b' };
+    BOOST_CHECK(utf16_to_utf8(lone, &nErrors) == "a\xEF\xBF\xBD" "b");
+    BOOST_CHECK(nErrors == 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_stream )
+{
+    std::string u8 = utf32_to_utf8(random_text(3000, 2));
+    const Encoding encodings[] = { UTF16LE, UTF16BE, UTF32LE, UTF32BE, UTF8 };
+
+    for (Encoding enc : encodings)
+    {
+        // Encode with BOM, feeding one byte at a time.
+        stream_transcoder encoder(UTF8, enc, true);
+        std::string encoded;
+        for (char c : u8)
+            encoder.feed(&c, 1, encoded);
+        encoder.finish(encoded);
+        BOOST_CHECK(encoder.errors() == 0);
+
+        std::size_t bomLength = 0;
+        BOOST_CHECK(detect_bom(encoded.data(), encoded.size(), bomLength) == enc);
+
+        // Decode with BOM detection, in odd sized chunks.
+        stream_transcoder decoder(UNKNOWN, UTF8);
+        std::string decoded;
+        for (std::size_t pos = 0; pos < encoded.size(); pos += 7)
+            decoder.feed(encoded.data() + pos, std::min<std::size_t>(7, encoded.size() - pos), decoded);
+        decoder.finish(decoded);
+        BOOST_CHECK(decoder.source_encoding() == enc);
+        BOOST_CHECK(decoder.errors() == 0);
+        BOOST_CHECK(decoded == u8);
+    }
+
+    // Truncated input is reported at finish().
+    stream_transcoder decoder(UTF16LE, UTF8);
+    std::string decoded;
+    decoder.feed("a\0b", 3, decoded);
+    decoder.finish(decoded);
+    BOOST_CHECK(decoder.errors() == 1);
+    BOOST_CHECK(decoded == "ab\xEF\xBF\xBD" || decoded == "a\xEF\xBF\xBD");
+}
+
+BOOST_AUTO_TEST_CASE( test_kernels )
+{
+    using namespace donny::unicode::detail;
+    std::string ascii(100, '\0');
+    for (std::size_t ind = 0; ind < ascii.size(); ++ind)
+        ascii[ind] = (char)('A' + ind % 26);
+    std::u16string u16(100, u'\0');
+    std::u32string u32(100, U'\0');
+    std::string back(100, '\0');
+
+    BOOST_CHECK(widen16_scalar(ascii.data(), 100, &u16[0]) == 96);
+#if DONNY_X86
+    BOOST_CHECK(widen16_sse2(ascii.data(), 100, &u16[0]) == 96);
+    BOOST_CHECK(widen32_sse2(ascii.data(), 100, &u32[0]) == 96);
+    BOOST_CHECK(narrow16_sse2(u16.data(), 96, &back[0]) == 96);
+    BOOST_CHECK(back.substr(0, 96) == ascii.substr(0, 96));
+    std::fill(back.begin(), back.end(), '\0');
+    BOOST_CHECK(narrow32_sse2(u32.data(), 96, &back[0]) == 96);
+    BOOST_CHECK(back.substr(0, 96) == ascii.substr(0, 96));
+
+    char16_t swapped[9] = { 0x0102, 0x0304, 0x0506, 0x0708, 0x090A, 0x0B0C, 0x0D0E, 0x0F10, 0x1112 };
+    bswap16_sse2(swapped, 9);
+    BOOST_CHECK(swapped[0] == 0x0201 && swapped[8] == 0x1211);
+    char32_t swapped32[5] = { 0x01020304, 0, 0, 0, 0x05060708 };
+    bswap32_sse2(swapped32, 5);
+    BOOST_CHECK(swapped32[0] == 0x04030201 && swapped32[4] == 0x08070605);
+
+    if (donny::cpu().avx2)
+    {
+        BOOST_CHECK(widen16_avx2(ascii.data(), 100, &u16[0]) == 96);
+        BOOST_CHECK(widen32_avx2(ascii.data(), 100, &u32[0]) == 96);
+        std::fill(back.begin(), back.end(), '\0');
+        BOOST_CHECK(narrow16_avx2(u16.data(), 96, &back[0]) == 96);
+        BOOST_CHECK(back.substr(0, 96) == ascii.substr(0, 96));
+        std::fill(back.begin(), back.end(), '\0');
+        BOOST_CHECK(narrow32_avx2(u32.data(), 96, &back[0]) == 96);
+        BOOST_CHECK(back.substr(0, 96) == ascii.substr(0, 96));
+    }
+#endif
+}
@@ -0,0 +1,157 @@
+/**
+ * log_search - search logger output
+ *
+ *  log_search [-l LEVEL] [-s SINCE] [-u UNTIL] [-f] [-e PATTERN] FILE...
+ *
+ *      -l LEVEL    INFO, ERR, DEB or VERB
+ *      -s SINCE    lines at or after SINCE
+ *      -u UNTIL    lines before UNTIL
+ *      -e PATTERN  lines containing PATTERN, literally
+ *      -f          keep following FILE, like tail -f (one file only)
+ *      -c          only print the number of matching lines
+ *
+ *  SINCE and UNTIL are seconds since the epoch, or a timestamp in the
+ *  format logger writes ("[Mon Oct 19 13:45:00 2026]", UTC).
+ *  Files written by compressed_file are decompressed on the fly.
+ */
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <donny/log_search.hpp>
+
+using namespace donny;
+
+static std::atomic<bool> bStop(false);
+
+static void on_signal(int)
+{
+    bStop = true;
+}
+
+static int usage()
+{
+    fprintf(stderr, "usage: log_search [-l LEVEL] [-s SINCE] [-u UNTIL] [-f] [-c] [-e PATTERN] FILE...\n");
+    return 2;
+}
+
+static bool parse_time(const log_search& search, const char* text, time_t& t)
+{
+    char* end = nullptr;
+    long long secs = strtoll(text, &end, 10);
+    if (end != text && *end == '\0')
+    {
+        t = (time_t)secs;
+        return true;
+    }
+    t = search.timestamp(text, strlen(text));
+    return t != -1;
+}
+
+static bool is_compressed(const char* filename)
+{
+    filesystem::file f(filename, "rb");
+    uint32_t magic = 0;
+    return f.is_open() && f.read(&magic) == 1 && magic == filesystem::compressed_file::HeaderMagic;
+}
+
+int main(int argc, char* argv[])
+{
+    log_search search;
+    bool bFollow = false, bCount = false;
+    std::vector<const char*> files;
+
+    for (int ind = 1; ind < argc; ++ind)
+    {
+        std::string arg = argv[ind];
+        bool bHasValue = (ind + 1 < argc);
+        if (arg == "-f") bFollow = true;
+        else if (arg == "-c") bCount = true;
+        else if (arg == "-e" && bHasValue) search.contains(argv[++ind]);
+        else if (arg == "-l" && bHasValue)
+        {
+            std::string level = argv[++ind];
+            if (level == "INFO") search.level(logger<char>::INFO);
+            else if (level == "ERR") search.level(logger<char>::ERR);
+            else if (level == "DEB") search.level(logger<char>::DEB);
+            else if (level == "VERB") search.level(logger<char>::VERB);
+            else return usage();
+        }
+        else if ((arg == "-s" || arg == "-u") && bHasValue)
+        {
+            time_t t;
+            if (!parse_time(search, argv[++ind], t))
+            {
+                fprintf(stderr, "log_search: bad time: %s\n", argv[ind]);
+                return 2;
+            }
+            if (arg == "-s") search.since(t);
+            else search.until(t);
+        }
+        else if (arg.size() > 1 && arg[0] == '-') return usage();
+        else files.push_back(argv[ind]);
+    }
+    if (files.empty() || (bFollow && files.size() != 1)) return usage();
+
+    auto print = [&](const char* line, std::size_t len) {
+        if (bCount) return;
+        fwrite(line, 1, len, stdout);
+        if (len == 0 || line[len - 1] != '\n') putchar('\n');
+    };
+
+    int status = 1;
+    if (bFollow)
+    {
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+        setvbuf(stdout, nullptr, _IOLBF, 0);
+        long n = search.follow(files[0], print, bStop);
+        if (n < 0)
+        {
+            fprintf(stderr, "log_search: can't read %s\n", files[0]);
+            return 2;
+        }
+        if (bCount) printf("%ld\n", n);
+        return n > 0 ? 0 : 1;
+    }
+
+    for (std::size_t ind = 0; ind < files.size(); ++ind)
+    {
+        const char* filename = files[ind];
+        auto printFile = [&](const char* line, std::size_t len) {
+            if (bCount) return;
+            if (files.size() > 1) printf("%s:", filename);
+            fwrite(line, 1, len, stdout);
+            if (len == 0 || line[len - 1] != '\n') putchar('\n');
+        };
+
+        long n;
+        if (is_compressed(filename))
+        {
+            filesystem::compressed_file cf(filesystem::file(filename, "rb"),
+                                           filesystem::compressed_file::read_mode);
+            n = cf.is_open() ? (long)search.search(cf, printFile) : -1;
+        }
+        else
+            n = search.search(std::string(filename), printFile);
+
+        if (n < 0)
+        {
+            fprintf(stderr, "log_search: can't read %s\n", filename);
+            status = 2;
+            continue;
+        }
+        if (bCount)
+        {
+            if (files.size() > 1) printf("%s:", filename);
+            printf("%ld\n", n);
+        }
+        if (n > 0 && status == 1) status = 0;
+    }
+    return status;
+}